@@ -0,0 +1,550 @@
+/*****************************************************************************
+ * Host microbenchmarks of the firmware hot paths
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Firmware is compiled into this translation unit, so benchmarks call the
+ * very same functions and globals as the device. setup() runs once against
+ * the mock hardware (hal/native) to get realistic state, then every
+ * benchmark is repeated until it runs at least the minimum time.
+ *
+ * Reported per operation: host time (ns), heap bytes and heap allocations,
+ * compression benchmarks add the ratio (input / output bytes), transport
+ * benchmarks the radio time per sample (virtual time of the write with the
+ * modeled network, see hal/native/src/network.cpp). Results are
+ * written as JSON for comparing versions. UDP datagrams are checked against
+ * a local sink first, the program fails when they differ. DHT decoder,
+ * fixed point derived values and record log recovery are tested by unit
+ * tests (test/), their traces and reference formulas are used here.
+ *
+ *   program [-o bench.json] [-t min_time_ms] [filter]
+ *****************************************************************************/
+#include "../src/main.cpp"
+
+#include <chrono>
+#include <new>
+#include <getopt.h>
+#include <InfluxDbClient.h>               // Point of the former InfluxDB library, for comparison
+#include <GzipStream.h>
+#include <Aggregate.h>
+#include <RecordLog.h>
+#include <zlib.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#ifdef USE_DHT_SENSOR
+#include "../test/test_dht_reader/dht_traces.h"
+#include "../test/test_derived/reference.h"
+#endif
+
+/***** Heap accounting *****/
+static bool heapCounting = false;
+static uint64_t heapBytes = 0;
+static uint64_t heapAllocations = 0;
+
+// Replacements pair malloc() and free(), GCC inlines delete into the containers and takes free()
+// of a new'ed pointer as mismatched
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+__attribute__((noinline)) void* operator new(size_t size) {
+  if (heapCounting) {
+    heapBytes += size;
+    heapAllocations++;
+  }
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#pragma GCC diagnostic pop
+
+/***** Benchmark runner *****/
+struct BenchResult {
+  const char* name;
+  uint64_t iterations;
+  double nsPerOp;
+  double bytesPerOp;
+  double allocationsPerOp;
+  double ratio;                             // Compression ratio, 0 = not applicable
+  double radioMicros;                       // Virtual time per sample, 0 = not applicable
+};
+
+#define BENCH_MAX_RESULTS 48
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static size_t resultCount = 0;
+static uint32_t minTimeMs = 200;
+static const char* filter = nullptr;
+
+// Keep value alive, the compiler must not optimize the benchmark away
+template <typename T>
+static inline void keep(T const& value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+template <typename F>
+static double measure(F& body, uint64_t iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < iterations; i++)
+    body();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Samples > 0: body writes that many samples, virtual clock time is reported per sample
+template <typename F>
+static void bench(const char* name, F body, double ratio = 0, size_t samples = 0) {
+  if (filter && !strstr(name, filter))
+    return;
+  if (resultCount >= BENCH_MAX_RESULTS)
+    return;
+  // Warm up and find iteration count for the minimum time
+  uint64_t iterations = 1;
+  uint64_t clockStart = hal::clockMicros;
+  double ns = measure(body, iterations);
+  while (ns < minTimeMs * 1e6 && iterations < (1ULL << 40)) {
+    uint64_t next = ns > 0 ? (uint64_t)(iterations * (minTimeMs * 1.2e6 / ns)) : iterations * 100;
+    iterations = constrain(next, iterations * 2, iterations * 100);
+    clockStart = hal::clockMicros;
+    ns = measure(body, iterations);
+  }
+  uint64_t clockMicros = hal::clockMicros - clockStart;
+  // Heap is counted in a separate shorter pass, counting must not skew the time
+  uint64_t heapIterations = min(iterations, (uint64_t)1000);
+  heapBytes = heapAllocations = 0;
+  heapCounting = true;
+  for (uint64_t i = 0; i < heapIterations; i++)
+    body();
+  heapCounting = false;
+
+  BenchResult& result = results[resultCount++];
+  result.name = name;
+  result.iterations = iterations;
+  result.nsPerOp = ns / iterations;
+  result.bytesPerOp = (double)heapBytes / heapIterations;
+  result.allocationsPerOp = (double)heapAllocations / heapIterations;
+  result.ratio = ratio;
+  result.radioMicros = samples ? (double)clockMicros / iterations / samples : 0;
+  fprintf(stderr, "%-24s %12llu %12.1f ns/op %10.1f B/op %8.2f allocs/op", name,
+          (unsigned long long)iterations, result.nsPerOp, result.bytesPerOp, result.allocationsPerOp);
+  if (ratio > 0)
+    fprintf(stderr, " %6.2f ratio", ratio);
+  if (samples)
+    fprintf(stderr, " %9.0f us radio/sample", result.radioMicros);
+  fprintf(stderr, "\n");
+}
+
+static bool writeResults(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (!f)
+    return false;
+  fprintf(f, "{\n  \"version\": \"%s\",\n  \"compiler\": \"%s\",\n  \"results\": [\n", VERSION, __VERSION__);
+  for (size_t i = 0; i < resultCount; i++) {
+    const BenchResult& r = results[i];
+    fprintf(f, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"bytes_per_op\": %.2f, \"allocs_per_op\": %.2f",
+            r.name, (unsigned long long)r.iterations, r.nsPerOp, r.bytesPerOp, r.allocationsPerOp);
+    if (r.ratio > 0)
+      fprintf(f, ", \"ratio\": %.3f", r.ratio);
+    if (r.radioMicros > 0)
+      fprintf(f, ", \"radio_us_per_sample\": %.1f", r.radioMicros);
+    fprintf(f, "}%s\n", i + 1 < resultCount ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  return fclose(f) == 0;
+}
+
+/***** Benchmarks *****/
+static void benchEncoding(const Sample& sample) {
+  // Line protocol into static buffer (current write path)
+  bench("encode_line_protocol", [&]() {
+    encoder.clear();
+    sampleLine(sample, 1650000000);
+    keep(encoder.length());
+  });
+  bench("encode_batch_6", [&]() {
+    encoder.clear();
+    for (int i = 0; i < 6; i++)
+      sampleLine(sample, 1650000000 + i * 60);
+    keep(encoder.length());
+  });
+
+  // Full pointDevice built with the InfluxDB library Point (String based)
+  Point pointDevice(measurementName);
+  pointDevice.addTag("device", deviceId);
+  pointDevice.addTag("SSID", WiFi.SSID());
+  pointDevice.addTag("location", location);
+  bench("encode_point", [&]() {
+    pointDevice.clearFields();
+    pointDevice.addField("rssi", (long)sample.values[FIELD_RSSI]);
+    pointDevice.addField("uptime", (unsigned long long)sample.timestamp);
+    // Sensor fields named by their channel
+    sensors.each([&](auto& sensor, const SensorSlot& slot) {
+      for (uint8_t i = 0; i < sensor.FIELDS; i++)
+        if (sample.has(slot.field + i))
+          pointDevice.addField(sensorSettings[slot.channel + sensor.channel(i)].name, sample.values[slot.field + i]);
+    });
+    pointDevice.setTime(1650000000);
+    String line = pointDevice.toLineProtocol();
+    keep(line.length());
+  });
+}
+
+static GzipStream gzipBench;
+
+// Discards compressed output, only its length is used
+class NullPrint : public Print {
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t size) override { return size; }
+};
+
+static size_t compressedLength(const char* body, size_t length) {
+  static NullPrint nullPrint;
+  gzipBench.begin(&nullPrint);
+  gzipBench.write(body, length);
+  return gzipBench.finish();
+}
+
+// Write body of count samples in batchBody
+static size_t batchOf(const Sample& sample, size_t count) {
+  encoder.clear();
+  for (size_t i = 0; i < count; i++)
+    sampleLine(sample, 1650000000 + i * 60);
+  return encoder.length();
+}
+
+static void benchCompression(const Sample& sample) {
+  const size_t sizes[] = { 1, 6, 16 };
+  const char* names[][2] = {
+    { "gzip_line", "zlib6_line" }, { "gzip_batch_6", "zlib6_batch_6" }, { "gzip_batch_16", "zlib6_batch_16" }
+  };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    size_t length = batchOf(sample, sizes[i]);
+    // Streaming compressor of the firmware, output only counted
+    size_t compressed = compressedLength(batchBody, length);
+    bench(names[i][0], [&]() { keep(compressedLength(batchBody, length)); },
+      compressed ? (double)length / compressed : 0);
+    // Reference: zlib default level with full 32 kB window, as gzip -6
+    static uint8_t out[BATCH_BODY_SIZE + 64];
+    auto zlib = [&]() {
+      z_stream z = {};
+      deflateInit2(&z, 6, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+      z.next_in = (Bytef*)batchBody;
+      z.avail_in = length;
+      z.next_out = out;
+      z.avail_out = sizeof(out);
+      deflate(&z, Z_FINISH);
+      size_t total = z.total_out;
+      deflateEnd(&z);
+      return total;
+    };
+    compressed = zlib();
+    bench(names[i][1], [&]() { keep(zlib()); }, compressed ? (double)length / compressed : 0);
+  }
+}
+
+/***** Transports *****/
+static int sinkFd = -1;
+static char sinkAddress[32];
+
+// Local UDP listener on a free port, the mock sends line protocol datagrams there
+static bool openSink() {
+  sinkFd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (sinkFd < 0 || bind(sinkFd, (struct sockaddr*)&address, length) != 0 ||
+      getsockname(sinkFd, (struct sockaddr*)&address, &length) != 0)
+    return false;
+  int size = 4 << 20;
+  setsockopt(sinkFd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  snprintf(sinkAddress, sizeof(sinkAddress), "127.0.0.1:%u", ntohs(address.sin_port));
+  hal::udpSink = sinkAddress;
+  return true;
+}
+
+// Received datagrams are appended to out, returns their count
+static size_t drainSink(std::string* out) {
+  size_t count = 0;
+  char packet[65536];
+  bool whole = true;
+  ssize_t n;
+  while ((n = recv(sinkFd, packet, sizeof(packet), MSG_DONTWAIT)) >= 0) {
+    // Whole lines only (last line of body without newline), datagram fits into a frame unless it is a single line
+    if (!whole || n == 0 || (n > INFLUX_WRITER_DATAGRAM_SIZE && memchr(packet, '\n', n - 1)))
+      out = nullptr;
+    whole = packet[n - 1] == '\n';
+    if (out)
+      out->append(packet, n);
+    count++;
+  }
+  return out ? count : 0;
+}
+
+// Batches are received by the sink unchanged, split at line boundaries
+static bool checkTransport(const Sample& sample) {
+  if (!openSink()) {
+    fprintf(stderr, "Cannot open UDP sink\n");
+    return false;
+  }
+  InfluxWriter udp;
+  udp.begin("udp://bench.local", "", "", "");
+  const size_t sizes[] = { 1, 4, 10 };
+  for (size_t count : sizes) {
+    size_t length = batchOf(sample, count);
+    uint32_t datagrams = udp.stats().datagrams;
+    std::string received;
+    if (!udp.write(batchBody, length) || drainSink(&received) != udp.stats().datagrams - datagrams ||
+        received != std::string(batchBody, length)) {
+      fprintf(stderr, "UDP batch of %u samples not received\n", (unsigned)count);
+      return false;
+    }
+    fprintf(stderr, "UDP batch of %u samples (%u bytes) in %u datagrams\n", (unsigned)count, (unsigned)length,
+            (unsigned)(udp.stats().datagrams - datagrams));
+  }
+  return true;
+}
+
+static void benchTransport(const Sample& sample, uint32_t latencyMicros) {
+  // Modeled server round trip, as on device
+  uint32_t latency = hal::influxLatencyMicros;
+  hal::influxLatencyMicros = latencyMicros;
+  static InfluxWriter writers[5];
+  // Connection kept open (continuous mode) or opened by every write (deep sleep, TLS session resumed)
+  writers[0].begin("https://bench.local", "org", "bucket", "token");
+  writers[1].begin("https://bench.local", "org", "bucket", "token");
+  writers[1].setReuse(false);
+  writers[2].begin("http://bench.local", "org", "bucket", "token");
+  writers[3].begin("http://bench.local", "org", "bucket", "token");
+  writers[3].setReuse(false);
+  writers[4].begin("udp://bench.local", "", "", "");
+  const char* names[][5] = {
+    { "write_https_1", "write_https_new_1", "write_http_1", "write_http_new_1", "write_udp_1" },
+    { "write_https_10", "write_https_new_10", "write_http_10", "write_http_new_10", "write_udp_10" }
+  };
+  const size_t sizes[] = { 1, 10 };
+  for (size_t i = 0; i < 2; i++) {
+    size_t length = batchOf(sample, sizes[i]);
+    for (size_t w = 0; w < 5; w++) {
+      InfluxWriter& writer = writers[w];
+      bench(names[i][w], [&]() { keep(writer.write(batchBody, length)); }, 0, sizes[i]);
+    }
+  }
+  // Sink is not read while benchmarking, datagrams over its buffer are dropped
+  drainSink(nullptr);
+  hal::influxLatencyMicros = latency;
+}
+
+/***** Derived quantities *****/
+// *_ref are the double precision formulas (test/test_derived/reference.h)
+static void benchComputation() {
+  volatile float temperature = 23.4f;
+  volatile float humidity = 48.0f;
+  bench("dew_point", [&]() { keep(dewPoint(temperature, humidity)); });
+  bench("dew_point_ref", [&]() { keep(refDewPoint(temperature, humidity)); });
+  bench("abs_humidity", [&]() { keep(absoluteHumidity(temperature, humidity)); });
+  bench("abs_humidity_ref", [&]() { keep(refAbsoluteHumidity(temperature, humidity)); });
+  // Hot and humid, regression branch
+  volatile float hot = 32.0f;
+  volatile float humid = 70.0f;
+  bench("heat_index", [&]() { keep(heatIndex(hot, humid)); });
+  bench("heat_index_ref", [&]() { keep(refHeatIndex(hot, humid)); });
+  volatile float pressure = 97250.0f;
+  volatile float height = 350.0f;
+  bench("altitude", [&]() { keep(altitude(pressure, 101325.0f)); });
+  bench("altitude_ref", [&]() { keep(refAltitude(pressure, 101325.0)); });
+  bench("sea_level_pressure", [&]() { keep(seaLevelPressure(pressure, height)); });
+  bench("sea_level_pressure_ref", [&]() { keep(refSeaLevelPressure(pressure, height)); });
+  bench("millis64", []() { keep(millis64()); });
+}
+
+#ifdef USE_DHT_SENSOR
+static void benchDht() {
+  // Interrupt handler of one frame, per edge cost is 1/42 (pin without line model)
+  static DhtReader reader(D1, DHT_TYPE_22);
+  bench("dht_frame_edges", []() {
+    reader.begin();
+    for (uint8_t i = 0; i < DHT_EDGES; i++)
+      DhtReader::edge(&reader);
+  });
+  // Frame decode outside interrupt, done once per read
+  const DhtTrace& trace = dhtTraces[0];
+  bench("dht_decode", [&]() {
+    uint8_t data[5];
+    float temperature, humidity;
+    if (DhtReader::decode(trace.edges, trace.count, data) == DHT_OK)
+      DhtReader::convert(trace.type, data, temperature, humidity);
+    keep(data);
+  });
+}
+#endif
+
+static void benchAggregation(const Sample& sample) {
+  // One reading of every sensor field into window statistics
+  static Aggregate fieldAggregates[FIELD_COUNT];
+  uint32_t step = 0;
+  bench("aggregate_add", [&]() {
+    float noise = (float)(step++ & 7) * 0.01f;
+    for (uint8_t field = 0; field < FIELD_COUNT; field++)
+      fieldAggregates[field].add(sample.values[field] + noise);
+    keep(fieldAggregates[0]);
+  });
+  // Statistics of every field at window end
+  bench("aggregate_result", [&]() {
+    for (uint8_t field = 0; field < FIELD_COUNT; field++) {
+      const Aggregate& aggregate = fieldAggregates[field];
+      keep(aggregate.mean());
+      keep(aggregate.minimum());
+      keep(aggregate.maximum());
+      keep(aggregate.stddev());
+    }
+  });
+  // Reference: window of 30 readings kept in memory, two passes at window end (per field)
+  static float window[30];
+  for (size_t i = 0; i < 30; i++)
+    window[i] = 101535.47f + (float)(i & 7) * 0.3f;
+  bench("two_pass_30", []() {
+    float sum = 0;
+    for (float value : window)
+      sum += value;
+    float mean = sum / 30;
+    float squares = 0;
+    for (float value : window)
+      squares += (value - mean) * (value - mean);
+    keep(mean);
+    keep(sqrtf(squares / 30));
+  });
+  #ifdef USE_AGGREGATION
+  // Firmware path: reading added, window closed into sample
+  bench("aggregate_sample", [&]() {
+    Sample aggregated = sample;
+    aggregateAdd(aggregated);
+    keep(aggregateSample(aggregated));
+  });
+  #endif
+}
+
+static void benchConfig() {
+  // Host file system, includes file open/write/close
+  bench("config_save", []() { saveConfigFile(); });
+  bench("config_load", []() { keep(loadConfigFile()); });
+  // Load paths alone: binary record (every boot) and JSON (migration only)
+  bench("config_load_record", []() { keep(loadConfigRecord()); });
+  bench("config_load_json", []() { keep(loadConfigJson()); });
+}
+
+/***** Record log *****/
+// Logged sample of USE_SAMPLE_LOG
+struct BenchRecord {
+  uint64_t epochMillis;
+  uint32_t boot;
+  Sample sample;
+};
+static uint8_t logPage[256];
+
+// Empty log in a separate directory, 4 pages per segment
+static bool openLog(RecordLog& log, uint8_t segments) {
+  bool opened = log.begin(4, segments);
+  log.consume(log.pending());
+  return opened && log.pending() == 0 && log.segments() == 0;
+}
+
+// Records numbered from first, appended in full pages
+static void appendRecords(RecordLog& log, uint32_t first, uint32_t count) {
+  BenchRecord records[8] = {};
+  for (uint32_t i = 0; i < count; ) {
+    uint16_t n = min((uint32_t)log.pageRecords(), count - i);
+    for (uint16_t j = 0; j < n; j++)
+      records[j].boot = first + i + j;
+    log.append(records, n);
+    i += n;
+  }
+}
+
+// Next record number, UINT32_MAX at the end
+static uint32_t nextRecord(RecordLog& log) {
+  BenchRecord record;
+  return log.next(&record) ? record.boot : UINT32_MAX;
+}
+
+static void benchRecordLog() {
+  RecordLog log("/benchlog", sizeof(BenchRecord), logPage, sizeof(logPage));
+  if (!openLog(log, 8))
+    return;
+  // One page of samples, segments rotate (file created and deleted every 4 pages)
+  uint32_t next = 0;
+  bench("log_append_page", [&]() {
+    appendRecords(log, next, log.pageRecords());
+    next += log.pageRecords();
+  });
+  // Replay of 10 samples: read, then remove (cursor file written)
+  bench("log_replay_10", [&]() {
+    if (log.pending() < 10)
+      appendRecords(log, next, 8 * 4 * log.pageRecords() - log.pending());
+    log.rewind();
+    for (int i = 0; i < 10; i++)
+      keep(nextRecord(log));
+    log.consume(10);
+  });
+  log.consume(log.pending());
+}
+
+int main(int argc, char** argv) {
+  const char* output = "bench.json";
+  int option;
+  while ((option = getopt(argc, argv, "o:t:")) != -1) {
+    switch (option) {
+    case 'o': output = optarg; break;
+    case 't': minTimeMs = (uint32_t)atol(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-o bench.json] [-t min_time_ms] [filter]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (optind < argc)
+    filter = argv[optind];
+
+  // Firmware state as after a regular boot, debug output discarded
+  hal::serialOutput = false;
+  uint32_t latencyMicros = hal::influxLatencyMicros;
+  hal::influxLatencyMicros = 0;
+  // First boot saves configuration and restarts
+  for (int boot = 0; ; boot++) {
+    try {
+      setup();
+      break;
+    } catch (hal::Restart&) {
+      if (boot > 0) {
+        fprintf(stderr, "Firmware setup failed\n");
+        return 1;
+      }
+      hal::bootMicros = hal::clockMicros;
+    }
+  }
+  Sample sample = Sample();
+  readSample(sample);
+  if (!checkTransport(sample))
+    return 1;
+
+  benchEncoding(sample);
+  benchCompression(sample);
+  benchComputation();
+  benchAggregation(sample);
+  benchConfig();
+  benchRecordLog();
+  benchTransport(sample, latencyMicros);
+  #ifdef USE_DHT_SENSOR
+  benchDht();
+  #endif
+
+  if (!writeResults(output)) {
+    fprintf(stderr, "Cannot write %s\n", output);
+    return 1;
+  }
+  return 0;
+}
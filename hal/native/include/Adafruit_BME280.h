@@ -0,0 +1,43 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - BME280 sensor
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Deterministic mock of the Adafruit BME280 driver. Forced mode conversions
+ * complete after the datasheet measurement time, humidity follows its own
+ * mock sensor so it differs from the DHT one.
+ *****************************************************************************/
+#ifndef NATIVE_ADAFRUIT_BME280_H_
+#define NATIVE_ADAFRUIT_BME280_H_
+
+#include <Arduino.h>
+
+#define BME280_ADDRESS (0x77)
+#define BME280_ADDRESS_ALTERNATE (0x76)
+#define BME280_MOCK_SENSOR 10               // Mock sensor number of values
+
+class Adafruit_BME280 {
+public:
+  enum sensor_sampling { SAMPLING_NONE = 0b000, SAMPLING_X1 = 0b001, SAMPLING_X2 = 0b010, SAMPLING_X4 = 0b011, SAMPLING_X8 = 0b100, SAMPLING_X16 = 0b101 };
+  enum sensor_mode { MODE_SLEEP = 0b00, MODE_FORCED = 0b01, MODE_NORMAL = 0b11 };
+  enum sensor_filter { FILTER_OFF = 0b000, FILTER_X2 = 0b001, FILTER_X4 = 0b010, FILTER_X8 = 0b011, FILTER_X16 = 0b100 };
+  enum standby_duration { STANDBY_MS_0_5 = 0b000, STANDBY_MS_10 = 0b110, STANDBY_MS_20 = 0b111, STANDBY_MS_62_5 = 0b001,
+                          STANDBY_MS_125 = 0b010, STANDBY_MS_250 = 0b011, STANDBY_MS_500 = 0b100, STANDBY_MS_1000 = 0b101 };
+  bool begin(uint8_t addr = BME280_ADDRESS, void* = nullptr) { return addr == BME280_ADDRESS_ALTERNATE || addr == BME280_ADDRESS; }
+  void setSampling(sensor_mode mode = MODE_NORMAL, sensor_sampling = SAMPLING_X16, sensor_sampling = SAMPLING_X16,
+                   sensor_sampling = SAMPLING_X16, sensor_filter = FILTER_OFF, standby_duration = STANDBY_MS_0_5) {
+    _mode = mode;
+    if (mode == MODE_FORCED) _ready = micros() + 16200;
+  }
+  bool takeForcedMeasurement() { setSampling(MODE_FORCED); hal::advance(16200); return true; }
+  float readTemperature() { hal::advance(300); return hal::sensorFail ? NAN : hal::mockTemperature(BME280_MOCK_SENSOR); }
+  float readPressure() { hal::advance(600); return hal::sensorFail ? NAN : hal::mockPressure(BME280_MOCK_SENSOR); }
+  float readHumidity() { hal::advance(300); return hal::sensorFail ? NAN : hal::mockHumidity(BME280_MOCK_SENSOR); }
+  float readAltitude(float seaLevel = 1013.25) { return 44330 * (1.0f - powf(readPressure() / 100 / seaLevel, 0.1903f)); }
+private:
+  sensor_mode _mode = MODE_NORMAL;
+  uint32_t _ready = 0;
+};
+
+#endif
@@ -0,0 +1,41 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - BMP280 sensor
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Deterministic mock of the Adafruit BMP280 driver. Forced mode conversions
+ * complete after the datasheet measurement time.
+ *****************************************************************************/
+#ifndef NATIVE_ADAFRUIT_BMP280_H_
+#define NATIVE_ADAFRUIT_BMP280_H_
+
+#include <Arduino.h>
+
+#define BMP280_ADDRESS (0x77)
+#define BMP280_ADDRESS_ALT (0x76)
+
+class Adafruit_BMP280 {
+public:
+  enum sensor_sampling { SAMPLING_NONE = 0x00, SAMPLING_X1 = 0x01, SAMPLING_X2 = 0x02, SAMPLING_X4 = 0x03, SAMPLING_X8 = 0x04, SAMPLING_X16 = 0x05 };
+  enum sensor_mode { MODE_SLEEP = 0x00, MODE_FORCED = 0x01, MODE_NORMAL = 0x03, MODE_SOFT_RESET_CODE = 0xB6 };
+  enum sensor_filter { FILTER_OFF = 0x00, FILTER_X2 = 0x01, FILTER_X4 = 0x02, FILTER_X8 = 0x03, FILTER_X16 = 0x04 };
+  enum standby_duration { STANDBY_MS_1 = 0x00, STANDBY_MS_63 = 0x01, STANDBY_MS_125 = 0x02, STANDBY_MS_250 = 0x03,
+                          STANDBY_MS_500 = 0x04, STANDBY_MS_1000 = 0x05, STANDBY_MS_2000 = 0x06, STANDBY_MS_4000 = 0x07 };
+  bool begin(uint8_t addr = BMP280_ADDRESS, uint8_t = 0x58) { return addr == BMP280_ADDRESS_ALT || addr == BMP280_ADDRESS; }
+  void setSampling(sensor_mode mode = MODE_NORMAL, sensor_sampling = SAMPLING_X16, sensor_sampling = SAMPLING_X16,
+                   sensor_filter = FILTER_OFF, standby_duration = STANDBY_MS_1) {
+    _mode = mode;
+    if (mode == MODE_FORCED) _ready = micros() + 13300;
+  }
+  bool takeForcedMeasurement() { setSampling(MODE_FORCED); hal::advance(13300); return true; }
+  uint8_t getStatus() { return (int32_t)(micros() - _ready) < 0 ? 0x08 : 0x00; }
+  float readTemperature() { hal::advance(300); return hal::sensorFail ? NAN : hal::mockTemperature(1); }
+  float readPressure() { hal::advance(600); return hal::sensorFail ? NAN : hal::mockPressure(1); }
+  float readAltitude(float seaLevelhPa = 1013.25) { return 44330 * (1.0f - powf(readPressure() / 100 / seaLevelhPa, 0.1903f)); }
+private:
+  sensor_mode _mode = MODE_NORMAL;
+  uint32_t _ready = 0;
+};
+
+#endif
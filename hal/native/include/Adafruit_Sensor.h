@@ -0,0 +1,5 @@
+// Native (Linux) hardware abstraction - unified sensor base is not used
+#ifndef NATIVE_ADAFRUIT_SENSOR_H_
+#define NATIVE_ADAFRUIT_SENSOR_H_
+#include <Arduino.h>
+#endif
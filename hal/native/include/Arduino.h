@@ -0,0 +1,306 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - Arduino core
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Minimal subset of the ESP8266 Arduino core used by the firmware. Time is
+ * virtual: delay() advances the clock instead of sleeping, so the whole
+ * setup/loop pipeline runs as fast as the host allows.
+ *****************************************************************************/
+#ifndef NATIVE_ARDUINO_H_
+#define NATIVE_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+using std::min;
+using std::max;
+#include <time.h>
+#include <sys/time.h>
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+class __FlashStringHelper;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define LED_BUILTIN 2
+
+#define DEC 10
+#define HEX 16
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// ***** Clock
+namespace hal {
+// Virtual clock in microseconds, advanced by delay() and hal::advance()
+extern uint64_t clockMicros;
+// Virtual clock at boot, millis() and micros() start from zero at every boot
+extern uint64_t bootMicros;
+// Timed events (timers, sensor line edges), run by advance() when the clock reaches them
+typedef void (*Event)(void* arg);
+extern uint8_t eventCount;
+void schedule(uint64_t atMicros, Event event, void* arg);
+void cancel(Event event, void* arg);
+// Run events due until the clock time, clock is at event time while it runs
+void runEvents(uint64_t until);
+inline void advance(uint64_t us) { if (eventCount) runEvents(clockMicros + us); else clockMicros += us; }
+}
+inline uint32_t millis() { return (uint32_t)((hal::clockMicros - hal::bootMicros) / 1000); }
+inline uint32_t micros() { return (uint32_t)(hal::clockMicros - hal::bootMicros); }
+inline void delay(unsigned long ms) { hal::advance((uint64_t)ms * 1000); }
+inline void delayMicroseconds(unsigned int us) { hal::advance(us); }
+inline void yield() {}
+
+// ***** GPIO
+namespace hal {
+extern uint8_t pins[17];
+extern void (*interrupts[17])();
+extern void (*interruptArgs[17])(void*);
+extern void* interruptArg[17];
+// Pin level set by firmware, sensor line models react to it
+void lineChanged(uint8_t pin);
+// Call interrupt handler of pin
+void interrupt(uint8_t pin);
+}
+inline void pinMode(uint8_t pin, uint8_t mode) { if (pin < 17) { hal::pins[pin] = mode == INPUT_PULLUP ? HIGH : LOW; hal::lineChanged(pin); } }
+inline void digitalWrite(uint8_t pin, uint8_t value) { if (pin < 17) { hal::pins[pin] = value; hal::lineChanged(pin); } }
+inline int digitalRead(uint8_t pin) { return pin < 17 ? hal::pins[pin] : LOW; }
+inline void attachInterrupt(uint8_t pin, void (*isr)(), int) { if (pin < 17) hal::interrupts[pin] = isr; }
+inline void attachInterruptArg(uint8_t pin, void (*isr)(void*), void* arg, int) {
+  if (pin < 17) { hal::interruptArgs[pin] = isr; hal::interruptArg[pin] = arg; }
+}
+inline void detachInterrupt(uint8_t pin) { if (pin < 17) hal::interrupts[pin] = nullptr, hal::interruptArgs[pin] = nullptr; }
+inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// ***** String
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+// ESP8266 libc has strlcpy, glibc only since 2.38
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t length = strlen(src);
+  if (size > 0) {
+    size_t n = length < size - 1 ? length : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return length;
+}
+#endif
+
+class String {
+public:
+  String() {}
+  String(const char* s) : _s(s ? s : "") {}
+  String(const std::string& s) : _s(s) {}
+  String(char c) : _s(1, c) {}
+  String(int v) : _s(std::to_string(v)) {}
+  String(unsigned int v) : _s(std::to_string(v)) {}
+  String(long v) : _s(std::to_string(v)) {}
+  String(unsigned long v) : _s(std::to_string(v)) {}
+  String(long long v) : _s(std::to_string(v)) {}
+  String(unsigned long long v) : _s(std::to_string(v)) {}
+  String(float v, unsigned char decimals = 2) : String((double)v, decimals) {}
+  String(double v, unsigned char decimals = 2) {
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    _s = buf;
+  }
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.length(); }
+  bool reserve(unsigned int size) { _s.reserve(size); return true; }
+  bool concat(const String& s) { _s += s._s; return true; }
+  bool concat(const char* s) { _s += s; return true; }
+  bool concat(char c) { _s += c; return true; }
+  String& operator+=(const String& s) { _s += s._s; return *this; }
+  String& operator+=(const char* s) { _s += s; return *this; }
+  String& operator+=(char c) { _s += c; return *this; }
+  friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+  friend String operator+(const String& a, const char* b) { return String(a._s + b); }
+  bool operator==(const String& s) const { return _s == s._s; }
+  bool operator==(const char* s) const { return _s == s; }
+  bool operator!=(const String& s) const { return _s != s._s; }
+  char operator[](unsigned int i) const { return _s[i]; }
+  char charAt(unsigned int i) const { return _s[i]; }
+  int indexOf(char c, unsigned int from = 0) const { size_t p = _s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  String substring(unsigned int from, unsigned int to) const { return String(_s.substr(from, to - from)); }
+  String substring(unsigned int from) const { return String(_s.substr(from)); }
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return (float)atof(_s.c_str()); }
+  void remove(unsigned int index) { _s.erase(index); }
+  bool startsWith(const String& s) const { return _s.compare(0, s._s.size(), s._s) == 0; }
+  void toLowerCase() { for (auto& c : _s) c = (char)tolower(c); }
+  void trim() { _s.erase(0, _s.find_first_not_of(" \t\r\n")); _s.erase(_s.find_last_not_of(" \t\r\n") + 1); }
+private:
+  std::string _s;
+};
+
+// ***** Print / Stream
+class Print;
+class Printable {
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+  }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const char* s) { return write(s); }
+  size_t print(const __FlashStringHelper* s) { return write((const char*)s); }
+  size_t print(const String& s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v, int base = DEC) { return printNumber((long long)v, base); }
+  size_t print(unsigned int v, int base = DEC) { return printNumber((long long)v, base); }
+  size_t print(long v, int base = DEC) { return printNumber((long long)v, base); }
+  size_t print(unsigned long v, int base = DEC) { return printNumber((long long)v, base); }
+  size_t print(long long v, int base = DEC) { return printNumber(v, base); }
+  size_t print(unsigned long long v, int base = DEC) { return printNumber((long long)v, base); }
+  size_t print(const Printable& p) { return p.printTo(*this); }
+  size_t print(double v, int digits = 2) { char b[40]; snprintf(b, sizeof(b), "%.*f", digits, v); return write(b); }
+  template <typename... A> size_t println(A... a) { size_t n = print(a...); return n + write("\r\n"); }
+  size_t println() { return write("\r\n"); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+private:
+  size_t printNumber(long long v, int base) {
+    char b[24];
+    snprintf(b, sizeof(b), base == HEX ? "%llX" : "%lld", v);
+    return write(b);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char* buffer, size_t length) {
+    size_t n = 0;
+    int c;
+    while (n < length && (c = read()) >= 0) buffer[n++] = (char)c;
+    return n;
+  }
+  size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+  // Network streams block in read() up to their timeout, so no extra waiting is done here
+  size_t readBytesUntil(char terminator, char* buffer, size_t length) {
+    size_t n = 0;
+    int c;
+    while (n < length && (c = read()) >= 0 && c != terminator) buffer[n++] = (char)c;
+    return n;
+  }
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  unsigned long getTimeout() const { return _timeout; }
+protected:
+  unsigned long _timeout = 1000;
+};
+
+namespace hal {
+extern bool serialOutput;                   // Serial output goes to stdout, false = discarded
+// Deterministic sensor model, phase shifts sensors against each other
+float mockTemperature(uint8_t sensor);
+float mockHumidity(uint8_t sensor);
+float mockPressure(uint8_t sensor);
+extern bool sensorFail;                     // Simulate sensor read failures
+extern uint8_t dhtPin;                      // Pin of DHT line model (DhtReader), D6
+}
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override { return !hal::serialOutput ? 1 : fputc(c, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buffer, size_t size) override { return !hal::serialOutput ? size : fwrite(buffer, 1, size, stdout); }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  using Print::write;
+};
+extern HardwareSerial Serial;
+
+// ***** ESP specific
+#define RF_DEFAULT 0
+#define RF_CAL 1
+#define RF_NO_CAL 2
+#define RF_DISABLED 4
+typedef int RFMode;
+
+namespace hal {
+// Thrown by ESP.restart() and ESP.deepSleep(), caught by the native runner
+struct Restart {
+  uint64_t sleepUs;                         // Requested deep sleep, 0 for restart
+  RFMode mode;                              // Radio mode after wake up
+};
+extern uint32_t rtcMemory[128];             // RTC user memory, survives Restart
+extern uint32_t freeHeap;                   // Reported free heap
+}
+
+class EspClass {
+public:
+  uint32_t getChipId() { return 0x00C0FFEE; }
+  [[noreturn]] void restart() { throw hal::Restart{0, RF_DEFAULT}; }
+  [[noreturn]] void reset() { restart(); }
+  [[noreturn]] void deepSleep(uint64_t us, RFMode mode = RF_DEFAULT) { throw hal::Restart{us, mode}; }
+  [[noreturn]] void deepSleepInstant(uint64_t us, RFMode mode = RF_DEFAULT) { deepSleep(us, mode); }
+  uint64_t deepSleepMax() { return 3600000000ULL * 3; }
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+    if (offset * 4 + size > sizeof(hal::rtcMemory)) return false;
+    memcpy(data, (uint8_t*)hal::rtcMemory + offset * 4, size);
+    return true;
+  }
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+    if (offset * 4 + size > sizeof(hal::rtcMemory)) return false;
+    memcpy((uint8_t*)hal::rtcMemory + offset * 4, data, size);
+    return true;
+  }
+  uint32_t getFreeHeap() { return hal::freeHeap; }
+  uint32_t getMaxFreeBlockSize() { return hal::freeHeap * 3 / 4; }
+  uint8_t getHeapFragmentation() { return 25; }
+  void getHeapStats(uint32_t* hfree, uint32_t* hmax, uint8_t* hfrag) {
+    if (hfree) *hfree = getFreeHeap();
+    if (hmax) *hmax = getMaxFreeBlockSize();
+    if (hfrag) *hfrag = getHeapFragmentation();
+  }
+  uint32_t getCycleCount() { return (uint32_t)(hal::clockMicros * 80); }
+  // Hardware random number generator, differs between boots of the runner
+  uint32_t random() { uint32_t r = 0; FILE* f = fopen("/dev/urandom", "rb"); if (f) { if (fread(&r, sizeof(r), 1, f) != 1) r = 0; fclose(f); } return r; }
+  String getResetReason() { return String("Deep-Sleep Wake"); }
+};
+extern EspClass ESP;
+
+#endif
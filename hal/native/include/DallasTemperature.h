@@ -0,0 +1,70 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - DS18B20 sensors
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Bus with hal::dallasCount deterministic devices. Timing follows the real
+ * driver: conversion takes 94 to 750 ms by resolution, every index lookup
+ * re-enumerates the bus. Devices answer without begin() (addresses known).
+ *****************************************************************************/
+#ifndef NATIVE_DALLASTEMPERATURE_H_
+#define NATIVE_DALLASTEMPERATURE_H_
+
+#include <OneWire.h>
+
+#define DEVICE_DISCONNECTED_C -127
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature {
+public:
+  DallasTemperature(OneWire* wire) : _wire(wire) {}
+  void begin() { hal::advance(3000 * hal::dallasCount + 1000); _devices = hal::dallasCount; }
+  uint8_t getDeviceCount() { return _devices; }
+  uint8_t getDS18Count() { return _devices; }
+  bool getAddress(uint8_t* address, uint8_t index) {
+    if (index >= _devices) return false;
+    hal::advance(3000 * (index + 1));
+    OneWire::rom(index, address);
+    return true;
+  }
+  bool validAddress(const uint8_t* address) { return OneWire::crc8(address, 7) == address[7]; }
+  bool validFamily(const uint8_t* address) { return address[0] == 0x28 || address[0] == 0x10 || address[0] == 0x22; }
+  bool readPowerSupply(const uint8_t* = nullptr) { hal::advance(1000); return false; } // All devices on VDD
+  bool isParasitePowerMode() { return false; }
+  bool isConnected(const uint8_t* address) { return address[0] == 0x28 && address[1] - 0x11 < hal::dallasCount; }
+  void setResolution(uint8_t resolution) { _resolution = resolution < 9 ? 9 : resolution > 12 ? 12 : resolution; }
+  bool setResolution(const uint8_t*, uint8_t resolution, bool = false) { setResolution(resolution); return true; }
+  uint8_t getResolution() { return _resolution; }
+  void setWaitForConversion(bool wait) { _wait = wait; }
+  bool getWaitForConversion() { return _wait; }
+  uint16_t millisToWaitForConversion(uint8_t resolution) {
+    switch (resolution) { case 9: return 94; case 10: return 188; case 11: return 375; default: return 750; }
+  }
+  bool isConversionComplete() { return (int32_t)(millis() - _ready) >= 0; }
+  struct request_t { bool result; unsigned long timestamp; operator bool() { return result; } };
+  request_t requestTemperatures() {
+    _ready = millis() + millisToWaitForConversion(_resolution);
+    if (_wait) delay(millisToWaitForConversion(_resolution));
+    return request_t{hal::dallasCount > 0, millis()};
+  }
+  float getTempC(const uint8_t* address) {
+    hal::advance(12000);
+    if (hal::sensorFail || !isConnected(address)) return DEVICE_DISCONNECTED_C;
+    return quantize(hal::mockTemperature(2 + address[1] - 0x11));
+  }
+  float getTempCByIndex(uint8_t index) {
+    DeviceAddress address;
+    if (!getAddress(address, index)) return DEVICE_DISCONNECTED_C;
+    return getTempC(address);
+  }
+private:
+  float quantize(float t) { float step = 0.0625f * (1 << (12 - _resolution)); return roundf(t / step) * step; }
+  OneWire* _wire;
+  uint8_t _devices = 0;
+  uint8_t _resolution = 12;
+  bool _wait = true;
+  uint32_t _ready = 0;
+};
+
+#endif
@@ -0,0 +1,5 @@
+// Native (Linux) hardware abstraction - web server is provided by WiFiManager only
+#ifndef NATIVE_ESP8266WEBSERVER_H_
+#define NATIVE_ESP8266WEBSERVER_H_
+#include <ESP8266WiFi.h>
+#endif
@@ -0,0 +1,105 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - WiFi
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Simulated station interface. Link state and signal are driven by the
+ * harness through hal::wifiUp and hal::wifiRssi. Connect time is scan,
+ * association and DHCP; known channel and BSSID skip the scan, static IP
+ * skips DHCP.
+ *****************************************************************************/
+#ifndef NATIVE_ESP8266WIFI_H_
+#define NATIVE_ESP8266WIFI_H_
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_WRONG_PASSWORD = 6,
+  WL_DISCONNECTED = 7
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } WiFiMode_t;
+
+class IPAddress : public Printable {
+public:
+  IPAddress() : _address(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+  IPAddress(uint32_t address) : _address(address) {}
+  operator uint32_t() const { return _address; }
+  bool isSet() const { return _address != 0; }
+  String toString() const {
+    char b[16];
+    snprintf(b, sizeof(b), "%u.%u.%u.%u", _address & 0xFF, _address >> 8 & 0xFF, _address >> 16 & 0xFF, _address >> 24);
+    return String(b);
+  }
+  size_t printTo(Print& p) const override { return p.print(toString()); }
+private:
+  uint32_t _address;
+};
+
+namespace hal {
+extern bool wifiUp;                         // Access point reachable
+extern int32_t wifiRssi;                    // Reported signal strength
+extern uint32_t wifiConnectMicros;          // Simulated scan + association + DHCP time
+extern uint32_t wifiScanMicros;             // Part of connect time skipped with known channel and BSSID
+extern uint32_t wifiDhcpMicros;             // Part of connect time skipped with static IP
+extern bool wifiApMoved;                    // Access point changed channel and BSSID
+extern uint32_t wifiConnects;               // Full connects (scan)
+extern uint32_t wifiDirectConnects;         // Connects to known channel and BSSID
+}
+
+class ESP8266WiFiClass {
+public:
+  wl_status_t status() { return _mode != WIFI_OFF && _connected && hal::wifiUp ? WL_CONNECTED : WL_DISCONNECTED; }
+  bool isConnected() { return status() == WL_CONNECTED; }
+  String SSID() { return String("native"); }
+  String psk() { return String("native-psk"); }
+  int32_t RSSI() { return hal::wifiRssi; }
+  int32_t channel() { return 6; }
+  uint8_t* BSSID() { return _bssid; }
+  String BSSIDstr() { return String("02:00:00:00:00:01"); }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress gatewayIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress subnetMask() { return IPAddress(255, 0, 0, 0); }
+  IPAddress dnsIP(uint8_t = 0) { return IPAddress(127, 0, 0, 1); }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+  bool mode(WiFiMode_t mode) { _mode = mode; if (mode == WIFI_OFF) _connected = false; return true; }
+  WiFiMode_t getMode() { return _mode; }
+  bool persistent(bool) { return true; }
+  bool setAutoConnect(bool) { return true; }
+  bool setAutoReconnect(bool) { return true; }
+  // Zero local IP returns to DHCP
+  bool config(IPAddress local, IPAddress, IPAddress, IPAddress = IPAddress(), IPAddress = IPAddress()) { _static = local.isSet(); return true; }
+  wl_status_t begin() { return begin(nullptr); }
+  // Not connect only sets the station configuration for the next begin()
+  wl_status_t begin(const char*, const char* = nullptr, int32_t channel = 0, const uint8_t* bssid = nullptr, bool connect = true) {
+    if (_mode == WIFI_OFF) _mode = WIFI_STA;
+    bool direct = channel > 0 && bssid;
+    _connected = connect && hal::wifiUp && !(direct && hal::wifiApMoved);
+    if (!_connected) return status();
+    hal::advance(hal::wifiConnectMicros - (direct ? hal::wifiScanMicros : 0) - (_static ? hal::wifiDhcpMicros : 0));
+    if (direct) hal::wifiDirectConnects++; else hal::wifiConnects++;
+    return status();
+  }
+  bool reconnect() { begin(); return isConnected(); }
+  bool disconnect(bool wifiOff = false) { _connected = false; if (wifiOff) _mode = WIFI_OFF; return true; }
+  bool forceSleepBegin(uint32_t = 0) { _mode = WIFI_OFF; _connected = false; return true; }
+  bool forceSleepWake() { return true; }
+  bool hostByName(const char*, IPAddress& result) { result = IPAddress(127, 0, 0, 1); return true; }
+  int32_t scanNetworks() { hal::advance(2000000); return 1; }
+private:
+  WiFiMode_t _mode = WIFI_OFF;
+  bool _connected = false;
+  bool _static = false;                     // Static IP configured
+  uint8_t _bssid[6] = {2, 0, 0, 0, 0, 1};
+};
+extern ESP8266WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,74 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - InfluxDB client
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Point class of tobiasschuerg/ESP8266 Influxdb, kept for the benchmark
+ * comparing String based encoding with the LineProtocol library.
+ *****************************************************************************/
+#ifndef NATIVE_INFLUXDBCLIENT_H_
+#define NATIVE_INFLUXDBCLIENT_H_
+
+#include <Arduino.h>
+
+enum class WritePrecision : uint8_t { NoTime = 0, S, MS, US, NS };
+
+class Point {
+public:
+  Point(const String& measurement) : _measurement(escape(measurement, ", ")) {}
+  void addTag(const String& name, String value) {
+    if (_tags.length()) _tags += ',';
+    _tags += escape(name, ",= ");
+    _tags += '=';
+    _tags += escape(value, ",= ");
+  }
+  void addField(const String& name, int value) { putField(name, String(value) + "i"); }
+  void addField(const String& name, long value) { putField(name, String(value) + "i"); }
+  void addField(const String& name, unsigned int value) { putField(name, String(value) + "i"); }
+  void addField(const String& name, unsigned long value) { putField(name, String(value) + "i"); }
+  void addField(const String& name, long long value) { putField(name, String(value) + "i"); }
+  void addField(const String& name, unsigned long long value) { putField(name, String(value) + "i"); }
+  void addField(const String& name, bool value) { putField(name, value ? "true" : "false"); }
+  void addField(const String& name, float value, int decimalPlaces = 2) { if (!isnan(value)) putField(name, String(value, decimalPlaces)); }
+  void addField(const String& name, double value, int decimalPlaces = 2) { if (!isnan(value)) putField(name, String(value, decimalPlaces)); }
+  void addField(const String& name, const char* value) { putField(name, String("\"") + escape(value, "\"\\") + "\""); }
+  void setTime(unsigned long long timestamp) { _timestamp = String(timestamp); }
+  void setTime(const String& timestamp) { _timestamp = timestamp; }
+  void clearFields() { _fields = String(); _timestamp = String(); }
+  void clearTags() { _tags = String(); }
+  bool hasFields() const { return _fields.length() > 0; }
+  bool hasTags() const { return _tags.length() > 0; }
+  bool hasTime() const { return _timestamp.length() > 0; }
+  String getName() const { return _measurement; }
+  String toLineProtocol(const String& includeTags = "") const {
+    String line = _measurement;
+    if (_tags.length()) { line += ','; line += _tags; }
+    if (includeTags.length()) { line += ','; line += includeTags; }
+    line += ' ';
+    line += _fields;
+    if (_timestamp.length()) { line += ' '; line += _timestamp; }
+    return line;
+  }
+private:
+  static String escape(const String& s, const char* special) {
+    String out;
+    for (unsigned int i = 0; i < s.length(); i++) {
+      if (strchr(special, s[i])) out += '\\';
+      out += s[i];
+    }
+    return out;
+  }
+  void putField(const String& name, const String& value) {
+    if (_fields.length()) _fields += ',';
+    _fields += escape(name, ",= ");
+    _fields += '=';
+    _fields += value;
+  }
+  String _measurement;
+  String _tags;
+  String _fields;
+  String _timestamp;
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - LittleFS
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * File system backed by a host directory (hal::fsRoot, "littlefs" by
+ * default). Paths are mapped 1:1 below the root directory.
+ *****************************************************************************/
+#ifndef NATIVE_LITTLEFS_H_
+#define NATIVE_LITTLEFS_H_
+
+#include <Arduino.h>
+
+namespace hal {
+extern const char* fsRoot;                  // Host directory used as flash
+}
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream {
+public:
+  File(FILE* f = nullptr, const char* name = "") : _f(f), _name(name) {}
+  File(const File&) = delete;
+  File& operator=(const File&) = delete;
+  File(File&& other) noexcept : _f(other._f), _name(other._name) { other._f = nullptr; }
+  File& operator=(File&& other) noexcept { close(); _f = other._f; _name = other._name; other._f = nullptr; return *this; }
+  ~File() { close(); }
+  explicit operator bool() const { return _f != nullptr; }
+  size_t write(uint8_t c) override { return _f && fputc(c, _f) != EOF ? 1 : 0; }
+  size_t write(const uint8_t* buffer, size_t size) override { return _f ? fwrite(buffer, 1, size, _f) : 0; }
+  using Print::write;
+  int available() override { return _f ? (int)(size() - position()) : 0; }
+  int read() override { return _f ? fgetc(_f) : -1; }
+  int peek() override { if (!_f) return -1; int c = fgetc(_f); if (c != EOF) ungetc(c, _f); return c; }
+  size_t read(uint8_t* buffer, size_t size) { return _f ? fread(buffer, 1, size, _f) : 0; }
+  size_t readBytes(char* buffer, size_t length) override { return read((uint8_t*)buffer, length); }
+  bool seek(uint32_t pos, SeekMode mode = SeekSet) { return _f && fseek(_f, pos, mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END) == 0; }
+  size_t position() const { return _f ? (size_t)ftell(_f) : 0; }
+  size_t size() const {
+    if (!_f) return 0;
+    long pos = ftell(_f);
+    fseek(_f, 0, SEEK_END);
+    long end = ftell(_f);
+    fseek(_f, pos, SEEK_SET);
+    return (size_t)end;
+  }
+  bool truncate(uint32_t size);
+  void flush() { if (_f) fflush(_f); }
+  void close() { if (_f) { fclose(_f); _f = nullptr; } }
+  const char* name() const { return _name.c_str(); }
+private:
+  FILE* _f;
+  String _name;
+};
+
+class Dir {
+public:
+  Dir(const String& path = String()) : _path(path) {}
+  bool next();
+  String fileName() const { return _current; }
+  size_t fileSize() const;
+  bool rewind() { _index = 0; return true; }
+private:
+  String _path;
+  String _current;
+  size_t _index = 0;
+};
+
+struct FSInfo {
+  size_t totalBytes;
+  size_t usedBytes;
+  size_t blockSize;
+  size_t pageSize;
+  size_t maxOpenFiles;
+  size_t maxPathLength;
+};
+
+class FS {
+public:
+  bool begin();
+  void end() {}
+  bool format();
+  bool info(FSInfo& info);
+  File open(const char* path, const char* mode);
+  File open(const String& path, const char* mode) { return open(path.c_str(), mode); }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to);
+  bool mkdir(const char* path);
+  Dir openDir(const char* path) { return Dir(String(path)); }
+};
+extern FS LittleFS;
+
+#endif
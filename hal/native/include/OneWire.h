@@ -0,0 +1,43 @@
+// Native (Linux) hardware abstraction - OneWire bus, devices live in DallasTemperature
+#ifndef NATIVE_ONEWIRE_H_
+#define NATIVE_ONEWIRE_H_
+#include <Arduino.h>
+namespace hal {
+extern uint8_t dallasCount;                 // Devices present on the bus
+}
+class OneWire {
+public:
+  OneWire(uint8_t pin) : _pin(pin) {}
+  uint8_t pin() const { return _pin; }
+  void reset_search() { _next = 0; }
+  // Next device ROM, every 64 bit search costs about 3 ms
+  bool search(uint8_t* address, bool = true) {
+    if (_next >= hal::dallasCount) { hal::advance(1000); return false; }
+    hal::advance(3000);
+    rom(_next++, address);
+    return true;
+  }
+  // Deterministic ROM of device index
+  static void rom(uint8_t index, uint8_t* address) {
+    address[0] = 0x28;
+    for (uint8_t i = 1; i < 7; i++) address[i] = (uint8_t)(0x11 * i + index);
+    address[7] = crc8(address, 7);
+  }
+  static uint8_t crc8(const uint8_t* addr, uint8_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+      uint8_t inbyte = *addr++;
+      for (uint8_t i = 8; i; i--) {
+        uint8_t mix = (crc ^ inbyte) & 0x01;
+        crc >>= 1;
+        if (mix) crc ^= 0x8C;
+        inbyte >>= 1;
+      }
+    }
+    return crc;
+  }
+private:
+  uint8_t _pin;
+  uint8_t _next = 0;
+};
+#endif
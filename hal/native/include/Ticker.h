@@ -0,0 +1,43 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - Ticker
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * One shot timers of the ESP8266 core Ticker, run as virtual clock events.
+ *****************************************************************************/
+#ifndef NATIVE_TICKER_H_
+#define NATIVE_TICKER_H_
+
+#include <Arduino.h>
+
+class Ticker {
+public:
+  ~Ticker() { detach(); }
+  template <typename TArg>
+  void once_ms(uint32_t milliseconds, void (*callback)(TArg), TArg arg) {
+    static_assert(sizeof(TArg) <= sizeof(void*), "Ticker argument must fit into a pointer");
+    detach();
+    _callback = (void (*)(void*))callback;
+    _arg = (void*)arg;
+    _armed = true;
+    hal::schedule(hal::clockMicros + (uint64_t)milliseconds * 1000, fire, this);
+  }
+  void detach() {
+    if (_armed)
+      hal::cancel(fire, this);
+    _armed = false;
+  }
+  bool active() const { return _armed; }
+private:
+  static void fire(void* ticker) {
+    Ticker* self = (Ticker*)ticker;
+    self->_armed = false;
+    self->_callback(self->_arg);
+  }
+  void (*_callback)(void*) = nullptr;
+  void* _arg = nullptr;
+  bool _armed = false;
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - TCP client
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Connects either to a simulated InfluxDB server, which answers HTTP
+ * requests in virtual time, or over a real socket to hal::influxServer
+ * (e.g. tools/influxdb_standin.py), see network.cpp.
+ *****************************************************************************/
+#ifndef NATIVE_WIFICLIENT_H_
+#define NATIVE_WIFICLIENT_H_
+
+#include <Arduino.h>
+
+namespace hal {
+struct Connection;
+// Simulated server
+extern int influxStatus;                    // Status returned by the write API
+extern uint32_t influxLatencyMicros;        // Request round trip on open connection
+extern uint32_t influxRetryAfter;           // Retry-After sent with 429 and 503 (s)
+extern uint32_t serverIdleMicros;           // Server closes idle connection after
+extern uint32_t tcpConnectMicros;           // DNS and TCP connect
+extern uint32_t tlsHandshakeMicros;         // Full TLS handshake
+extern uint32_t tlsResumeMicros;            // TLS handshake with resumed session
+// Real server URL (http://host:port), nullptr = simulated server
+extern const char* influxServer;
+// Counters
+extern uint32_t influxRequests;             // Write requests sent
+extern uint32_t influxLines;                // Lines sent
+extern uint32_t tcpConnects;                // Opened connections
+extern uint32_t tlsHandshakes;              // TLS handshakes
+extern uint32_t tlsResumed;                 // TLS handshakes with resumed session
+}
+
+class WiFiClient : public Stream {
+public:
+  WiFiClient() {}
+  WiFiClient(const WiFiClient&) = delete;
+  WiFiClient& operator=(const WiFiClient&) = delete;
+  virtual ~WiFiClient() { stop(); }
+  virtual int connect(const char* host, uint16_t port);
+  int connect(const String& host, uint16_t port) { return connect(host.c_str(), port); }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char* buffer, size_t length) override;
+  virtual uint8_t connected();
+  virtual void stop();
+  void setNoDelay(bool) {}
+  void flush() {}
+  explicit operator bool() { return connected(); }
+protected:
+  hal::Connection* _connection = nullptr;
+};
+
+#endif
@@ -0,0 +1,53 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - BearSSL TLS client
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * No encryption on the host, the handshake is only counted and its cost is
+ * added to the virtual clock: full handshake, or a shorter one when a valid
+ * session is offered.
+ *****************************************************************************/
+#ifndef NATIVE_WIFICLIENTSECUREBEARSSL_H_
+#define NATIVE_WIFICLIENTSECUREBEARSSL_H_
+
+#include <WiFiClient.h>
+
+namespace BearSSL {
+
+class WiFiClientSecure;
+
+class Session {
+  friend class WiFiClientSecure;
+public:
+  Session() {}
+private:
+  bool _valid = false;                      // Parameters of a finished handshake are stored
+};
+
+class WiFiClientSecure : public WiFiClient {
+public:
+  int connect(const char* host, uint16_t port) override {
+    if (!WiFiClient::connect(host, port))
+      return 0;
+    bool resume = _session && _session->_valid;
+    hal::advance(resume ? hal::tlsResumeMicros : hal::tlsHandshakeMicros);
+    hal::tlsHandshakes++;
+    if (resume)
+      hal::tlsResumed++;
+    if (_session)
+      _session->_valid = true;
+    return 1;
+  }
+  using WiFiClient::connect;
+  void setInsecure() {}
+  void setSession(Session* session) { _session = session; }
+  void setBufferSizes(int, int) {}
+  bool probeMaxFragmentLength(const char*, uint16_t, uint16_t) { return false; }
+private:
+  Session* _session = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - WiFiManager
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Configuration portal is never shown on the host; autoConnect() joins the
+ * simulated network and portal parameters keep their default values.
+ *****************************************************************************/
+#ifndef NATIVE_WIFIMANAGER_H_
+#define NATIVE_WIFIMANAGER_H_
+
+#include <ESP8266WiFi.h>
+
+class WiFiManagerParameter {
+public:
+  WiFiManagerParameter(const char* custom) : _id(nullptr), _label(custom), _length(0) {}
+  WiFiManagerParameter(const char* id, const char* label, const char* defaultValue, int length)
+    : _id(id), _label(label), _length(length) {
+    _value = new char[length + 1];
+    strncpy(_value, defaultValue ? defaultValue : "", length);
+    _value[length] = 0;
+  }
+  ~WiFiManagerParameter() { delete[] _value; }
+  WiFiManagerParameter(const WiFiManagerParameter&) = delete;
+  WiFiManagerParameter& operator=(const WiFiManagerParameter&) = delete;
+  const char* getID() const { return _id; }
+  const char* getValue() const { return _value ? _value : ""; }
+  const char* getLabel() const { return _label; }
+  int getValueLength() const { return _length; }
+  void setValue(const char* value, int length) { if (_value) { strncpy(_value, value, _length); _value[length < _length ? length : _length] = 0; } }
+private:
+  const char* _id;
+  const char* _label;
+  int _length;
+  char* _value = nullptr;
+};
+
+class WiFiManager {
+public:
+  void setDebugOutput(bool) {}
+  void setSaveConfigCallback(void (*func)()) { _saveCallback = func; }
+  void setAPCallback(void (*func)(WiFiManager*)) { _apCallback = func; }
+  void setConfigPortalTimeout(unsigned long seconds) { _timeout = seconds; }
+  bool addParameter(WiFiManagerParameter* p) { (void)p; return true; }
+  bool autoConnect(const char* apName = nullptr, const char* = nullptr) {
+    _apName = apName;
+    WiFi.mode(WIFI_STA);
+    return WiFi.begin() == WL_CONNECTED;
+  }
+  bool startConfigPortal(const char* apName = nullptr, const char* = nullptr) {
+    _apName = apName;
+    if (_apCallback) _apCallback(this);
+    if (_saveCallback) _saveCallback();
+    return autoConnect(apName);
+  }
+  String getConfigPortalSSID() { return String(_apName ? _apName : ""); }
+private:
+  void (*_saveCallback)() = nullptr;
+  void (*_apCallback)(WiFiManager*) = nullptr;
+  unsigned long _timeout = 0;
+  const char* _apName = nullptr;
+};
+
+#endif
@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - UDP
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * NTP client packets are answered by a simulated NTP server in virtual time.
+ * The server has the true time, the device clock (virtual clock) runs faster
+ * by hal::clockDriftPpm, see network.cpp. Other packets are line protocol
+ * datagrams, counted and dropped, or forwarded to a real socket at
+ * hal::udpSink. Each datagram takes hal::udpSendMicros of radio time.
+ *****************************************************************************/
+#ifndef NATIVE_WIFIUDP_H_
+#define NATIVE_WIFIUDP_H_
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+namespace hal {
+extern uint64_t epochMillis;                // True Unix time at virtual clock zero (ms)
+extern int32_t clockDriftPpm;               // Device clock runs faster than true time (ppm)
+extern uint32_t ntpLatencyMicros;           // NTP request round trip
+extern bool ntpUp;                          // NTP server reachable
+extern uint32_t ntpRequests;                // NTP requests sent
+extern uint32_t udpSendMicros;              // Line protocol datagram send (stack and airtime)
+extern const char* udpSink;                 // Real listener host:port, nullptr = dropped
+extern uint32_t udpDatagrams;               // Line protocol datagrams sent
+// True time (Unix ms) at the virtual clock value
+uint64_t trueMillis(uint64_t clockMicros);
+}
+
+class WiFiUDP : public Stream {
+public:
+  uint8_t begin(uint16_t port) { _port = port; return 1; }
+  void stop() { _port = 0; _input.clear(); _response.clear(); }
+  int beginPacket(const char* host, uint16_t port);
+  int beginPacket(IPAddress ip, uint16_t port) { return beginPacket(ip.toString().c_str(), port); }
+  int endPacket();
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  int parsePacket();
+  int available() override { return (int)_input.size(); }
+  int read() override;
+  int read(uint8_t* buffer, size_t length);
+  int read(char* buffer, size_t length) { return read((uint8_t*)buffer, length); }
+  int peek() override { return _input.empty() ? -1 : (uint8_t)_input[0]; }
+  void flush() { endPacket(); }
+private:
+  uint16_t _port = 0;
+  uint16_t _remotePort = 0;
+  std::string _output;                      // Packet being written
+  std::string _input;                       // Packet being read
+  std::string _response;                    // Simulated server response not delivered yet
+  uint64_t _responseAt = 0;                 // Delivery time of response (virtual clock)
+};
+
+#endif
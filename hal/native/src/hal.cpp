@@ -0,0 +1,252 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - shared state and host services
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************/
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <LittleFS.h>
+#include <DallasTemperature.h>
+#include <stdarg.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hal {
+uint64_t clockMicros = 0;
+uint64_t bootMicros = 0;
+uint8_t pins[17];
+void (*interrupts[17])();
+void (*interruptArgs[17])(void*);
+void* interruptArg[17];
+uint8_t eventCount = 0;
+uint8_t dhtPin = D6;
+uint32_t rtcMemory[128];
+uint32_t freeHeap = 40000;
+bool wifiUp = true;
+int32_t wifiRssi = -60;
+uint32_t wifiConnectMicros = 1500000;
+uint32_t wifiScanMicros = 1100000;
+uint32_t wifiDhcpMicros = 250000;
+bool wifiApMoved = false;
+uint32_t wifiConnects = 0;
+uint32_t wifiDirectConnects = 0;
+const char* fsRoot = "littlefs";
+bool sensorFail = false;
+uint8_t dallasCount = 2;
+bool serialOutput = true;
+
+// Slow deterministic waveforms, one day period, sensors phase shifted
+float mockTemperature(uint8_t sensor) {
+  double t = clockMicros / 1e6;
+  return (float)(21.0 + 3.0 * sin(2 * M_PI * t / 86400 + sensor) + 0.1 * sensor);
+}
+float mockHumidity(uint8_t sensor) {
+  double t = clockMicros / 1e6;
+  return (float)(45.0 + 10.0 * cos(2 * M_PI * t / 86400 + sensor));
+}
+float mockPressure(uint8_t sensor) {
+  double t = clockMicros / 1e6;
+  return (float)(101325.0 + 250.0 * sin(2 * M_PI * t / 43200 + sensor));
+}
+
+// ***** Timed events
+struct TimedEvent {
+  uint64_t at;
+  Event event;
+  void* arg;
+};
+static TimedEvent events[64];
+
+void schedule(uint64_t atMicros, Event event, void* arg) {
+  if (eventCount < sizeof(events) / sizeof(events[0]))
+    events[eventCount++] = { atMicros, event, arg };
+}
+
+void cancel(Event event, void* arg) {
+  for (uint8_t i = 0; i < eventCount; ) {
+    if (events[i].event == event && events[i].arg == arg)
+      events[i] = events[--eventCount];
+    else
+      i++;
+  }
+}
+
+void runEvents(uint64_t until) {
+  while (eventCount) {
+    uint8_t next = 0;
+    for (uint8_t i = 1; i < eventCount; i++)
+      if (events[i].at < events[next].at)
+        next = i;
+    if (events[next].at > until)
+      break;
+    TimedEvent due = events[next];
+    events[next] = events[--eventCount];
+    if (due.at > clockMicros)
+      clockMicros = due.at;
+    due.event(due.arg);
+  }
+  if (until > clockMicros)
+    clockMicros = until;
+}
+
+void interrupt(uint8_t pin) {
+  if (interruptArgs[pin])
+    interruptArgs[pin](interruptArg[pin]);
+  else if (interrupts[pin])
+    interrupts[pin]();
+}
+
+// ***** DHT sensor line
+// Start pulse of at least 18 ms gets DHT11 frame, shorter (at least 0.8 ms) DHT22 frame.
+// Falling edges follow datasheet timing with a few us of deterministic jitter.
+static uint64_t dhtLowSince = 0;
+static uint32_t dhtJitter = 1;
+
+static void dhtEdge(void*) {
+  pins[dhtPin] = LOW;
+  interrupt(dhtPin);
+}
+
+static uint32_t dhtJitterMicros() {
+  dhtJitter = dhtJitter * 1103515245 + 12345;
+  return (dhtJitter >> 16) % 7;
+}
+
+void lineChanged(uint8_t pin) {
+  if (pin != dhtPin)
+    return;
+  if (pins[pin] == LOW) {
+    if (dhtLowSince == 0)
+      dhtLowSince = clockMicros;
+    return;
+  }
+  uint64_t pulse = dhtLowSince ? clockMicros - dhtLowSince : 0;
+  dhtLowSince = 0;
+  if (pulse < 800 || sensorFail)
+    return;
+  uint8_t data[5];
+  float t = mockTemperature(0);
+  float h = mockHumidity(0);
+  if (pulse >= 18000) {
+    // Integer and tenths, positive temperatures only
+    data[0] = (uint8_t)h;
+    data[1] = (uint8_t)((h - (uint8_t)h) * 10);
+    data[2] = (uint8_t)t;
+    data[3] = (uint8_t)((t - (uint8_t)t) * 10);
+  }
+  else {
+    uint16_t h10 = (uint16_t)lroundf(h * 10);
+    uint16_t t10 = (uint16_t)lroundf(fabsf(t) * 10);
+    data[0] = h10 >> 8;
+    data[1] = h10 & 0xff;
+    data[2] = (t10 >> 8) | (t < 0 ? 0x80 : 0);
+    data[3] = t10 & 0xff;
+  }
+  data[4] = data[0] + data[1] + data[2] + data[3];
+  // Response low after 20-40 us, 80 us low + 80 us high, then 40 bits of 50 us low + 26 or 70 us high
+  uint64_t at = clockMicros + 30 + dhtJitterMicros();
+  schedule(at, dhtEdge, nullptr);
+  at += 160 + dhtJitterMicros();
+  schedule(at, dhtEdge, nullptr);
+  for (uint8_t bit = 0; bit < 40; bit++) {
+    at += 50 + (data[bit / 8] & (0x80 >> bit % 8) ? 70 : 26) + dhtJitterMicros();
+    schedule(at, dhtEdge, nullptr);
+  }
+}
+}
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+FS LittleFS;
+
+size_t Print::printf(const char* format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (n < 0) return 0;
+  return write((const uint8_t*)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+// ***** File system
+static String hostPath(const char* path) {
+  return String(hal::fsRoot) + (path[0] == '/' ? "" : "/") + path;
+}
+
+bool FS::begin() {
+  ::mkdir(hal::fsRoot, 0755);
+  struct stat st;
+  return stat(hal::fsRoot, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool FS::format() {
+  DIR* dir = opendir(hal::fsRoot);
+  if (!dir) return begin();
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr)
+    if (entry->d_name[0] != '.') ::unlink(hostPath(entry->d_name).c_str());
+  closedir(dir);
+  return true;
+}
+
+bool FS::info(FSInfo& info) {
+  info.totalBytes = 1024 * 1024;
+  info.usedBytes = 0;
+  info.blockSize = 4096;
+  info.pageSize = 256;
+  info.maxOpenFiles = 5;
+  info.maxPathLength = 32;
+  DIR* dir = opendir(hal::fsRoot);
+  if (!dir) return false;
+  struct dirent* entry;
+  struct stat st;
+  while ((entry = readdir(dir)) != nullptr)
+    if (entry->d_name[0] != '.' && stat(hostPath(entry->d_name).c_str(), &st) == 0)
+      info.usedBytes += (st.st_size + info.blockSize - 1) / info.blockSize * info.blockSize;
+  closedir(dir);
+  return true;
+}
+
+File FS::open(const char* path, const char* mode) {
+  // Arduino "r+" never truncates, "a" appends, "w" truncates
+  const char* hostMode = strcmp(mode, "r") == 0 ? "rb" : strcmp(mode, "w") == 0 ? "wb" :
+                         strcmp(mode, "a") == 0 ? "ab" : strcmp(mode, "r+") == 0 ? "r+b" :
+                         strcmp(mode, "w+") == 0 ? "w+b" : "a+b";
+  return File(fopen(hostPath(path).c_str(), hostMode), path);
+}
+
+bool FS::exists(const char* path) {
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) { return ::unlink(hostPath(path).c_str()) == 0; }
+bool FS::rename(const char* from, const char* to) { return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0; }
+bool FS::mkdir(const char* path) { return ::mkdir(hostPath(path).c_str(), 0755) == 0; }
+
+bool File::truncate(uint32_t size) { return _f && fflush(_f) == 0 && ftruncate(fileno(_f), size) == 0; }
+
+bool Dir::next() {
+  DIR* dir = opendir(hostPath(_path.c_str()).c_str());
+  if (!dir) return false;
+  size_t i = 0;
+  struct dirent* entry;
+  bool found = false;
+  while ((entry = readdir(dir)) != nullptr) {
+    if (entry->d_name[0] == '.') continue;
+    if (i++ == _index) { _current = String(entry->d_name); found = true; break; }
+  }
+  closedir(dir);
+  if (found) _index++;
+  return found;
+}
+
+size_t Dir::fileSize() const {
+  struct stat st;
+  String path = _path + "/" + _current;
+  return stat(hostPath(path.c_str()).c_str(), &st) == 0 ? (size_t)st.st_size : 0;
+}
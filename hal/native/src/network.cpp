@@ -0,0 +1,443 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - network
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * WiFiClient talks either to a simulated InfluxDB server in virtual time or,
+ * when hal::influxServer is set, over a real socket to that server (e.g. the
+ * local stand-in tools/influxdb_standin.py). Host name and port requested by
+ * the firmware are replaced by the server address then, host time spent in
+ * the socket calls is added to the virtual clock.
+ *
+ * WiFiUDP delivers NTP requests to a simulated server in virtual time, line
+ * protocol datagrams take modeled radio time and are either dropped (lines
+ * counted) or sent on to a real listener at hal::udpSink.
+ *****************************************************************************/
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <string>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace hal {
+int influxStatus = 204;
+uint32_t influxLatencyMicros = 150000;
+uint32_t influxRetryAfter = 5;
+uint32_t serverIdleMicros = 60000000;
+uint32_t tcpConnectMicros = 60000;
+uint32_t tlsHandshakeMicros = 1500000;
+uint32_t tlsResumeMicros = 250000;
+const char* influxServer = nullptr;
+uint32_t influxRequests = 0;
+uint32_t influxLines = 0;
+uint32_t tcpConnects = 0;
+uint32_t tlsHandshakes = 0;
+uint32_t tlsResumed = 0;
+uint64_t epochMillis = 1650000000000ULL;
+int32_t clockDriftPpm = 0;
+uint32_t ntpLatencyMicros = 20000;
+bool ntpUp = true;
+uint32_t ntpRequests = 0;
+uint32_t udpSendMicros = 1500;
+const char* udpSink = nullptr;
+uint32_t udpDatagrams = 0;
+
+uint64_t trueMillis(uint64_t clockMicros) {
+  int64_t drift = (int64_t)clockMicros * clockDriftPpm / 1000000;
+  return epochMillis + (clockMicros - drift) / 1000;
+}
+
+struct Connection {
+  int fd = -1;                              // Real socket, -1 = simulated server
+  bool open = false;
+  std::string received;                     // Received and not read yet
+  std::string request;                      // Simulated server: request not processed yet
+  uint64_t lastActive = 0;                  // Simulated server: last request time
+};
+
+static uint64_t hostMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// ***** Simulated InfluxDB server
+static void respond(Connection& c, int status, const char* reason, const std::string& body) {
+  std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+  if (status == 429 || status == 503)
+    response += "Retry-After: " + std::to_string(influxRetryAfter) + "\r\n";
+  if (!body.empty())
+    response += "Content-Type: application/json; charset=utf-8\r\n";
+  response += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+  c.received += response;
+}
+
+// Decompresses gzip body, false when it is not valid
+static bool gunzip(const std::string& body, std::string& out) {
+  z_stream z = {};
+  if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK)
+    return false;
+  z.next_in = (Bytef*)body.data();
+  z.avail_in = body.size();
+  char buffer[1024];
+  int result;
+  do {
+    z.next_out = (Bytef*)buffer;
+    z.avail_out = sizeof(buffer);
+    result = inflate(&z, Z_NO_FLUSH);
+    out.append(buffer, sizeof(buffer) - z.avail_out);
+  } while (result == Z_OK);
+  inflateEnd(&z);
+  return result == Z_STREAM_END;
+}
+
+// Decodes chunked body starting at start, false until the last chunk was received.
+// Length is set to the encoded body length.
+static bool unchunk(const std::string& request, size_t start, std::string& body, size_t& length) {
+  size_t position = start;
+  for (;;) {
+    size_t eol = request.find("\r\n", position);
+    if (eol == std::string::npos)
+      return false;
+    size_t size = strtoul(request.c_str() + position, nullptr, 16);
+    if (size == 0) {
+      // No trailer fields, last chunk is followed by an empty line
+      if (request.size() < eol + 4)
+        return false;
+      length = eol + 4 - start;
+      return true;
+    }
+    if (request.size() < eol + 2 + size + 2)
+      return false;
+    body.append(request, eol + 2, size);
+    position = eol + 2 + size + 2;
+  }
+}
+
+// Answers all complete requests from the buffer
+static void serve(Connection& c) {
+  for (;;) {
+    size_t end = c.request.find("\r\n\r\n");
+    if (end == std::string::npos)
+      return;
+    std::string head = c.request.substr(0, end);
+    std::string body;
+    size_t length = 0;
+    if (head.find("\r\nTransfer-Encoding: chunked") != std::string::npos) {
+      if (!unchunk(c.request, end + 4, body, length))
+        return;
+    }
+    else {
+      size_t header = head.find("\r\nContent-Length:");
+      if (header != std::string::npos)
+        length = strtoul(head.c_str() + header + 17, nullptr, 10);
+      if (c.request.size() < end + 4 + length)
+        return;
+      body = c.request.substr(end + 4, length);
+    }
+    c.request.erase(0, end + 4 + length);
+
+    advance(influxLatencyMicros);
+    c.lastActive = clockMicros;
+    if (head.compare(0, 19, "POST /api/v2/write?") == 0) {
+      influxRequests++;
+      if (head.find("\r\nContent-Encoding: gzip") != std::string::npos) {
+        std::string decoded;
+        if (!gunzip(body, decoded)) {
+          respond(c, 400, "Bad Request", "{\"code\":\"invalid\",\"message\":\"invalid gzip body\"}");
+          continue;
+        }
+        body = decoded;
+      }
+      for (size_t i = 0; i < body.size(); i++)
+        if (body[i] == '\n' || i + 1 == body.size()) influxLines++;
+      if (influxStatus >= 200 && influxStatus < 300)
+        respond(c, influxStatus, "No Content", "");
+      else
+        respond(c, influxStatus, "Error", "{\"code\":\"error\",\"message\":\"simulated failure\"}");
+    }
+    else if (head.compare(0, 11, "GET /health") == 0) {
+      respond(c, 200, "OK", "{\"name\":\"influxdb\",\"status\":\"pass\"}");
+    }
+    else {
+      respond(c, 404, "Not Found", "{\"code\":\"not found\",\"message\":\"path not found\"}");
+    }
+    if (head.find("\r\nConnection: close") != std::string::npos)
+      c.open = false;
+  }
+}
+
+// ***** Real server
+static int connectTo(const char* url) {
+  // http://host[:port][/...]
+  if (strncmp(url, "http://", 7) != 0)
+    return -1;
+  std::string authority(url + 7);
+  authority = authority.substr(0, authority.find('/'));
+  size_t colon = authority.rfind(':');
+  std::string host = authority.substr(0, colon);
+  std::string port = colon == std::string::npos ? "80" : authority.substr(colon + 1);
+
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* list;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &list) != 0)
+    return -1;
+  int fd = -1;
+  for (struct addrinfo* a = list; a; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd < 0)
+      continue;
+    if (connect(fd, a->ai_addr, a->ai_addrlen) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(list);
+  if (fd < 0)
+    return -1;
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+// Reads what is available, waits up to timeout (ms) when wait is set
+static void receive(Connection& c, bool wait, unsigned long timeout) {
+  if (c.fd < 0 || !c.open)
+    return;
+  struct timeval tv = { (time_t)(timeout / 1000), (suseconds_t)(timeout % 1000 * 1000) };
+  setsockopt(c.fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  char buffer[2048];
+  uint64_t start = hostMicros();
+  ssize_t n = recv(c.fd, buffer, sizeof(buffer), wait ? 0 : MSG_DONTWAIT);
+  if (wait)
+    advance(hostMicros() - start);
+  if (n > 0)
+    c.received.append(buffer, n);
+  else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+    c.open = false;                         // Closed or reset by server
+}
+}
+
+using hal::Connection;
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  stop();
+  if (WiFi.status() != WL_CONNECTED)
+    return 0;
+  Connection* c = new Connection();
+  if (hal::influxServer) {
+    uint64_t start = hal::hostMicros();
+    c->fd = hal::connectTo(hal::influxServer);
+    hal::advance(hal::hostMicros() - start);
+    if (c->fd < 0) {
+      delete c;
+      return 0;
+    }
+  }
+  else {
+    hal::advance(hal::tcpConnectMicros);
+  }
+  c->open = true;
+  c->lastActive = hal::clockMicros;
+  _connection = c;
+  hal::tcpConnects++;
+  return 1;
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+  if (!connected())
+    return 0;
+  Connection& c = *_connection;
+  if (c.fd >= 0) {
+    // Lines are counted by the server (GET /stats of the stand-in)
+    if (size > 19 && memcmp(buffer, "POST /api/v2/write?", 19) == 0)
+      hal::influxRequests++;
+    size_t sent = 0;
+    while (sent < size) {
+      ssize_t n = send(c.fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        c.open = false;
+        break;
+      }
+      sent += n;
+    }
+    return sent;
+  }
+  c.request.append((const char*)buffer, size);
+  hal::serve(c);
+  return size;
+}
+
+int WiFiClient::available() {
+  if (!_connection)
+    return 0;
+  hal::receive(*_connection, false, 0);
+  return (int)_connection->received.size();
+}
+
+int WiFiClient::read() {
+  char c;
+  return readBytes(&c, 1) == 1 ? (uint8_t)c : -1;
+}
+
+int WiFiClient::peek() {
+  if (!_connection)
+    return -1;
+  if (_connection->received.empty())
+    hal::receive(*_connection, true, _timeout);
+  return _connection->received.empty() ? -1 : (uint8_t)_connection->received[0];
+}
+
+size_t WiFiClient::readBytes(char* buffer, size_t length) {
+  if (!_connection)
+    return 0;
+  Connection& c = *_connection;
+  size_t n = 0;
+  while (n < length) {
+    if (c.received.empty()) {
+      hal::receive(c, true, _timeout);
+      if (c.received.empty())
+        break;
+    }
+    size_t chunk = std::min(length - n, c.received.size());
+    memcpy(buffer + n, c.received.data(), chunk);
+    c.received.erase(0, chunk);
+    n += chunk;
+  }
+  return n;
+}
+
+uint8_t WiFiClient::connected() {
+  if (!_connection)
+    return 0;
+  Connection& c = *_connection;
+  if (WiFi.status() != WL_CONNECTED)
+    c.open = false;
+  if (c.fd >= 0)
+    hal::receive(c, false, 0);
+  else if (hal::clockMicros - c.lastActive >= hal::serverIdleMicros)
+    c.open = false;                         // Idle connection closed by server
+  return c.open || !c.received.empty();
+}
+
+void WiFiClient::stop() {
+  if (!_connection)
+    return;
+  if (_connection->fd >= 0)
+    close(_connection->fd);
+  delete _connection;
+  _connection = nullptr;
+}
+
+// ***** Line protocol datagrams
+namespace hal {
+static int sinkFd = -1;
+static struct sockaddr_storage sinkAddress;
+static socklen_t sinkLength = 0;
+
+// Sends datagram to the real listener, the socket is opened by the first one
+static bool sendToSink(const std::string& packet) {
+  if (sinkFd < 0) {
+    std::string sink = udpSink;
+    size_t colon = sink.rfind(':');
+    if (colon == std::string::npos)
+      return false;
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* list;
+    if (getaddrinfo(sink.substr(0, colon).c_str(), sink.substr(colon + 1).c_str(), &hints, &list) != 0)
+      return false;
+    sinkFd = socket(list->ai_family, list->ai_socktype, list->ai_protocol);
+    memcpy(&sinkAddress, list->ai_addr, list->ai_addrlen);
+    sinkLength = list->ai_addrlen;
+    freeaddrinfo(list);
+    if (sinkFd < 0)
+      return false;
+  }
+  return sendto(sinkFd, packet.data(), packet.size(), 0, (struct sockaddr*)&sinkAddress, sinkLength) == (ssize_t)packet.size();
+}
+
+static bool sendDatagram(const std::string& packet) {
+  advance(udpSendMicros);
+  udpDatagrams++;
+  for (size_t i = 0; i < packet.size(); i++)
+    if (packet[i] == '\n' || i + 1 == packet.size()) influxLines++;
+  return !udpSink || sendToSink(packet);
+}
+}
+
+// ***** Simulated NTP server
+int WiFiUDP::beginPacket(const char* host, uint16_t port) {
+  if (WiFi.status() != WL_CONNECTED)
+    return 0;
+  _output.clear();
+  _remotePort = port;
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size) {
+  _output.append((const char*)buffer, size);
+  return size;
+}
+
+int WiFiUDP::endPacket() {
+  if (_remotePort == 0)
+    return 0;
+  // NTP client mode request on any port (the firmware may use a test server port), line protocol otherwise
+  if (_output.size() != 48 || (_output[0] & 0x07) != 3) {
+    bool sent = _output.empty() || hal::sendDatagram(_output);
+    _output.clear();
+    return sent;
+  }
+  hal::ntpRequests++;
+  if (hal::ntpUp) {
+    // Server time in the middle of round trip, NTP timestamps are seconds since 1900 and 2^-32 fraction
+    uint64_t serverMillis = hal::trueMillis(hal::clockMicros + hal::ntpLatencyMicros / 2);
+    uint32_t seconds = (uint32_t)(serverMillis / 1000 + 2208988800ULL);
+    uint32_t fraction = (uint32_t)(((serverMillis % 1000) << 32) / 1000);
+    uint8_t packet[48] = {};
+    packet[0] = 0x24;                       // No leap warning, version 4, server mode
+    packet[1] = 2;                          // Stratum
+    memcpy(packet + 24, _output.data() + 40, 8); // Originate = request transmit timestamp
+    for (int t = 32; t <= 40; t += 8) {     // Receive and transmit timestamps
+      for (int i = 0; i < 4; i++) {
+        packet[t + i] = (uint8_t)(seconds >> (24 - i * 8));
+        packet[t + 4 + i] = (uint8_t)(fraction >> (24 - i * 8));
+      }
+    }
+    _response.assign((const char*)packet, sizeof(packet));
+    _responseAt = hal::clockMicros + hal::ntpLatencyMicros;
+  }
+  _output.clear();
+  return 1;
+}
+
+int WiFiUDP::parsePacket() {
+  _input.clear();
+  if (_response.empty() || hal::clockMicros < _responseAt)
+    return 0;
+  _input.swap(_response);
+  return (int)_input.size();
+}
+
+int WiFiUDP::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t length) {
+  size_t n = std::min(length, _input.size());
+  memcpy(buffer, _input.data(), n);
+  _input.erase(0, n);
+  return (int)n;
+}
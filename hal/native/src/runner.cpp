@@ -0,0 +1,121 @@
+/*****************************************************************************
+ * Native (Linux) hardware abstraction - firmware runner
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Runs setup() and loop() against the mock hardware. Every restart or deep
+ * sleep boots the firmware again in a fresh process (clean RAM) while the
+ * virtual clock and RTC user memory survive in shared memory.
+ *
+ *   program [-l loops] [-b boots] [-f fsdir] [-s status] [-t latency_ms]
+ *           [-u url] [-p udp_host:port] [-d drift_ppm] [-w] [-m] [-n] [-e]
+ *
+ *   -l  loop() calls per boot (default 10)
+ *   -b  number of boots (default 1)
+ *   -f  host directory used as flash (default ./littlefs)
+ *   -s  HTTP status returned by the InfluxDB write API (default 204)
+ *   -t  simulated InfluxDB request round trip in ms (default 150)
+ *   -u  send writes over HTTP to this server instead of the simulation,
+ *       e.g. http://127.0.0.1:8086 (tools/influxdb_standin.py)
+ *   -d  device clock runs faster than the simulated NTP server (ppm)
+ *   -w  WiFi access point unreachable
+ *   -m  access point moved, cached channel and BSSID do not connect
+ *   -n  NTP server unreachable
+ *   -e  sensor read failures
+ *****************************************************************************/
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <LittleFS.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void setup();
+void loop();
+
+// Unit tests have own main(), firmware is linked without being run
+#ifndef PIO_UNIT_TESTING
+
+// State shared between boots
+struct Shared {
+  uint64_t clockMicros;
+  uint32_t rtcMemory[128];
+  uint32_t influxRequests;
+  uint32_t influxLines;
+  uint32_t tcpConnects;
+  uint32_t tlsHandshakes;
+  uint32_t tlsResumed;
+  uint32_t ntpRequests;
+  uint32_t udpDatagrams;
+  uint32_t wifiConnects;
+  uint32_t wifiDirectConnects;
+};
+
+int main(int argc, char** argv) {
+  long loops = 10;
+  long boots = 1;
+  int option;
+  while ((option = getopt(argc, argv, "l:b:f:s:t:u:p:d:wmne")) != -1) {
+    switch (option) {
+    case 'l': loops = atol(optarg); break;
+    case 'b': boots = atol(optarg); break;
+    case 'f': hal::fsRoot = optarg; break;
+    case 's': hal::influxStatus = atoi(optarg); break;
+    case 't': hal::influxLatencyMicros = (uint32_t)atol(optarg) * 1000; break;
+    case 'u': hal::influxServer = optarg; break;
+    case 'p': hal::udpSink = optarg; break;
+    case 'd': hal::clockDriftPpm = atoi(optarg); break;
+    case 'w': hal::wifiUp = false; break;
+    case 'm': hal::wifiApMoved = true; break;
+    case 'n': hal::ntpUp = false; break;
+    case 'e': hal::sensorFail = true; break;
+    default:
+      fprintf(stderr, "usage: %s [-l loops] [-b boots] [-f fsdir] [-s status] [-t latency_ms] [-u url] [-d drift_ppm] [-w] [-m] [-n] [-e]\n", argv[0]);
+      return 2;
+    }
+  }
+  Shared* shared = (Shared*)mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) return 1;
+  memset(shared, 0, sizeof(Shared));
+  for (long boot = 0; boot < boots; boot++) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      hal::clockMicros = hal::bootMicros = shared->clockMicros;
+      memcpy(hal::rtcMemory, shared->rtcMemory, sizeof(hal::rtcMemory));
+      uint64_t sleepUs = 0;
+      try {
+        setup();
+        for (long i = 0; i < loops; i++) loop();
+      } catch (hal::Restart& restart) {
+        sleepUs = restart.sleepUs;
+      }
+      shared->clockMicros = hal::clockMicros + sleepUs;
+      memcpy(shared->rtcMemory, hal::rtcMemory, sizeof(hal::rtcMemory));
+      shared->influxRequests += hal::influxRequests;
+      shared->influxLines += hal::influxLines;
+      shared->tcpConnects += hal::tcpConnects;
+      shared->tlsHandshakes += hal::tlsHandshakes;
+      shared->tlsResumed += hal::tlsResumed;
+      shared->ntpRequests += hal::ntpRequests;
+      shared->udpDatagrams += hal::udpDatagrams;
+      shared->wifiConnects += hal::wifiConnects;
+      shared->wifiDirectConnects += hal::wifiDirectConnects;
+      fflush(stdout);
+      _exit(0);
+    }
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) return 1;
+  }
+  fprintf(stderr, "virtual time %.1f s, %u write requests, %u lines, %u connections, %u TLS handshakes (%u resumed), %u NTP requests, "
+          "%u UDP datagrams, %u WiFi connects (%u direct)\n",
+          shared->clockMicros / 1e6, shared->influxRequests, shared->influxLines,
+          shared->tcpConnects, shared->tlsHandshakes, shared->tlsResumed, shared->ntpRequests,
+          shared->udpDatagrams,
+          shared->wifiConnects + shared->wifiDirectConnects, shared->wifiDirectConnects);
+  return 0;
+}
+#endif
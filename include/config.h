@@ -8,12 +8,62 @@
 #define USE_DHT_SENSOR                      // Use DHT sensor for temperature/humidity measurement
 #define USE_BMP280_SENSOR                   // Use BMP280 sensor for temperature/presure measurement
 #define USE_DS18B20_SENSOR                  // Use DS18B20 sensor for temperature measurement
+//#define USE_BME280_SENSOR                   // Use BME280 sensor for temperature/humidity/pressure measurement
+//#define USE_DEEP_SLEEP                      // Deep sleep between measures, D0 must be connected to RST
+//#define USE_AGGREGATION                     // Read sensors more often, write window statistics (not with USE_DEEP_SLEEP)
+//#define USE_SAMPLE_LOG                      // Keep samples on LittleFS when RAM buffer is full during long outages (not with USE_DEEP_SLEEP)
+//#define USE_TELEMETRY                       // Write firmware self-measurement (stage times, heap, errors), not in deep sleep mode
+#define USE_FAST_CONNECT                    // Connect to the last access point without channel scan, WiFiManager when it fails
 // ***** End of compilation time feature selection
 
 // Set defines for detailed configuration (or nothing and use defaults)
 
 // ***** Global configuration
 //#define LOOP_INTERVAL 5*10*1000             // Loop delay interval
+//#define SAMPLE_BUFFER_SIZE 48               // Samples kept in RAM until written to InfluxDB
+//#define FLUSH_INTERVAL 1000                 // Batch write check interval (ms)
+//#define CONNECT_TIMEOUT 30000               // Reconnect WiFi after being disconnected for this time (ms)
+
+// ***** Connectivity section, write retries after failure
+//#define LINK_BACKOFF_BASE 2000              // Backoff after the first failure, before jitter (ms)
+//#define LINK_BACKOFF_MAX 5*60*1000UL        // Backoff limit, before jitter (ms)
+//#define LINK_FAILURES 5                     // Consecutive failures opening the circuit
+//#define LINK_OPEN_TIME 10*60*1000UL         // Open circuit blocks writes for (ms)
+
+// ***** Fast connect section (USE_FAST_CONNECT)
+//#define FAST_CONNECT_TIMEOUT 3000           // Directed connect wait before WiFiManager connect (ms)
+//#define FAST_CONNECT_STATIC_IP              // Reuse the last DHCP lease as static IP (no DHCP), only with a reserved address
+
+// ***** Aggregation section (USE_AGGREGATION), every statistic adds 4 bytes per field to buffered samples
+//#define AGGREGATE_INTERVAL 10*1000          // Sensor reading interval (ms)
+//#define AGGREGATE_WINDOW LOOP_INTERVAL      // One sample with window statistics is written per window (ms)
+#define AGGREGATE_MIN                       // Send window minimum as <field>_min
+#define AGGREGATE_MAX                       // Send window maximum as <field>_max
+#define AGGREGATE_STDDEV                    // Send window standard deviation as <field>_sd
+#define AGGREGATE_COUNT                     // Send readings in window as <field>_n
+
+// ***** Sample log section (USE_SAMPLE_LOG), segments of 4 kB (SAMPLE_LOG_SEGMENT_PAGES x SAMPLE_LOG_PAGE_SIZE)
+//#define SAMPLE_LOG_SEGMENTS 8               // Segments on flash, the oldest one is dropped when all are full
+//#define SAMPLE_LOG_REPLAY_RATE 10           // Logged samples written per second after recovery
+
+// ***** Telemetry section (USE_TELEMETRY)
+//#define TELEMETRY_INTERVAL 15*60*1000       // Telemetry write interval (ms)
+//#define TELEMETRY_MEASUREMENT "telemetry"   // Telemetry measurement name
+
+// ***** Time synchronization
+//#define TIME_SYNC_INTERVAL 60*60*1000UL     // Time synchronization interval (ms)
+
+// ***** Time synchronization defaults (overridden by run-time settings)
+//#define NTP_SERVER_1 "pool.ntp.org"         // Time server for sample timestamps
+//#define NTP_SERVER_2 "time.nist.gov"        // Secondary time server
+//#define TIME_PRECISION "s"                  // Timestamp precision "s" or "ms"
+
+// ***** Batch write defaults (overridden by run-time settings)
+//#define BATCH_SIZE 6                        // Samples sent in one write request (1 = no batching)
+//#define BATCH_MAX_AGE 15*60                 // Age of the oldest sample forcing write (seconds)
+
+// ***** Report on change defaults (overridden by run-time settings)
+//#define HEARTBEAT_INTERVAL 60*60            // All fields are sent at least this often (seconds), 0 = every sample
 
 // ***** LED section
 #define LED_PIN LED_BUILTIN                 // Pin where LED is connected
@@ -26,25 +76,58 @@
 #define DHT_TYPE DHT11                      // DHT 11 | DHT 22 (AM2302) | DHT 21 (AM2301)
 //#define DHT_NO_HEATINDEX                    // Suppress sending heat index
 //#define DHT_NO_DEWPOINT                     // Suppress sending dew point
+//#define DHT_NO_ABSHUMIDITY                  // Suppress sending absolute humidity
 
 // ***** DHT sensor defaults (overridden by run-time settings)
 #define DHT_FIELD_TEMPERATURE "temperature" // DHT temperature field value
 #define DHT_FIELD_HUMIDITY "humidity"       // DHT humidity field value
 #define DHT_FIELD_HEATINDEX "heatIndex"     // DHT heat index field value
 #define DHT_FIELD_DEWPOINT "dewPoint"       // DHT dew point field value
+#define DHT_FIELD_ABSHUMIDITY "absHumidity" // DHT absolute humidity field value (g/m3)
+//#define DHT_DEADBAND_TEMPERATURE 0.2        // Temperature change reported (Celsius, also heat index and dew point), 0 = every value
+//#define DHT_DEADBAND_HUMIDITY 1             // Humidity change reported (%, also absolute humidity), 0 = every value
 
 // ***** DS18B20 sensor section
 #define DS18B20_PIN D5                      // Digital pin connected to the DS18B20 sensor
+//#define DS18B20_MAX_DEVICES 4               // Maximum DS18B20 devices on the bus
+//#define DS18B20_RESOLUTION 12               // Conversion resolution 9-12 bit, conversion 94/188/375/750 ms
 // ***** DS18b20 sensor defaults (overridden by run-time settings)
 #define DS18B20_FIELD_TEMPERATURE "temperature" // DS18B20 temperature field value
+//#define DS18B20_DEADBAND_TEMPERATURE 0.1    // Temperature change reported (Celsius, every device), 0 = every value
 
 // ***** BMP280 sensor section
 #define BMP280_I2C_ADDRESS BMP280_ADDRESS_ALT   // BMP280 I2C ADDRESS
+//#define BMP280_SAMPLING_PRESSURE Adafruit_BMP280::SAMPLING_X4  // BMP280 pressure oversampling
+//#define BMP280_CONVERSION_TIME 14           // BMP280 forced conversion time for selected oversampling (ms)
 //#define BMP280_NO_TEMPERATURE               // Suppress sending temperature
+//#define BMP280_ALTITUDE 250                 // Station altitude (m), send sea level pressure
+//#define BMP280_SEALEVEL_PRESSURE 101325     // Sea level pressure (Pa), send altitude
 
 // ***** BMP280 sensor defaults (overridden by run-time settings)
 #define BMP280_FIELD_TEMPERATURE "temperature"  // BMP280 temperature field value
 #define BMP280_FIELD_PRESSURE "pressure"        // BMP280 pressure field value
+//#define BMP280_DEADBAND_TEMPERATURE 0.1     // Temperature change reported (Celsius), 0 = every value
+//#define BMP280_DEADBAND_PRESSURE 10         // Pressure change reported (Pa), 0 = every value
+
+// ***** BME280 sensor section
+//#define BME280_I2C_ADDRESS BME280_ADDRESS_ALTERNATE // BME280 I2C ADDRESS
+//#define BME280_SAMPLING_HUMIDITY Adafruit_BME280::SAMPLING_X1  // BME280 humidity oversampling
+//#define BME280_CONVERSION_TIME 17           // BME280 forced conversion time for selected oversampling (ms)
+
+// ***** BME280 sensor defaults (overridden by run-time settings)
+//#define BME280_FIELD_TEMPERATURE "temperature"  // BME280 temperature field value
+//#define BME280_FIELD_HUMIDITY "humidity"        // BME280 humidity field value
+//#define BME280_FIELD_PRESSURE "pressure"        // BME280 pressure field value
+//#define BME280_DEADBAND_TEMPERATURE 0.1     // Temperature change reported (Celsius), 0 = every value
+//#define BME280_DEADBAND_HUMIDITY 1          // Humidity change reported (%), 0 = every value
+//#define BME280_DEADBAND_PRESSURE 10         // Pressure change reported (Pa), 0 = every value
+
+// ***** InfluxDB section
+//#define FIELD_DECIMALS 2                    // Decimal places of sensor values
+//#define INFLUXDB_NO_REUSE                   // Close server connection after every write (no keep-alive)
+//#define INFLUXDB_TIMEOUT 5000               // Server connect and response timeout (ms)
+//#define INFLUXDB_GZIP                       // Send write bodies gzip compressed (2.7 kB RAM)
+//#define INFLUXDB_GZIP_THRESHOLD 512         // Smaller write bodies are sent uncompressed (bytes)
 
 // ***** InfluxDB defaults (overridden by run-time settings)
 #define INFLUXDB_MEASUREMENT "temperature"
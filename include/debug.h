@@ -23,22 +23,23 @@
 
 #ifdef DEBUG
 #define SERIALBEGIN(...)   Serial.begin(__VA_ARGS__)
-#define DPRINT(...)        Serial.print(__VA_ARGS__)
-#define DPRINTLN(...)      Serial.println(__VA_ARGS__)
-#define DPRINTF(...)       Serial.printf(__VA_ARGS__)
-#define DPRINTFLN(...)     Serial.printf(__VA_ARGS__); Serial.println()
-#define DPRINT_F(...)      Serial.print(F(__VA_ARGS__))
-#define DPRINTLN_F(...)    Serial.println(F(__VA_ARGS__)) //printing text using the F macro
+// Every macro is one statement (do-while), safe as the body of if/else without braces
+#define DPRINT(...)        do { Serial.print(__VA_ARGS__); } while (0)
+#define DPRINTLN(...)      do { Serial.println(__VA_ARGS__); } while (0)
+#define DPRINTF(...)       do { Serial.printf(__VA_ARGS__); } while (0)
+#define DPRINTFLN(...)     do { Serial.printf(__VA_ARGS__); Serial.println(); } while (0)
+#define DPRINT_F(...)      do { Serial.print(F(__VA_ARGS__)); } while (0)
+#define DPRINTLN_F(...)    do { Serial.println(F(__VA_ARGS__)); } while (0) //printing text using the F macro
 
 //***************************************************************
 #else
 #define SERIALBEGIN(...)  
-#define DPRINT(...)       
-#define DPRINTLN(...)     
-#define DPRINTF(...)
-#define DPRINTFLN(...)
-#define DPRINT_F(...)
-#define DPRINTLN_F(...)
+#define DPRINT(...)        do { } while (0)
+#define DPRINTLN(...)      do { } while (0)
+#define DPRINTF(...)       do { } while (0)
+#define DPRINTFLN(...)     do { } while (0)
+#define DPRINT_F(...)      do { } while (0)
+#define DPRINTLN_F(...)    do { } while (0)
 
 #endif
 //***************************************************************
@@ -19,28 +19,32 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 // InfluxDB
-#include <InfluxDbClient.h>
+#include <InfluxWriter.h>
 //#include <TZ.h> // Time zone constants https://github.com/esp8266/Arduino/blob/master/cores/esp8266/TZ.h
-// Adafruit DHT sensor library
-#ifdef USE_DHT_SENSOR
-#include <Adafruit_Sensor.h>
-#include <DHT.h>
-#include <DHT_U.h>
-#endif
-#ifdef USE_BMP280_SENSOR
-#include <Adafruit_Sensor.h>
-#include <Adafruit_BMP280.h>
-#endif
-#ifdef USE_DS18B20_SENSOR
-#include <OneWire.h>
-#include <DallasTemperature.h>
-#endif
+// Sensor drivers and compile time sensor list
+#include "sensors.h"
 
 #ifdef USE_SECRETS
 #include "secrets.h"
 #endif
 
 #include "debug.h"
+#include <RingBuffer.h>
+#include <Crc32.h>
+#include <Scheduler.h>
+#include <LineProtocol.h>
+#include <TimeSync.h>
+#include <Link.h>
+#include <Derived.h>
+#ifdef INFLUXDB_GZIP
+#include <GzipStream.h>
+#endif
+#ifdef USE_AGGREGATION
+#include <Aggregate.h>
+#endif
+#ifdef USE_SAMPLE_LOG
+#include <RecordLog.h>
+#endif
 
 #ifndef LOOP_INTERVAL
 #define LOOP_INTERVAL 5*60*1000             // Loop delay interval (default value is 5 min)
@@ -55,8 +59,12 @@
 #define LED_INTERVAL 150                    // LED blink interval
 #define LED_ON LOW                          // Turns the LED *on*, D1 Mini: LOW, Arduino: HIGH
 #define LED_OFF HIGH                        // Turns the LED *off*, D1 Mini: HIGH, Arduino: LOW
-// LED blink
+#define LED_PAUSE 3                         // LED intervals between blink groups
+RingBuffer<uint8_t, 8> blinkQueue;          // Blink groups waiting for LED task
+// LED blink (non-blocking, blinks are shown by LED task)
 void blink(int count);                      
+// LED blink (blocking)
+void blinkWait(int count);
 #define BLINK(int) blink(int)               // LED blink
 #else
 #define BLINK(int)                          // DO NOTHING - LED blink
@@ -78,66 +86,218 @@ void blink(int count);
 void IRAM_ATTR interruptRestart();
 #endif
 
-// ***** DHT sensor section
-#ifdef USE_DHT_SENSOR
-#ifndef DHT_PIN
-#define DHT_PIN D6                          // Digital pin connected to the DHT sensor
+// ***** Sample buffer section
+#ifndef SAMPLE_BUFFER_SIZE
+#define SAMPLE_BUFFER_SIZE 48               // Samples kept in RAM until written to InfluxDB
+#endif
+// Field slots of one sample
+enum SampleField : uint8_t {
+  FIELD_RSSI,                               // WiFi signal strength
+  #ifdef USE_DEEP_SLEEP
+  FIELD_AWAKE,                              // Time awake in previous wake
+  #endif
+  FIELD_SENSORS                             // First sensor field, sensors follow in list order
+};
+// Enabled sensors, list order is the field order of written lines (sensors with
+// conversion are started first regardless of order). Default field names repeat,
+// InfluxDB keeps the last field of a line, so DS18B20 temperature stays last.
+typedef SensorChain<0, FIELD_SENSORS, 0
+  #ifdef USE_DHT_SENSOR
+  , DhtSensor
+  #endif
+  #ifdef USE_BMP280_SENSOR
+  , Bmp280Sensor
+  #endif
+  #ifdef USE_BME280_SENSOR
+  , Bme280Sensor
+  #endif
+  #ifdef USE_DS18B20_SENSOR
+  , Ds18b20Sensor
+  #endif
+  > Sensors;
+Sensors sensors;                            // Sensor drivers
+SensorSetting sensorSettings[Sensors::CHANNELS > 0 ? Sensors::CHANNELS : 1]; // Field names and deadbands from configuration
+constexpr uint8_t FIELD_COUNT = FIELD_SENSORS + Sensors::FIELDS;
+// Call f(channel, setting) for every configured quantity of enabled sensors
+template <typename F> void eachChannel(F&& f) {
+  sensors.each([&](auto& sensor, const SensorSlot& slot) {
+    for (uint8_t i = 0; i < sensor.CHANNELS; i++)
+      f(sensor.channels[i], sensorSettings[slot.channel + i]);
+  });
+}
+static_assert(FIELD_COUNT <= 32, "Too many sample fields");
+#ifdef USE_DEEP_SLEEP
+#define DEVICE_FIELDS (1UL << FIELD_RSSI | 1UL << FIELD_AWAKE) // Fields not read from sensors
+#else
+#define DEVICE_FIELDS (1UL << FIELD_RSSI)   // Fields not read from sensors
+#endif
+// One measurement, values are converted to InfluxDB point when written
+struct Sample {
+  uint64_t timestamp;                       // Acquisition time (millis64)
+  uint32_t valid;                           // Bit mask of valid fields
+  float values[FIELD_COUNT];                // Field values (window mean when aggregated)
+  #ifdef USE_AGGREGATION
+  #ifdef AGGREGATE_MIN
+  float minimum[FIELD_COUNT];               // Window minimum
+  #endif
+  #ifdef AGGREGATE_MAX
+  float maximum[FIELD_COUNT];               // Window maximum
+  #endif
+  #ifdef AGGREGATE_STDDEV
+  float stddev[FIELD_COUNT];                // Window standard deviation
+  #endif
+  #ifdef AGGREGATE_COUNT
+  uint16_t count[FIELD_COUNT];              // Readings in window
+  #endif
+  #endif
+  void set(uint8_t field, float value) { values[field] = value; valid |= 1UL << field; }
+  bool has(uint8_t field) const { return valid & (1UL << field); }
+};
+RingBuffer<Sample, SAMPLE_BUFFER_SIZE> samples; // Samples waiting for write
+uint32_t samplesDropped = 0;                // Samples dropped before this boot (deep sleep)
+
+// ***** Aggregation section
+#ifdef USE_AGGREGATION
+#ifdef USE_DEEP_SLEEP
+#error "USE_AGGREGATION reads sensors too often for USE_DEEP_SLEEP, window state does not fit into RTC memory"
+#endif
+#ifndef AGGREGATE_INTERVAL
+#define AGGREGATE_INTERVAL 10*1000          // Sensor reading interval (ms)
+#endif
+#ifndef AGGREGATE_WINDOW
+#define AGGREGATE_WINDOW LOOP_INTERVAL      // One sample with window statistics is written per window (ms)
 #endif
-#ifndef DHT_TYPE
-#define DHT_TYPE DHT11                      // DHT 11 | DHT 22 (AM2302) | DHT 21 (AM2301)
+#define AGGREGATE_READINGS ((AGGREGATE_WINDOW) / (AGGREGATE_INTERVAL)) // Readings in one window
+static_assert(AGGREGATE_READINGS >= 1 && AGGREGATE_READINGS <= UINT16_MAX, "AGGREGATE_WINDOW must be 1 to 65535 times AGGREGATE_INTERVAL");
+Aggregate aggregates[FIELD_COUNT];          // Statistics of current window
+uint16_t windowReadings = 0;                // Readings in current window
+#define SAMPLE_INTERVAL AGGREGATE_INTERVAL
+#else
+#define SAMPLE_INTERVAL LOOP_INTERVAL
 #endif
-#ifndef DHT_FIELD_TEMPERATURE
-#define DHT_FIELD_TEMPERATURE "temperature" // DHT temperature field value
+
+// ***** Report on change section
+#ifndef HEARTBEAT_INTERVAL
+#define HEARTBEAT_INTERVAL 60*60            // All fields are sent at least this often (seconds), 0 = every sample
 #endif
-#ifndef DHT_FIELD_HUMIDITY
-#define DHT_FIELD_HUMIDITY "humidity"       // DHT humidity field value
+uint32_t heartbeatInterval = HEARTBEAT_INTERVAL; // All fields are sent at least this often (seconds)
+// Last reported values, fields changed less than deadband are not sent
+struct ReportState {
+  uint64_t heartbeat;                       // Last sample with all fields (millis64)
+  uint32_t valid;                           // Bit mask of fields with reported value
+  float values[Sensors::FIELDS > 0 ? Sensors::FIELDS : 1]; // Last reported sensor values (from FIELD_SENSORS)
+};
+ReportState report;                         // Kept over deep sleep
+float reportDeadband[FIELD_COUNT];          // Deadbands from configuration (reportBegin), 0 = every value
+// Report on change counters
+struct ReportStats {
+  uint32_t samplesSent;                     // Samples queued for write
+  uint32_t samplesSuppressed;               // Samples skipped, no field changed (kept over deep sleep)
+  uint32_t fieldsSent;                      // Sensor fields queued for write
+  uint32_t fieldsSuppressed;                // Sensor fields removed from queued samples
+};
+ReportStats reportStats;
+
+// ***** Batch write section
+#ifndef BATCH_SIZE
+#define BATCH_SIZE 1                        // Samples sent in one write request (1 = no batching)
 #endif
-#ifndef DHT_FIELD_HEATINDEX
-#define DHT_FIELD_HEATINDEX "heatIndex"     // DHT heat index field value
+#ifndef BATCH_MAX_AGE
+#define BATCH_MAX_AGE 15*60                 // Age of the oldest sample forcing write (seconds)
 #endif
-#ifndef DHT_FIELD_DEWPOINT
-#define DHT_FIELD_DEWPOINT "dewPoint"       // DHT dew point field value
+#ifndef BATCH_BODY_SIZE
+#define BATCH_BODY_SIZE 4096                // Write request body buffer (bytes)
 #endif
-DHT dht(DHT_PIN, DHT_TYPE);                 // Initialize DHT sensor
-char dhtFieldTemperature[15] = DHT_FIELD_TEMPERATURE;
-char dhtFieldHumidity[15] = DHT_FIELD_HUMIDITY;
-#define JSON_DHT_TEMPERATURE "dhtTemp"
-#define JSON_DHT_HUMIDITY "dhtHumi"
+static_assert(BATCH_SIZE >= 1 && BATCH_SIZE <= SAMPLE_BUFFER_SIZE, "BATCH_SIZE must fit into sample buffer");
+uint16_t batchSize = BATCH_SIZE;            // Samples sent in one write request
+uint32_t batchMaxAge = BATCH_MAX_AGE;       // Age of the oldest sample forcing write (seconds)
+#ifndef FIELD_DECIMALS
+#define FIELD_DECIMALS 2                    // Decimal places of sensor values
 #endif
+char batchBody[BATCH_BODY_SIZE];            // Line protocol of one write request
+LineProtocol encoder(batchBody, sizeof(batchBody)); // Line protocol encoder writing to batchBody
 
-// ***** BMP280 sensor section
-#ifdef USE_BMP280_SENSOR
-#ifndef BMP280_I2C_ADDRESS
-#define BMP280_I2C_ADDRESS BMP280_ADDRESS_ALT   // BMP280 I2C ADDRESS
+// ***** Sample log section
+// Samples which do not fit into RAM buffer (long outage) are moved to a log on LittleFS
+// and written again at limited rate when the server is reachable
+#ifdef USE_SAMPLE_LOG
+#ifdef USE_DEEP_SLEEP
+#error "USE_SAMPLE_LOG is not available with USE_DEEP_SLEEP, samples are kept in RTC memory"
 #endif
-#ifndef BMP280_FIELD_TEMPERATURE
-#define BMP280_FIELD_TEMPERATURE "temperature"  // BMP280 temperature field value
+#ifndef SAMPLE_LOG_DIR
+#define SAMPLE_LOG_DIR "/log"               // Log directory, one file per segment
 #endif
-#ifndef BMP280_FIELD_PRESSURE
-#define BMP280_FIELD_PRESSURE "pressure"        // BMP280 pressure field value
+#ifndef SAMPLE_LOG_PAGE_SIZE
+#define SAMPLE_LOG_PAGE_SIZE 256            // Flash write unit (bytes), LittleFS page
 #endif
-Adafruit_BMP280 bmp280;                     // I2C connection for sensor
-#ifndef BMP280_NO_TEMPERATURE
-char bmp280FieldTemperature[15] = BMP280_FIELD_TEMPERATURE;
-#define JSON_BMP280_TEMPERATURE "bmp280Temp"
+#ifndef SAMPLE_LOG_SEGMENT_PAGES
+#define SAMPLE_LOG_SEGMENT_PAGES 16         // Pages of one segment file (16 = 4 kB flash block)
 #endif
-char bmp280FieldPressure[15] = BMP280_FIELD_PRESSURE;
-#define JSON_BMP280_PRESSURE "bmp280Press"
+#ifndef SAMPLE_LOG_SEGMENTS
+#define SAMPLE_LOG_SEGMENTS 8               // Segment files, the oldest one is dropped when all are full
+#endif
+#ifndef SAMPLE_LOG_REPLAY_RATE
+#define SAMPLE_LOG_REPLAY_RATE 10           // Logged samples written per second at most
+#endif
+// Logged sample, acquisition time is kept as Unix time when the clock is synchronized
+struct LoggedSample {
+  uint64_t epochMillis;                     // Acquisition time (Unix ms), 0 = clock was not synchronized
+  uint32_t boot;                            // Boot of the sample, its monotonic timestamp is valid only in the same boot
+  Sample sample;
+};
+constexpr uint16_t SAMPLE_LOG_PAGE_RECORDS = SAMPLE_LOG_PAGE_SIZE / (sizeof(uint32_t) + sizeof(LoggedSample));
+static_assert(SAMPLE_LOG_PAGE_RECORDS > 0, "Logged sample does not fit into SAMPLE_LOG_PAGE_SIZE");
+static_assert(SAMPLE_LOG_SEGMENTS >= 2 && SAMPLE_LOG_SEGMENTS <= RECORD_LOG_MAX_SEGMENTS, "SAMPLE_LOG_SEGMENTS out of range");
+uint8_t sampleLogPage[SAMPLE_LOG_PAGE_SIZE]; // Page being written or read
+RecordLog sampleLog(SAMPLE_LOG_DIR, sizeof(LoggedSample), sampleLogPage, sizeof(sampleLogPage));
+uint32_t bootId = 0;                        // Random identifier of this boot
+uint32_t samplesUntimed = 0;                // Logged samples dropped, not synchronized time of previous boot
+// Move the oldest samples of full buffer to the log (one page)
+void sampleLogSpill();
+// Unix time of logged sample (ms), 0 when it cannot be placed in time
+uint64_t loggedTime(const LoggedSample& logged);
+// Age of the oldest logged sample (s), 0 when the log is empty
+uint32_t sampleLogLag();
+#define SAMPLE_LOG_PENDING() sampleLog.pending()
+#define SAMPLE_LOG_DROPPED() (sampleLog.stats().dropped + sampleLog.stats().corrupt + samplesUntimed)
+#else
+#define SAMPLE_LOG_PENDING() 0              // DO NOTHING - sample log
+#define SAMPLE_LOG_DROPPED() 0              // DO NOTHING - sample log
 #endif
 
-// ***** DS18B20 sensor section
-#ifdef USE_DS18B20_SENSOR
-#ifndef DS18B20_PIN
-#define DS18B20_PIN D5                      // Digital pin connected to the DS18B20 sensor
+// ***** Deep sleep section
+#ifdef USE_DEEP_SLEEP
+#ifndef RTC_OFFSET
+#define RTC_OFFSET 0                        // First used RTC user memory block (4 bytes)
 #endif
-#ifndef DS18B20_FIELD_TEMPERATURE
-#define DS18B20_FIELD_TEMPERATURE "temperature" // DS18B20 temperature field value
+#ifndef NTP_TIMEOUT
+#define NTP_TIMEOUT 3000                    // Time synchronization wait before write (ms)
 #endif
-char ds18b20FieldTemperature[15] = DS18B20_FIELD_TEMPERATURE;
-#define JSON_DS18B20_TEMPERATURE "dsTemp"
-int dsCount = 0;                            // Dallas devices found
-OneWire oneWire(DS18B20_PIN);               // Setup a oneWire instance to communicate with any OneWire devices
-DallasTemperature dallas(&oneWire);         // Pass our oneWire reference to Dallas Temperature.
+#define RTC_USER_MEMORY 512                 // RTC user memory size (bytes)
+#define RTC_MAGIC 0x464C5854                // RTC state signature
+// State kept in RTC user memory between wakes
+struct RtcHeader {
+  uint32_t crc;                             // CRC32 of the rest of state
+  uint32_t magic;                           // RTC_MAGIC
+  uint32_t wakes;                           // Wake counter
+  uint32_t awakeMillis;                     // Time awake in last wake (ms)
+  uint64_t clockMillis;                     // millis64() at wake up
+  uint16_t count;                           // Samples stored
+  uint16_t batchSize;                       // Batch size from configuration
+  uint32_t batchMaxAge;                     // Maximum batch age from configuration
+  uint32_t radio;                           // Radio is enabled in this wake
+  uint32_t dropped;                         // Samples dropped so far
+  uint32_t skipped;                         // Samples skipped by report on change so far
+  TimeSyncState time;                       // Time synchronization (clock mapping and drift)
+  ReportState report;                       // Last reported values, deadbands are loaded from configuration
+};
+constexpr size_t RTC_SAMPLES = (RTC_USER_MEMORY - RTC_OFFSET * 4 - sizeof(RtcHeader)) / sizeof(Sample);
+static_assert(RTC_SAMPLES > 0, "No space for samples in RTC memory");
+struct RtcState {
+  RtcHeader header;
+  Sample samples[RTC_SAMPLES];
+};
+RtcState rtcState;                          // Copy of RTC user memory
 #endif
 
 // ***** Configuration file section
@@ -149,10 +309,14 @@ DallasTemperature dallas(&oneWire);         // Pass our oneWire reference to Dal
 #define JSON_INFLUXDB_BUCKET "inflBuc"      // InfluxDB Bucket
 #define JSON_INFLUXDB_TOKEN "inflTok"       // InfluxDB Token
 #define JSON_INFLUXDB_MEAS "measName"       // InfluxDB Measurement name
-//#define JSON_NTP_SERVER_1 "ntp1"            // NTP Server 1
-//#define JSON_NTP_SERVER_2 "ntp2"            // NTP Server 2
+#define JSON_NTP_SERVER_1 "ntp1"            // NTP Server 1
+#define JSON_NTP_SERVER_2 "ntp2"            // NTP Server 2
 //#define JSON_NTP_TZ "ntpTz"                 // Timezone for NTP
+#define JSON_TIME_PRECISION "precision"     // Timestamp precision
 #define JSON_TAG_LOCATION "loc"             // Tag location
+#define JSON_BATCH_SIZE "batchSize"         // Samples in one write request
+#define JSON_BATCH_AGE "batchAge"           // Maximum batch age
+#define JSON_HEARTBEAT "heartbeat"          // Heartbeat interval of report on change
 
 #ifdef DEBUG
 #define WIFIMANAGER_DEBUG true              // Show WiFiManager debug messages
@@ -163,7 +327,16 @@ DallasTemperature dallas(&oneWire);         // Pass our oneWire reference to Dal
 
 // Define library static instances
 WiFiManager wm;
-InfluxDBClient client;
+InfluxWriter writer;
+#ifndef INFLUXDB_TIMEOUT
+#define INFLUXDB_TIMEOUT 5000               // Server connect and response timeout (ms)
+#endif
+#ifdef INFLUXDB_GZIP
+#ifndef INFLUXDB_GZIP_THRESHOLD
+#define INFLUXDB_GZIP_THRESHOLD 512         // Smaller write bodies are sent uncompressed (bytes)
+#endif
+GzipStream gzip;                            // Write body compressor
+#endif
 
 // InfluxDB configuration default values, set this values in secrets.h for
 #ifndef INFLUXDB_URL
@@ -193,27 +366,270 @@ char influxBucket[50] = INFLUXDB_BUCKET;    // InfluxDB bucket name
 char influxToken[100] = INFLUXDB_TOKEN;     // InfluxDB 
 char measurementName[20] = INFLUXDB_MEASUREMENT; // InfluxDB measuremen name
 char location[20] = INFLUXDB_LOCATION;      // InfluxDB TAG location
-//char ntpServer1[100] = "pool.ntp.org";
-//char ntpServer1[100] = "time.nis.gov";
+
+// Time synchronization, timestamps are UTC so no time zone is needed
+#ifndef NTP_SERVER_1
+#define NTP_SERVER_1 "pool.ntp.org"         // Time server for sample timestamps
+#endif
+#ifndef NTP_SERVER_2
+#define NTP_SERVER_2 "time.nist.gov"        // Secondary time server
+#endif
+#ifndef TIME_SYNC_INTERVAL
+#define TIME_SYNC_INTERVAL 60*60*1000UL     // Time synchronization interval (ms)
+#endif
+#ifndef TIME_PRECISION
+#define TIME_PRECISION "s"                  // Timestamp precision "s" or "ms"
+#endif
+char ntpServer1[40] = NTP_SERVER_1;         // NTP server
+char ntpServer2[40] = NTP_SERVER_2;         // Secondary NTP server
 //char ntpZone[100] = TZ_Europe_Prague; // Central Europe timezone (TZ.h), see https://ftp.fau.de/aminet/util/time/tzinfo.txt
+char timePrecision[3] = TIME_PRECISION;     // Timestamp precision "s" or "ms"
+
+// ***** Binary configuration section
+// Loaded by a single read without parsing, JSON file is written next to it for export
+// and is migrated (loaded and saved as binary) when the binary record is missing or invalid
+#define CONFIG_FILE "/config.bin"           // Binary configuration file name
+#define CONFIG_MAGIC 0x464C5843             // Binary configuration signature
+#define CONFIG_VERSION 3                    // Binary configuration layout version, increment on every change
+// Sensors compiled in, the record layout depends on them
+constexpr uint16_t CONFIG_SENSORS = Sensors::CONFIG;
+// Fixed layout configuration record
+struct ConfigRecord {
+  uint32_t crc;                             // CRC32 of the rest of record
+  uint32_t magic;                           // CONFIG_MAGIC
+  uint16_t version;                         // CONFIG_VERSION
+  uint16_t size;                            // sizeof(ConfigRecord)
+  uint16_t sensors;                         // CONFIG_SENSORS
+  uint16_t batchSize;
+  uint32_t batchMaxAge;
+  uint32_t heartbeatInterval;
+  char influxUrl[sizeof(::influxUrl)];
+  char influxOrg[sizeof(::influxOrg)];
+  char influxBucket[sizeof(::influxBucket)];
+  char influxToken[sizeof(::influxToken)];
+  char measurementName[sizeof(::measurementName)];
+  char location[sizeof(::location)];
+  char ntpServer1[sizeof(::ntpServer1)];
+  char ntpServer2[sizeof(::ntpServer2)];
+  char timePrecision[sizeof(::timePrecision)];
+  SensorSetting sensorSettings[sizeof(::sensorSettings) / sizeof(SensorSetting)];
+};
+uint32_t configMillis = 0;                  // Time from boot to configuration loaded (ms)
+
+// ***** Fast WiFi connect section
+// Directed connect to the last access point (no channel scan), with the last IP lease (no DHCP)
+// when FAST_CONNECT_STATIC_IP is defined, WiFiManager connects as before when it fails
+#ifdef USE_FAST_CONNECT
+#ifndef FAST_CONNECT_TIMEOUT
+#define FAST_CONNECT_TIMEOUT 3000           // Directed connect wait before WiFiManager connect (ms)
+#endif
+#define WIFI_CACHE_FILE "/wifi.bin"         // Last good connection file name
+// Last good connection, written only when it changes
+struct WifiCache {
+  uint32_t crc;                             // CRC32 of the rest of cache
+  uint8_t bssid[6];                         // Access point MAC address
+  uint16_t channel;                         // Access point channel
+  uint32_t ip;                              // IP lease
+  uint32_t gateway;
+  uint32_t mask;
+  uint32_t dns;
+};
+// Connect to cached access point, returns false (station reset to scan and DHCP) when it fails
+bool fastConnect();
+// Store current connection when it differs from cache
+void saveWifiCache();
+#define FAST_CONNECT() fastConnect()
+#else
+#define FAST_CONNECT() false                // DO NOTHING - fast connect
+#endif
+uint32_t wifiStart = 0;                     // WiFi connect start (ms)
+uint32_t wifiMillis = 0;                    // WiFi connect time (ms)
+uint32_t firstByteMillis = 0;               // WiFi connect start until InfluxDB connection ready (ms)
+bool wifiFast = false;                      // Connected by fast path
 
 // Define internal variables
 char deviceId[25];                          // Device identifier (config WiFi name), DEVICE_NAME and chip ID
 bool shouldSaveConfig = false;              // Request to save configuration, set by WiFi manager callback
+uint64_t millisOffset = 0;                  // Time before this boot (deep sleep), added to millis64()
 
 /***** Global function headers *****/
 // Longer than 47 days millis (64 bit)
 uint64_t millis64();                       
+#ifdef USE_DEEP_SLEEP
+// Restore state from RTC memory, returns true when radio is enabled in this wake
+bool sleepWake();
+// Store samples to RTC memory and go to deep sleep, next wake with radio when batch is due
+void sleepEnd();
+// Store samples to RTC memory and go to deep sleep
+void sleepNow(uint32_t sleepMillis, bool radio);
+#endif
+// Initialize sensors
+void sensorsBegin();
+// Start sensor conversions, returns time until values are ready (ms)
+uint32_t sampleStart(Sample& sample);
+// Collect converted values, returns true when there are any data to write
+bool sampleCollect(Sample& sample);
+// Read all sensors to sample (blocking), returns true when there are any data to write
+bool readSample(Sample& sample);
+#ifdef USE_AGGREGATION
+// Add sensor values of one reading to window statistics
+void aggregateAdd(const Sample& reading);
+// Replace reading values by window statistics and start new window, returns true when there are any data to write
+bool aggregateSample(Sample& sample);
+#endif
+// Copy deadbands and heartbeat from configuration to report state
+void reportBegin();
+// Remove fields changed less than deadband, returns false when nothing is left to write
+bool reportFilter(Sample& sample);
+// Cache escaped measurement and tags, call after (re)connection
+void encoderBegin();
+// Append sample as line protocol to write buffer, timestamp 0 = server time
+bool sampleLine(const Sample& sample, uint64_t timestamp);
+// Append sensor field (with window statistics when aggregated) to the current line
+void sampleField(const Sample& sample, uint8_t field, const char* name);
+// Is there enough samples (or old enough) for write
+bool batchDue();
+// Write pending samples to InfluxDB in batches
+bool flushSamples();
 // FAIL stop with LED blinking
 void fail(int count);                       
-// Configration file operations
+// Configration file operations, binary record and JSON export
 void saveConfigFile();
-// Load configuration file
+// Load configuration file, binary record or JSON (migrated to binary)
 bool loadConfigFile();
+// Binary configuration record, returns false when missing or invalid
+bool loadConfigRecord();
+void saveConfigRecord();
+// JSON configuration file
+bool loadConfigJson();
+void saveConfigJson();
 // Delete configuration file
 void deleteConfigFile();
 // WiFiManager callbacks
 void saveConfigCallback();
 void configModeCallback(WiFiManager* myWiFiManager);
 
+// ***** Time section
+TimeSync timeSync(millis64);                // Unix time of millis64(), drift corrected
+// Unix time of millis64() value in configured precision, 0 when time is not synchronized
+uint64_t clockTime(uint64_t monotonic);
+// Sample timestamp in configured precision, 0 when time is not synchronized
+uint64_t sampleTime(const Sample& sample);
+// Unix time (ms) in configured precision
+uint64_t precisionTime(uint64_t epochMillis);
+
+// ***** Connectivity section
+// Backoff and circuit breaker of writes (LINK_* defines), time spent in WiFi and server states
+Link connectivity(millis64);
+// Report InfluxDB write result (status and Retry-After of writer) to connectivity state
+void connectivityResult(bool written);
+
+// ***** Telemetry section
+#ifdef USE_TELEMETRY
+#ifndef TELEMETRY_INTERVAL
+#define TELEMETRY_INTERVAL 15*60*1000       // Telemetry write interval (ms)
+#endif
+#ifndef TELEMETRY_OFFSET
+#define TELEMETRY_OFFSET 60*1000            // First telemetry write after boot (ms)
+#endif
+#ifndef TELEMETRY_MEASUREMENT
+#define TELEMETRY_MEASUREMENT "telemetry"   // Telemetry measurement name
+#endif
+#ifndef TELEMETRY_BODY_SIZE
+#define TELEMETRY_BODY_SIZE 768             // Telemetry line buffer (bytes)
+#endif
+// Measured firmware stages
+enum TelemetryStage : uint8_t {
+  STAGE_SENSORS,                            // Sensor read (Sensors::COUNT stages, one per sensor in list order)
+  STAGE_ENCODE = STAGE_SENSORS + Sensors::COUNT, // Line protocol of one write request
+  STAGE_WRITE,                              // InfluxDB write request
+  STAGE_RECONNECT,                          // WiFi lost until restored
+  STAGE_BUS_SCAN,                           // DS18B20 bus search, not run when addresses are cached
+  STAGE_COUNT
+};
+// Class of failed write, from InfluxWriter status
+enum WriteErrorClass : uint8_t {
+  WRITE_ERROR_NONE,                         // No write failed
+  WRITE_ERROR_CONFIG,                       // Invalid URL
+  WRITE_ERROR_CONNECT,                      // Connection refused (DNS, TCP or TLS)
+  WRITE_ERROR_NETWORK,                      // Send failed or connection lost
+  WRITE_ERROR_TIMEOUT,                      // No response in time
+  WRITE_ERROR_AUTH,                         // HTTP 401 or 403
+  WRITE_ERROR_REQUEST,                      // Other HTTP 4xx (invalid or too large body)
+  WRITE_ERROR_THROTTLED,                    // HTTP 429
+  WRITE_ERROR_SERVER                        // HTTP 5xx
+};
+// Firmware self-measurement, written as own measurement every TELEMETRY_INTERVAL
+struct Telemetry {
+  uint32_t lastMicros[STAGE_COUNT];         // Last duration of stage (us)
+  uint32_t maxMicros[STAGE_COUNT];          // Longest duration since last telemetry write (us)
+  uint32_t heapMin;                         // Lowest free heap after a stage since last telemetry write
+  uint32_t reconnects;                      // WiFi connections restored
+  uint32_t writeFailures;                   // Failed InfluxDB writes
+  uint32_t overruns;                        // Task periods skipped, all tasks
+  WriteErrorClass lastError;                // Class of the last failed write
+};
+Telemetry telemetry;
+char telemetryBody[TELEMETRY_BODY_SIZE];    // Line protocol of telemetry write
+LineProtocol telemetryEncoder(telemetryBody, sizeof(telemetryBody)); // Telemetry encoder with own measurement
+// Record stage duration from its start (micros())
+void telemetryStage(uint8_t stage, uint32_t startMicros);
+// Record failed write with InfluxWriter status
+void telemetryError(int status);
+// Encode telemetry line to telemetryBody
+bool telemetryLine();
+#define TELEMETRY_STAGE(stage, start) telemetryStage(stage, start)
+#define TELEMETRY_ERROR(status) telemetryError(status)
+#else
+#define TELEMETRY_STAGE(stage, start) (void)(start) // DO NOTHING - telemetry
+#define TELEMETRY_ERROR(status)             // DO NOTHING - telemetry
+#endif
+
+// ***** Scheduler section
+#ifndef FLUSH_INTERVAL
+#define FLUSH_INTERVAL 1000                 // Batch write check interval (ms)
+#endif
+#ifndef CONNECT_INTERVAL
+#define CONNECT_INTERVAL 1000               // WiFi connection check interval (ms)
+#endif
+#ifndef CONNECT_TIMEOUT
+#define CONNECT_TIMEOUT 30000               // Reconnect WiFi after being disconnected for this time (ms)
+#endif
+#ifndef TIME_CHECK_INTERVAL
+#define TIME_CHECK_INTERVAL 1000            // Time synchronization due check interval (ms)
+#endif
+#ifndef STATS_INTERVAL
+#define STATS_INTERVAL 10*60*1000           // Task statistics print interval (ms), DEBUG only
+#endif
+// Tasks run from loop()
+enum TaskId : uint8_t {
+  #ifdef USE_LED
+  TASK_LED,                                 // LED blinking
+  #endif
+  TASK_SAMPLE,                              // Sensor sampling
+  TASK_FLUSH,                               // Write samples to InfluxDB
+  TASK_CONNECT,                             // WiFi connection
+  TASK_TIME,                                // Time synchronization
+  #ifdef USE_TELEMETRY
+  TASK_TELEMETRY,                           // Telemetry write
+  #endif
+  #ifdef USE_SAMPLE_LOG
+  TASK_REPLAY,                              // Write logged samples
+  #endif
+  #ifdef DEBUG
+  TASK_STATS,                               // Print task statistics
+  #endif
+  TASK_COUNT
+};
+Scheduler<TASK_COUNT> scheduler(millis64, []() -> uint32_t { return micros(); });
+// Task bodies, return TASK_DONE or time to wait (ms)
+uint32_t ledTask();
+uint32_t sampleTask();
+uint32_t flushTask();
+uint32_t connectTask();
+uint32_t timeTask();
+uint32_t telemetryTask();
+uint32_t replayTask();
+uint32_t statsTask();
+
 #endif
\ No newline at end of file
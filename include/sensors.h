@@ -0,0 +1,407 @@
+#ifndef SENSORS_H_
+// Multiple include detection
+#define SENSORS_H_
+
+/*****************************************************************************
+ * Sensor registry
+ *****************************************************************************
+ * Every sensor driver is a class of the same shape:
+ *   ID, TITLE             telemetry stage name, configuration portal section
+ *   FIELDS                consecutive sample fields owned by the sensor
+ *   CHANNELS, channels[]  configured quantities, field name and deadband
+ *                         (portal parameters, JSON keys, defaults)
+ *   CONFIG                bit of binary configuration layout
+ *   CONVERSION            start() begins a conversion, started before others
+ *   channel(field)        channel whose deadband applies to the field
+ *   begin(), start(), collect(), line()
+ * Enabled sensors form a compile time list (Sensors in main.h), which
+ * assigns sample fields, channels and telemetry stages to every sensor and
+ * calls a generic lambda for each of them. List order is the field order of
+ * written lines, acquisition starts sensors with conversion first. Everything is resolved by the
+ * compiler, drivers are inlined without virtual calls.
+ *
+ * Adding a sensor: driver class here, its bodies in main.cpp (Sensors), one
+ * line in the list and a USE_* option in config.h.
+ *****************************************************************************/
+
+#include <Arduino.h>
+#ifdef USE_DHT_SENSOR
+#include <DhtReader.h>
+#endif
+#ifdef USE_BMP280_SENSOR
+#include <Adafruit_Sensor.h>
+#include <Adafruit_BMP280.h>
+#endif
+#ifdef USE_BME280_SENSOR
+#include <Adafruit_Sensor.h>
+#include <Adafruit_BME280.h>
+#endif
+#ifdef USE_DS18B20_SENSOR
+#include <OneWire.h>
+#include <DallasTemperature.h>
+#endif
+
+struct Sample;
+
+#define SENSOR_NAME_SIZE 15                 // Field name buffer (bytes)
+
+// Configured quantity of a sensor (constant description)
+struct SensorChannel {
+  const char* key;                          // JSON key of field name
+  const char* deadbandKey;                  // JSON key of deadband
+  const char* id;                           // Portal parameter of field name
+  const char* deadbandId;                   // Portal parameter of deadband
+  const char* label;                        // Portal label of field name
+  const char* deadbandLabel;                // Portal label of deadband
+  const char* name;                         // Default field name
+  float deadband;                           // Default deadband
+};
+
+// Run-time settings of a channel (configuration)
+struct SensorSetting {
+  char name[SENSOR_NAME_SIZE];              // InfluxDB field name
+  float deadband;                           // Change reported, 0 = every value
+};
+
+// Position of a sensor in the list
+struct SensorSlot {
+  uint8_t index;                            // Sensor number, telemetry stage
+  uint8_t field;                            // First sample field
+  uint8_t channel;                          // First channel in sensorSettings
+};
+
+// Compile time list of sensors, each one gets its slot after the previous ones
+template <uint8_t Index, uint8_t Field, uint8_t Channel, typename... S>
+struct SensorChain {
+  static constexpr uint8_t COUNT = 0;
+  static constexpr uint8_t FIELDS = 0;
+  static constexpr uint8_t CHANNELS = 0;
+  static constexpr uint16_t CONFIG = 0;
+  template <typename F> void each(F&&) {}
+  template <typename F> void each(bool, F&&) {}
+};
+
+template <uint8_t Index, uint8_t Field, uint8_t Channel, typename First, typename... Rest>
+struct SensorChain<Index, Field, Channel, First, Rest...> {
+  typedef SensorChain<Index + 1, Field + First::FIELDS, Channel + First::CHANNELS, Rest...> Next;
+  static constexpr uint8_t COUNT = 1 + Next::COUNT;
+  static constexpr uint8_t FIELDS = First::FIELDS + Next::FIELDS;
+  static constexpr uint8_t CHANNELS = First::CHANNELS + Next::CHANNELS;
+  static constexpr uint16_t CONFIG = First::CONFIG | Next::CONFIG;
+  static constexpr SensorSlot SLOT = { Index, Field, Channel };
+  First sensor;
+  Next next;
+  // Call f(sensor, slot) for every sensor in list order
+  template <typename F> void each(F&& f) {
+    f(sensor, SLOT);
+    next.each(f);
+  }
+  // Call f(sensor, slot) for sensors with or without conversion, in list order
+  template <typename F> void each(bool conversion, F&& f) {
+    if (First::CONVERSION == conversion)
+      f(sensor, SLOT);
+    next.each(conversion, f);
+  }
+  // Sensors with conversion first, the others are read while they convert
+  template <typename F> void acquire(F&& f) {
+    each(true, f);
+    each(false, f);
+  }
+};
+
+// ***** DHT sensor section
+#ifdef USE_DHT_SENSOR
+#ifndef DHT_PIN
+#define DHT_PIN D6                          // Digital pin connected to the DHT sensor
+#endif
+#ifndef DHT_TYPE
+#define DHT_TYPE DHT11                      // DHT 11 | DHT 22 (AM2302) | DHT 21 (AM2301)
+#endif
+#ifndef DHT_FIELD_TEMPERATURE
+#define DHT_FIELD_TEMPERATURE "temperature" // DHT temperature field value
+#endif
+#ifndef DHT_FIELD_HUMIDITY
+#define DHT_FIELD_HUMIDITY "humidity"       // DHT humidity field value
+#endif
+#ifndef DHT_FIELD_HEATINDEX
+#define DHT_FIELD_HEATINDEX "heatIndex"     // DHT heat index field value
+#endif
+#ifndef DHT_FIELD_DEWPOINT
+#define DHT_FIELD_DEWPOINT "dewPoint"       // DHT dew point field value
+#endif
+#ifndef DHT_FIELD_ABSHUMIDITY
+#define DHT_FIELD_ABSHUMIDITY "absHumidity" // DHT absolute humidity field value (g/m3)
+#endif
+#ifndef DHT_DEADBAND_TEMPERATURE
+#define DHT_DEADBAND_TEMPERATURE 0          // Temperature change reported (Celsius, also heat index and dew point), 0 = every value
+#endif
+#ifndef DHT_DEADBAND_HUMIDITY
+#define DHT_DEADBAND_HUMIDITY 0             // Humidity change reported (%, also absolute humidity), 0 = every value
+#endif
+// Start pulse and frame run in background (DhtReader), frame decoded by collect()
+class DhtSensor {
+public:
+  static constexpr const char* ID = "dht";
+  static constexpr const char* TITLE = "<h3>DHT sensor field names</h3>";
+  enum : uint8_t {
+    TEMPERATURE,
+    HUMIDITY,
+    #ifndef DHT_NO_HEATINDEX
+    HEATINDEX,
+    #endif
+    #ifndef DHT_NO_DEWPOINT
+    DEWPOINT,
+    #endif
+    #ifndef DHT_NO_ABSHUMIDITY
+    ABSHUMIDITY,
+    #endif
+    FIELDS
+  };
+  static constexpr uint8_t CHANNELS = 2;
+  static constexpr SensorChannel channels[CHANNELS] = {
+    { "dhtTemp", "dhtTempDb", "dht_field_temperature", "dht_deadband_temperature", "Temperature",
+      "Temperature deadband (C)", DHT_FIELD_TEMPERATURE, DHT_DEADBAND_TEMPERATURE },
+    { "dhtHumi", "dhtHumiDb", "dht_field_humidity", "dht_deadband_humidity", "Humidity",
+      "Humidity deadband (%)", DHT_FIELD_HUMIDITY, DHT_DEADBAND_HUMIDITY }
+  };
+  static constexpr uint16_t CONFIG = 1 << 0;
+  static constexpr bool CONVERSION = false;
+  // Heat index and dew point change with temperature, absolute humidity with humidity
+  static constexpr uint8_t channel(uint8_t field) {
+    return field == HUMIDITY
+      #ifndef DHT_NO_ABSHUMIDITY
+      || field == ABSHUMIDITY
+      #endif
+      ? 1 : 0;
+  }
+
+  void begin(const SensorSlot& slot);
+  uint32_t start(Sample& sample, const SensorSlot& slot);
+  void collect(Sample& sample, const SensorSlot& slot);
+  void line(const Sample& sample, const SensorSlot& slot);
+
+private:
+  DhtReader _reader = DhtReader(DHT_PIN, DHT_TYPE);
+};
+#endif
+
+// ***** BMP280 sensor section
+#ifdef USE_BMP280_SENSOR
+#ifndef BMP280_I2C_ADDRESS
+#define BMP280_I2C_ADDRESS BMP280_ADDRESS_ALT   // BMP280 I2C ADDRESS
+#endif
+#ifndef BMP280_FIELD_TEMPERATURE
+#define BMP280_FIELD_TEMPERATURE "temperature"  // BMP280 temperature field value
+#endif
+#ifndef BMP280_FIELD_PRESSURE
+#define BMP280_FIELD_PRESSURE "pressure"        // BMP280 pressure field value
+#endif
+#ifndef BMP280_FIELD_SEALEVEL
+#define BMP280_FIELD_SEALEVEL "seaLevelPressure" // BMP280 sea level pressure field value (BMP280_ALTITUDE)
+#endif
+#ifndef BMP280_FIELD_ALTITUDE
+#define BMP280_FIELD_ALTITUDE "altitude"        // BMP280 altitude field value (BMP280_SEALEVEL_PRESSURE)
+#endif
+#ifndef BMP280_SAMPLING_TEMPERATURE
+#define BMP280_SAMPLING_TEMPERATURE Adafruit_BMP280::SAMPLING_X1  // BMP280 temperature oversampling
+#endif
+#ifndef BMP280_SAMPLING_PRESSURE
+#define BMP280_SAMPLING_PRESSURE Adafruit_BMP280::SAMPLING_X4     // BMP280 pressure oversampling
+#endif
+#ifndef BMP280_CONVERSION_TIME
+#define BMP280_CONVERSION_TIME 14           // BMP280 forced conversion time for oversampling above (ms)
+#endif
+#ifndef BMP280_DEADBAND_TEMPERATURE
+#define BMP280_DEADBAND_TEMPERATURE 0       // Temperature change reported (Celsius), 0 = every value
+#endif
+#ifndef BMP280_DEADBAND_PRESSURE
+#define BMP280_DEADBAND_PRESSURE 0          // Pressure change reported (Pa, also sea level pressure and altitude), 0 = every value
+#endif
+// Forced conversion started by start(), read by collect()
+class Bmp280Sensor {
+public:
+  static constexpr const char* ID = "bmp280";
+  static constexpr const char* TITLE = "<h3>BMP280 sensor field names</h3>";
+  enum : uint8_t {
+    PRESSURE,
+    #ifndef BMP280_NO_TEMPERATURE
+    TEMPERATURE,
+    #endif
+    #ifdef BMP280_ALTITUDE
+    SEALEVEL,
+    #endif
+    #ifdef BMP280_SEALEVEL_PRESSURE
+    ALTITUDE,
+    #endif
+    FIELDS
+  };
+  #ifndef BMP280_NO_TEMPERATURE
+  static constexpr uint8_t CHANNELS = 2;
+  static constexpr SensorChannel channels[CHANNELS] = {
+    { "bmp280Temp", "bmp280TempDb", "bmp280_field_temperature", "bmp280_deadband_temperature", "Temperature",
+      "Temperature deadband (C)", BMP280_FIELD_TEMPERATURE, BMP280_DEADBAND_TEMPERATURE },
+    { "bmp280Press", "bmp280PressDb", "bmp280_field_pressure", "bmp280_deadband_pressure", "Pressure",
+      "Pressure deadband (Pa)", BMP280_FIELD_PRESSURE, BMP280_DEADBAND_PRESSURE }
+  };
+  static constexpr uint16_t CONFIG = 1 << 1;
+  static constexpr bool CONVERSION = true;
+  // Sea level pressure and altitude change with pressure
+  static constexpr uint8_t channel(uint8_t field) { return field == TEMPERATURE ? 0 : 1; }
+  #else
+  static constexpr uint8_t CHANNELS = 1;
+  static constexpr SensorChannel channels[CHANNELS] = {
+    { "bmp280Press", "bmp280PressDb", "bmp280_field_pressure", "bmp280_deadband_pressure", "Pressure",
+      "Pressure deadband (Pa)", BMP280_FIELD_PRESSURE, BMP280_DEADBAND_PRESSURE }
+  };
+  static constexpr uint16_t CONFIG = 1 << 1 | 1 << 2;
+  static constexpr bool CONVERSION = true;
+  static constexpr uint8_t channel(uint8_t field) { return 0; }
+  #endif
+
+  void begin(const SensorSlot& slot);
+  uint32_t start(Sample& sample, const SensorSlot& slot);
+  void collect(Sample& sample, const SensorSlot& slot);
+  void line(const Sample& sample, const SensorSlot& slot);
+
+private:
+  Adafruit_BMP280 _bmp280;                  // I2C connection for sensor
+};
+#endif
+
+// ***** BME280 sensor section
+#ifdef USE_BME280_SENSOR
+#ifndef BME280_I2C_ADDRESS
+#define BME280_I2C_ADDRESS BME280_ADDRESS_ALTERNATE // BME280 I2C ADDRESS
+#endif
+#ifndef BME280_FIELD_TEMPERATURE
+#define BME280_FIELD_TEMPERATURE "temperature"  // BME280 temperature field value
+#endif
+#ifndef BME280_FIELD_HUMIDITY
+#define BME280_FIELD_HUMIDITY "humidity"        // BME280 humidity field value
+#endif
+#ifndef BME280_FIELD_PRESSURE
+#define BME280_FIELD_PRESSURE "pressure"        // BME280 pressure field value
+#endif
+#ifndef BME280_SAMPLING_TEMPERATURE
+#define BME280_SAMPLING_TEMPERATURE Adafruit_BME280::SAMPLING_X1  // BME280 temperature oversampling
+#endif
+#ifndef BME280_SAMPLING_PRESSURE
+#define BME280_SAMPLING_PRESSURE Adafruit_BME280::SAMPLING_X4     // BME280 pressure oversampling
+#endif
+#ifndef BME280_SAMPLING_HUMIDITY
+#define BME280_SAMPLING_HUMIDITY Adafruit_BME280::SAMPLING_X1     // BME280 humidity oversampling
+#endif
+#ifndef BME280_CONVERSION_TIME
+#define BME280_CONVERSION_TIME 17           // BME280 forced conversion time for oversampling above (ms)
+#endif
+#ifndef BME280_DEADBAND_TEMPERATURE
+#define BME280_DEADBAND_TEMPERATURE 0       // Temperature change reported (Celsius), 0 = every value
+#endif
+#ifndef BME280_DEADBAND_HUMIDITY
+#define BME280_DEADBAND_HUMIDITY 0          // Humidity change reported (%), 0 = every value
+#endif
+#ifndef BME280_DEADBAND_PRESSURE
+#define BME280_DEADBAND_PRESSURE 0          // Pressure change reported (Pa), 0 = every value
+#endif
+// Forced conversion started by start(), read by collect()
+class Bme280Sensor {
+public:
+  static constexpr const char* ID = "bme280";
+  static constexpr const char* TITLE = "<h3>BME280 sensor field names</h3>";
+  enum : uint8_t {
+    TEMPERATURE,
+    HUMIDITY,
+    PRESSURE,
+    FIELDS
+  };
+  static constexpr uint8_t CHANNELS = 3;
+  static constexpr SensorChannel channels[CHANNELS] = {
+    { "bme280Temp", "bme280TempDb", "bme280_field_temperature", "bme280_deadband_temperature", "Temperature",
+      "Temperature deadband (C)", BME280_FIELD_TEMPERATURE, BME280_DEADBAND_TEMPERATURE },
+    { "bme280Humi", "bme280HumiDb", "bme280_field_humidity", "bme280_deadband_humidity", "Humidity",
+      "Humidity deadband (%)", BME280_FIELD_HUMIDITY, BME280_DEADBAND_HUMIDITY },
+    { "bme280Press", "bme280PressDb", "bme280_field_pressure", "bme280_deadband_pressure", "Pressure",
+      "Pressure deadband (Pa)", BME280_FIELD_PRESSURE, BME280_DEADBAND_PRESSURE }
+  };
+  static constexpr uint16_t CONFIG = 1 << 4;
+  static constexpr bool CONVERSION = true;
+  static constexpr uint8_t channel(uint8_t field) { return field; }
+
+  void begin(const SensorSlot& slot);
+  uint32_t start(Sample& sample, const SensorSlot& slot);
+  void collect(Sample& sample, const SensorSlot& slot);
+  void line(const Sample& sample, const SensorSlot& slot);
+
+private:
+  Adafruit_BME280 _bme280;                  // I2C connection for sensor
+};
+#endif
+
+// ***** DS18B20 sensor section
+#ifdef USE_DS18B20_SENSOR
+#ifndef DS18B20_PIN
+#define DS18B20_PIN D5                      // Digital pin connected to the DS18B20 sensor
+#endif
+#ifndef DS18B20_FIELD_TEMPERATURE
+#define DS18B20_FIELD_TEMPERATURE "temperature" // DS18B20 temperature field value
+#endif
+#ifndef DS18B20_MAX_DEVICES
+#define DS18B20_MAX_DEVICES 4               // Maximum DS18B20 devices on the bus
+#endif
+#ifndef DS18B20_DEADBAND_TEMPERATURE
+#define DS18B20_DEADBAND_TEMPERATURE 0      // Temperature change reported (Celsius, every device), 0 = every value
+#endif
+#ifndef DS18B20_RESOLUTION
+#define DS18B20_RESOLUTION 12               // Conversion resolution 9-12 bit, conversion 94/188/375/750 ms
+#endif
+#if DS18B20_RESOLUTION < 9 || DS18B20_RESOLUTION > 12
+#error "DS18B20_RESOLUTION must be 9 to 12 bit"
+#endif
+#define DS18B20_CACHE_FILE "/ds18b20.bin"   // Bus devices file name
+// Devices found by the last bus search, written only when it changes
+struct Ds18b20Cache {
+  uint32_t crc;                             // CRC32 of the rest of cache
+  uint8_t count;                            // Devices used
+  uint8_t resolution;                       // Resolution written to devices
+  bool search;                              // Device failed to read, search bus on next start
+  bool parasite;                            // Some device is parasite powered (no VDD)
+  DeviceAddress addresses[DS18B20_MAX_DEVICES]; // ROM addresses in field order
+};
+// Conversion of all devices started by start(), read by address in collect(), one field per device.
+// Bus is searched only when cached addresses are missing or a device failed to read (by the next start).
+class Ds18b20Sensor {
+public:
+  static constexpr const char* ID = "ds18b20";
+  static constexpr const char* TITLE = "<h3>DS18B20 sensor field names</h3>";
+  static constexpr uint8_t FIELDS = DS18B20_MAX_DEVICES;
+  static constexpr uint8_t CHANNELS = 1;
+  static constexpr SensorChannel channels[CHANNELS] = {
+    { "dsTemp", "dsTempDb", "ds18b20_field_temperature", "ds18b20_deadband_temperature", "Temperature",
+      "Temperature deadband (C)", DS18B20_FIELD_TEMPERATURE, DS18B20_DEADBAND_TEMPERATURE }
+  };
+  static constexpr uint16_t CONFIG = 1 << 3;
+  static constexpr bool CONVERSION = true;
+  static constexpr uint8_t channel(uint8_t field) { return 0; }
+
+  void begin(const SensorSlot& slot);
+  uint32_t start(Sample& sample, const SensorSlot& slot);
+  void collect(Sample& sample, const SensorSlot& slot);
+  void line(const Sample& sample, const SensorSlot& slot);
+
+private:
+  // Addresses from cache file, false when it is missing or not valid
+  bool loadDevices();
+  // Search the bus, cached devices keep their fields
+  void searchBus();
+  // Write resolution to devices when it changed
+  void writeResolution();
+  void saveDevices();
+
+  Ds18b20Cache _devices = {};               // Devices read, field i is device i
+  bool _converting = false;                 // Dallas conversion was started
+  OneWire _oneWire = OneWire(DS18B20_PIN);  // Setup a oneWire instance to communicate with any OneWire devices
+  DallasTemperature _dallas = DallasTemperature(&_oneWire); // Pass our oneWire reference to Dallas Temperature.
+};
+#endif
+
+#endif
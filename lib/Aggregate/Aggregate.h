@@ -0,0 +1,55 @@
+/*****************************************************************************
+ * Streaming statistics of one value
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Count, mean, minimum, maximum and standard deviation of values added one
+ * by one, in constant memory (20 bytes). Mean and variance are updated by
+ * Welford's method, which stays accurate for values with a large offset
+ * (such as air pressure in Pa), where a float sum of squares would lose all
+ * significant digits.
+ *****************************************************************************/
+#ifndef AGGREGATE_H_
+#define AGGREGATE_H_
+
+#include <math.h>
+#include <stdint.h>
+
+class Aggregate {
+public:
+  // Start new window
+  void clear() {
+    _count = 0;
+    _mean = _m2 = 0;
+    _minimum = INFINITY;
+    _maximum = -INFINITY;
+  }
+  void add(float value) {
+    _count++;
+    float delta = value - _mean;
+    _mean += delta / _count;
+    _m2 += delta * (value - _mean);
+    if (value < _minimum)
+      _minimum = value;
+    if (value > _maximum)
+      _maximum = value;
+  }
+
+  uint16_t count() const { return _count; }
+  // Statistics are valid only when count() > 0
+  float mean() const { return _mean; }
+  float minimum() const { return _minimum; }
+  float maximum() const { return _maximum; }
+  // Population standard deviation (of the window values, not an estimate of a larger set)
+  float stddev() const { return _count > 1 ? sqrtf(_m2 / _count) : 0; }
+
+private:
+  uint16_t _count = 0;
+  float _mean = 0;
+  float _m2 = 0;                            // Sum of squared differences from the mean
+  float _minimum = INFINITY;
+  float _maximum = -INFINITY;
+};
+
+#endif
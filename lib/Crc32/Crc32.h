@@ -0,0 +1,18 @@
+/*****************************************************************************
+ * CRC-32 checksum
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Standard CRC-32 (IEEE 802.3, as zlib), nibble table to keep flash small.
+ *****************************************************************************/
+#ifndef CRC32_H_
+#define CRC32_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Checksum of data, pass previous result as crc to continue
+uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+#endif
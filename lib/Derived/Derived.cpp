@@ -0,0 +1,165 @@
+/*****************************************************************************
+ * Derived quantities in fixed point
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************/
+#include <Arduino.h>
+#include "Derived.h"
+
+// Constant x in fixed point with q fraction bits, rounded (compile time)
+#define FIXED(x, q) ((int64_t)((x) * (double)(1LL << (q)) + ((x) < 0 ? -0.5 : 0.5)))
+#define LN_2 FIXED(0.69314718056, 30)
+#define LOG2_E FIXED(1.44269504089, 30)
+#define LOG2_100 FIXED(6.64385618977, 24)
+// log2(1 + i / 64) and 2^(i / 64) (Q30), two entries over the range for quadratic interpolation
+static const uint32_t log2Table[66] PROGMEM = {
+  0, 24017256, 47667823, 70962728, 93912511, 116527248, 138816582, 160789745,
+  182455581, 203822568, 224898839, 245692198, 266210141, 286459867, 306448299, 326182095,
+  345667660, 364911162, 383918542, 402695523, 421247625, 439580170, 457698295, 475606957,
+  493310944, 510814882, 528123241, 545240343, 562170370, 578917365, 595485245, 611877800,
+  628098702, 644151509, 660039669, 675766525, 691335320, 706749198, 722011213, 737124328,
+  752091421, 766915285, 781598637, 796144114, 810554283, 824831638, 838978604, 852997541,
+  866890747, 880660455, 894308843, 907838029, 921250079, 934547002, 947730758, 960803257,
+  973766362, 986621888, 999371606, 1012017244, 1024560487, 1037002979, 1049346328, 1061592099,
+  1073741824, 1085796998
+};
+static const uint32_t exp2Table[66] PROGMEM = {
+  1073741824, 1085434106, 1097253708, 1109202018, 1121280436, 1133490379, 1145833280, 1158310587,
+  1170923762, 1183674286, 1196563654, 1209593378, 1222764986, 1236080024, 1249540052, 1263146652,
+  1276901417, 1290805962, 1304861917, 1319070932, 1333434672, 1347954824, 1362633090, 1377471191,
+  1392470869, 1407633882, 1422962010, 1438457051, 1454120821, 1469955159, 1485961921, 1502142985,
+  1518500250, 1535035634, 1551751076, 1568648537, 1585730000, 1602997467, 1620452965, 1638098541,
+  1655936265, 1673968228, 1692196547, 1710623359, 1729250827, 1748081133, 1767116489, 1786359126,
+  1805811301, 1825475297, 1845353420, 1865448001, 1885761398, 1906295993, 1927054196, 1948038440,
+  1969251188, 1990694927, 2012372174, 2034285470, 2056437387, 2078830522, 2101467502, 2124350982,
+  2147483648, 2170868212
+};
+
+// Quadratic (Newton) interpolation of table at index plus fraction (Q16)
+static uint32_t interpolate(const uint32_t* table, uint8_t index, uint32_t fraction) {
+  int64_t y0 = pgm_read_dword(table + index);
+  int64_t y1 = pgm_read_dword(table + index + 1);
+  int64_t y2 = pgm_read_dword(table + index + 2);
+  int64_t half = (int64_t)fraction * ((int64_t)fraction - 65536) >> 17;
+  return y0 + ((y1 - y0) * fraction >> 16) + ((y2 - 2 * y1 + y0) * half >> 16);
+}
+
+// log2(value / 2^q) (Q24), value > 0
+static int32_t log2Fixed(uint32_t value, uint8_t q) {
+  uint8_t msb = 31 - __builtin_clz(value);
+  uint32_t mantissa = value << (31 - msb);  // 1.xxx with the leading one in bit 31
+  int32_t fraction = interpolate(log2Table, (mantissa >> 25) & 63, (mantissa >> 9) & 0xFFFF);
+  return ((int32_t)msb - q) * (1L << 24) + (fraction >> 6);
+}
+
+// 2^y (Q30) of y (Q24), y < 32
+static uint64_t exp2Fixed(int32_t y) {
+  int32_t exponent = y >> 24;               // Floor, also for negative y
+  uint32_t fraction = y & 0xFFFFFF;
+  uint64_t mantissa = interpolate(exp2Table, fraction >> 18, (fraction >> 2) & 0xFFFF);
+  return exponent >= 0 ? mantissa << exponent : mantissa >> -exponent;
+}
+
+// Magnus exponent 17.625 T / (243.04 + T) (Q24) of temperature (C, Q12), ln of saturation vapour pressure (hPa / 6.1094)
+static int32_t magnus(int32_t temperature) {
+  return (int64_t)temperature * FIXED(17.625, 24) / (temperature + (int32_t)FIXED(243.04, 12));
+}
+
+// Fixed point range, float formula outside (C)
+static bool inRange(float temperature, float humidity) {
+  return temperature >= -60 && temperature <= 80 && humidity > 0 && humidity <= 200;
+}
+
+float dewPoint(float temperature, float humidity) {
+  if (!inRange(temperature, humidity)) {
+    // Magnus formula (constants by Alduchov and Eskridge)
+    float gamma = logf(humidity / 100.0f) + 17.625f * temperature / (243.04f + temperature);
+    return 243.04f * gamma / (17.625f - gamma);
+  }
+  // gamma = ln(RH / 100) + 17.625 T / (243.04 + T), humidity in Q16
+  int32_t ln = (log2Fixed(lroundf(humidity * 65536), 16) - LOG2_100) * LN_2 >> 30;
+  int32_t gamma = ln + magnus(lroundf(temperature * 4096));
+  // 243.04 gamma / (17.625 - gamma) (Q16)
+  int64_t dew = gamma * FIXED(243.04, 16) / (FIXED(17.625, 24) - gamma);
+  return (int32_t)dew * (1.0f / 65536);
+}
+
+float absoluteHumidity(float temperature, float humidity) {
+  if (!inRange(temperature, humidity)) {
+    // 2.1674 e / T (e in Pa, T in K), Magnus formula of saturation vapour pressure
+    return 2.1674f * 6.1094f * humidity * expf(17.625f * temperature / (243.04f + temperature)) / (273.15f + temperature);
+  }
+  int32_t t = lroundf(temperature * 4096);
+  // exp(gamma) = 2^(gamma log2 e) (Q30)
+  uint64_t power = exp2Fixed(magnus(t) * LOG2_E >> 30);
+  // RH exp(gamma) (Q24), humidity in Q16
+  uint64_t moisture = power * (uint32_t)lroundf(humidity * 65536) >> 22;
+  // 2.1674 6.1094 RH exp(gamma) / T (Q28)
+  return (float)(moisture * FIXED(2.1674 * 6.1094, 16) / (t + FIXED(273.15, 12))) * (1.0f / (1 << 28));
+}
+
+#define Q36(x) FIXED(x, 36)
+// Polynomial k0 + k1 x + k2 x^2 (Q36) of x (Q12)
+static int64_t polynomial(int64_t k0, int64_t k1, int64_t k2, int32_t x) {
+  return k0 + ((k1 + (k2 * x >> 12)) * x >> 12);
+}
+
+// Integer square root
+static uint32_t isqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > value)
+    bit >>= 2;
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+      root >>= 1;
+    bit >>= 2;
+  }
+  return root;
+}
+
+float heatIndex(float temperature, float humidity) {
+  // Fahrenheit and % (Q12)
+  int32_t t = lroundf(temperature * (1.8f * 4096)) + (32 << 12);
+  int32_t r = lroundf(humidity * 4096);
+  // Steadman, 0.5 (T + 61 + (T - 68) 1.2 + RH 0.094) (Q36)
+  int64_t hi = (Q36(1.1) * t >> 12) + (Q36(0.047) * r >> 12) - Q36(10.3);
+  if (hi > Q36(79)) {
+    // Rothfusz regression as A(RH) + T (B(RH) + T C(RH))
+    int64_t a = polynomial(Q36(-42.379), Q36(10.14333127), Q36(-0.05481717), r);
+    int64_t b = polynomial(Q36(2.04901523), Q36(-0.22475541), Q36(0.00085282), r);
+    int64_t c = polynomial(Q36(-0.00683783), Q36(0.00122874), Q36(-0.00000199), r);
+    hi = a + ((b + (c * t >> 12)) * t >> 12);
+    if (r < (13 << 12) && t >= (80 << 12) && t <= (112 << 12)) {
+      // Dry: ((13 - RH) 0.25) sqrt((17 - |T - 95|) 0.05882), square root of Q30 is Q15
+      uint32_t root = isqrt(((17 << 12) - abs(t - (95 << 12))) * Q36(0.05882) >> 18);
+      hi -= (int64_t)((13 << 12) - r) * root << 7;
+    }
+    else if (r > (85 << 12) && t >= (80 << 12) && t <= (87 << 12)) {
+      // Humid: ((RH - 85) 0.1) ((87 - T) 0.2)
+      hi += (int64_t)(r - (85 << 12)) * ((87 << 12) - t) * Q36(0.02) >> 24;
+    }
+  }
+  // Celsius, (F - 32) 5 / 9
+  return (float)((hi - Q36(32)) >> 12) * (float)(5.0 / 9 / (1 << 24));
+}
+
+float altitude(float pressure, float seaLevelPressure) {
+  // 44330 (1 - (p / p0)^0.1903)
+  int32_t ratio = log2Fixed(lroundf(pressure * 16), 4) - log2Fixed(lroundf(seaLevelPressure * 16), 4);
+  int64_t power = exp2Fixed(ratio * FIXED(0.1903, 30) >> 30);
+  // Millimeters
+  return (int32_t)(((1LL << 30) - power) * 44330000 >> 30) * 0.001f;
+}
+
+float seaLevelPressure(float pressure, float altitude) {
+  // p / (1 - h / 44330)^5.255, h in mm
+  int32_t base = log2Fixed(44330000 - lroundf(altitude * 1000), 0) - log2Fixed(44330000, 0);
+  uint64_t factor = exp2Fixed(-(base * FIXED(5.255, 24) >> 24));
+  return (float)((uint64_t)lroundf(pressure * 256) * factor >> 30) * (1.0f / 256);
+}
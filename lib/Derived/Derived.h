@@ -0,0 +1,56 @@
+/*****************************************************************************
+ * Derived quantities in fixed point
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * ESP8266 has no FPU, every float or double operation is a library call and
+ * exp(), log() and pow() cost thousands of cycles. Values derived from sensor
+ * readings are computed in 32 and 64 bit integers instead:
+ *
+ *   dewPoint()             ln(RH) by log2 table (Q24), Magnus exponent
+ *                          17.625 T / (243.04 + T) by integer division
+ *   absoluteHumidity()     Magnus exponent as above, exp by exp2 table
+ *   heatIndex()            NWS formulas (Adafruit DHT library) in Q36
+ *   altitude(),            powers as log2 and exp2 tables
+ *   seaLevelPressure()
+ *
+ * log2 and exp2 tables have 64 steps over one octave (Q30, flash) with
+ * quadratic interpolation. Formulas are the same as before (Magnus with
+ * Alduchov and Eskridge constants, Adafruit heat index and barometric
+ * formulas). Largest error against the double precision formula (tested by
+ * test/test_derived over these ranges):
+ *
+ *   dew point            0.005 C     temperature -60 to 80 C, humidity 1 to 100 %
+ *   absolute humidity    0.01 %      temperature -60 to 80 C, humidity 1 to 100 %
+ *   heat index           0.005 C     temperature -40 to 60 C, humidity 0 to 100 %
+ *   altitude             0.05 m      pressure 300 to 1100 hPa, sea level 950 to 1050 hPa
+ *   sea level pressure   1 Pa        pressure 300 to 1100 hPa, altitude -500 to 9000 m
+ *
+ * Dew point and absolute humidity outside -60 to 80 C (or humidity 0 or
+ * over 200 %) are computed by the float formula.
+ *****************************************************************************/
+#ifndef DERIVED_H_
+#define DERIVED_H_
+
+#include <stdint.h>
+
+// Error bounds of the table above (absolute humidity relative)
+#define DERIVED_ERROR_DEWPOINT 0.005        // C
+#define DERIVED_ERROR_ABSHUMIDITY 0.0001    // Relative
+#define DERIVED_ERROR_HEATINDEX 0.005       // C
+#define DERIVED_ERROR_ALTITUDE 0.05         // m
+#define DERIVED_ERROR_SEALEVEL 1.0          // Pa
+
+// Dew point (Celsius) from temperature (Celsius) and relative humidity (%)
+float dewPoint(float temperature, float humidity);
+// Heat index (Celsius) from temperature (Celsius) and relative humidity (%)
+float heatIndex(float temperature, float humidity);
+// Absolute humidity (g/m3) from temperature (Celsius) and relative humidity (%)
+float absoluteHumidity(float temperature, float humidity);
+// Altitude (m) from pressure and sea level pressure (Pa)
+float altitude(float pressure, float seaLevelPressure);
+// Sea level pressure (Pa) from pressure (Pa) at altitude (m)
+float seaLevelPressure(float pressure, float altitude);
+
+#endif
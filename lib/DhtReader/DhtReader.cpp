@@ -0,0 +1,125 @@
+/*****************************************************************************
+ * Non-blocking DHT11/DHT22 reader
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************/
+#include "DhtReader.h"
+
+void DhtReader::begin() {
+  pinMode(_pin, INPUT_PULLUP);
+  _count = 0;
+  _status = DHT_IDLE;
+  _started = false;
+  _failures = 0;
+}
+
+bool DhtReader::start() {
+  if (_status == DHT_BUSY)
+    return false;
+  if (_started && millis() - _startMillis < DHT_MIN_INTERVAL)
+    return false;
+  _started = true;
+  _startMillis = millis();
+  _count = 0;
+  _status = DHT_BUSY;
+  // Start pulse, the sensor answers after the line is released
+  pinMode(_pin, OUTPUT);
+  digitalWrite(_pin, LOW);
+  _timer.once_ms(startPulse(), release, this);
+  return true;
+}
+
+void DhtReader::release(DhtReader* reader) {
+  // Interrupt first, the sensor answers 20-40 us after release (rising edge is not caught)
+  attachInterruptArg(digitalPinToInterrupt(reader->_pin), edge, reader, FALLING);
+  pinMode(reader->_pin, INPUT_PULLUP);
+}
+
+void IRAM_ATTR DhtReader::edge(void* arg) {
+  DhtReader* reader = (DhtReader*)arg;
+  uint8_t count = reader->_count;
+  if (count < DHT_EDGES)
+    reader->_edges[count] = micros();
+  // Extra edge is counted once, frame with it is invalid
+  if (count <= DHT_EDGES)
+    reader->_count = count + 1;
+}
+
+DhtStatus DhtReader::poll() {
+  if (_status != DHT_BUSY)
+    return _status;
+  uint8_t count = _count;
+  if (count < DHT_EDGES && millis() - _startMillis < readTime())
+    return DHT_BUSY;
+  _timer.detach();
+  detachInterrupt(digitalPinToInterrupt(_pin));
+  count = _count;
+  if (count == 0) {
+    finish(DHT_NO_RESPONSE);
+    return _status;
+  }
+  if (count < DHT_EDGES) {
+    finish(DHT_TIMEOUT);
+    return _status;
+  }
+  uint8_t data[5];
+  // Interrupt is detached, edges do not change any more
+  DhtStatus status = count > DHT_EDGES ? DHT_BAD_TIMING : decode((const uint32_t*)_edges, count, data);
+  if (status == DHT_OK)
+    convert(_type, data, _temperature, _humidity);
+  finish(status);
+  return _status;
+}
+
+void DhtReader::finish(DhtStatus status) {
+  _status = status;
+  if (status != DHT_OK)
+    _failures++;
+  if (_callback)
+    _callback(*this, status);
+}
+
+DhtStatus DhtReader::decode(const uint32_t* edges, uint8_t count, uint8_t data[5]) {
+  if (count < DHT_EDGES)
+    return DHT_TIMEOUT;
+  uint32_t response = edges[1] - edges[0];
+  if (response < DHT_RESPONSE_MIN || response > DHT_RESPONSE_MAX)
+    return DHT_BAD_TIMING;
+  memset(data, 0, 5);
+  for (uint8_t bit = 0; bit < 40; bit++) {
+    uint32_t period = edges[bit + 2] - edges[bit + 1];
+    if (period < DHT_BIT_MIN || period > DHT_BIT_MAX)
+      return DHT_BAD_TIMING;
+    data[bit / 8] = data[bit / 8] << 1 | (period > DHT_BIT_THRESHOLD);
+  }
+  if ((uint8_t)(data[0] + data[1] + data[2] + data[3]) != data[4])
+    return DHT_CHECKSUM;
+  return DHT_OK;
+}
+
+void DhtReader::convert(uint8_t type, const uint8_t data[5], float& temperature, float& humidity) {
+  switch (type) {
+  case DHT_TYPE_11:
+  case DHT_TYPE_12:
+    // Integer and tenths, sign in tenths byte
+    temperature = data[2];
+    if (data[3] & 0x80)
+      temperature = -1 - temperature;
+    temperature += (data[3] & 0x0f) * 0.1f;
+    humidity = data[0] + data[1] * 0.1f;
+    break;
+  default:
+    // Tenths, 16 bit, sign bit
+    temperature = ((data[2] & 0x7f) << 8 | data[3]) * 0.1f;
+    if (data[2] & 0x80)
+      temperature = -temperature;
+    humidity = (data[0] << 8 | data[1]) * 0.1f;
+    break;
+  }
+}
+
+const char* DhtReader::statusName(DhtStatus status) {
+  static const char* const names[] = { "idle", "busy", "ok", "no response", "timeout", "bad timing", "checksum" };
+  return status <= DHT_CHECKSUM ? names[status] : "";
+}
@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * Non-blocking DHT11/DHT22 reader
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * The start pulse is ended by a timer and the sensor answer is taken by a
+ * falling edge interrupt, which only stores the edge time: constant cost,
+ * no loop, interrupts are never disabled. Bits are decoded outside the
+ * interrupt from intervals between falling edges (50 us low followed by
+ * 26-28 us high is 0, by 70 us high is 1) once the frame is complete.
+ *
+ *   reader.start();                // pulls line low, returns immediately
+ *   ... reader.readTime() later ...
+ *   if (reader.poll() == DHT_OK)   // temperature(), humidity()
+ *
+ * poll() returns DHT_BUSY while the frame is in progress, a callback set by
+ * onResult() is called from poll() when the result is known. Reads closer
+ * than DHT_MIN_INTERVAL keep the last result (sensor limit). The decoder
+ * is hardware independent (decode(), convert()), it is tested against
+ * edge traces (test/test_dht_reader).
+ *****************************************************************************/
+#ifndef DHT_READER_H_
+#define DHT_READER_H_
+
+#include <Arduino.h>
+#include <Ticker.h>
+
+#ifndef DHT_MIN_INTERVAL
+#define DHT_MIN_INTERVAL 2000               // Sensor minimum read interval (ms)
+#endif
+#ifndef DHT_FRAME_TIMEOUT
+#define DHT_FRAME_TIMEOUT 8                 // Frame after start pulse, 5.3 ms at most (ms)
+#endif
+#define DHT_EDGES 42                        // Falling edges of a frame, response + 40 bits + end
+#define DHT_RESPONSE_MIN 120                // Response low + high, 80 + 80 us nominal (us)
+#define DHT_RESPONSE_MAX 220
+#define DHT_BIT_MIN 60                      // Bit period, 50 us low + 26-28 us (0) or 70 us (1) high (us)
+#define DHT_BIT_MAX 160
+#define DHT_BIT_THRESHOLD 100               // Longer bit period is 1 (us)
+
+// Sensor types, values of Adafruit DHT library constants
+enum DhtType : uint8_t {
+  DHT_TYPE_11 = 11,
+  DHT_TYPE_12 = 12,
+  DHT_TYPE_21 = 21,
+  DHT_TYPE_22 = 22
+};
+
+// Type names of DHT_TYPE in config.h
+#define DHT11 DHT_TYPE_11
+#define DHT12 DHT_TYPE_12
+#define DHT21 DHT_TYPE_21                   // AM2301
+#define DHT22 DHT_TYPE_22                   // AM2302
+#define AM2301 DHT_TYPE_21
+
+enum DhtStatus : uint8_t {
+  DHT_IDLE,                                 // No read started
+  DHT_BUSY,                                 // Start pulse or frame in progress
+  DHT_OK,                                   // Values are valid
+  DHT_NO_RESPONSE,                          // No edge after start pulse
+  DHT_TIMEOUT,                              // Frame not complete in time
+  DHT_BAD_TIMING,                           // Edge interval out of protocol limits (glitch)
+  DHT_CHECKSUM                              // Checksum mismatch
+};
+
+class DhtReader {
+public:
+  typedef void (*Callback)(DhtReader& reader, DhtStatus status);
+
+  DhtReader(uint8_t pin, uint8_t type) : _pin(pin), _type(type) {}
+
+  // Release the line (idle high)
+  void begin();
+  // Start read, false when busy or the last read is younger than DHT_MIN_INTERVAL (last result is kept)
+  bool start();
+  // Result of the last read, decodes the frame once it is complete or timed out
+  DhtStatus poll();
+  // Called from poll() when a started read is finished (any status)
+  void onResult(Callback callback) { _callback = callback; }
+  // Start pulse and frame time, poll() after it does not return DHT_BUSY (ms)
+  uint32_t readTime() const { return startPulse() + DHT_FRAME_TIMEOUT; }
+
+  DhtStatus status() const { return _status; }
+  // Values of the last successful read, NAN before it
+  float temperature() const { return _temperature; }
+  float humidity() const { return _humidity; }
+  // Failed reads since begin
+  uint32_t failures() const { return _failures; }
+
+  // Frame bytes from falling edge times (us), edges[0] is the response
+  static DhtStatus decode(const uint32_t* edges, uint8_t count, uint8_t data[5]);
+  // Values from frame bytes of sensor type
+  static void convert(uint8_t type, const uint8_t data[5], float& temperature, float& humidity);
+  static const char* statusName(DhtStatus status);
+  // Falling edge interrupt handler, argument is the reader
+  static void IRAM_ATTR edge(void* reader);
+
+private:
+  // DHT11 needs at least 18 ms, others 1 ms (ms, timer resolution)
+  uint32_t startPulse() const { return _type == DHT_TYPE_11 ? 20 : 2; }
+  void finish(DhtStatus status);
+  // Timer callback, ends start pulse and waits for edges
+  static void release(DhtReader* reader);
+
+  uint8_t _pin;
+  uint8_t _type;
+  Ticker _timer;
+  volatile uint8_t _count = 0;              // Falling edges received (DHT_EDGES + 1 = extra edge)
+  volatile uint32_t _edges[DHT_EDGES];      // Falling edge times (micros)
+  DhtStatus _status = DHT_IDLE;
+  bool _started = false;                    // Any read started, _startMillis is valid
+  uint32_t _startMillis = 0;                // Start of the last read
+  float _temperature = NAN;
+  float _humidity = NAN;
+  uint32_t _failures = 0;
+  Callback _callback = nullptr;
+};
+
+#endif
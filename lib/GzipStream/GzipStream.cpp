@@ -0,0 +1,187 @@
+/*****************************************************************************
+ * Streaming gzip compressor
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************/
+#include "GzipStream.h"
+#include <Crc32.h>
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+
+// Deflate length codes 257..285 and distance codes 0..29
+static const uint16_t lengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distanceBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distanceExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static inline uint32_t hash(const uint8_t* p) {
+  return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+void GzipStream::begin(Print* output) {
+  _output = output;
+  _fill = _position = 0;
+  _offset = 0;
+  memset(_head, 0, sizeof(_head));
+  _outLength = 0;
+  _bits = _bitCount = 0;
+  _crc = 0;
+  _inputLength = _length = 0;
+  _error = false;
+
+  // Header: magic, deflate, no flags, no time, no extra flags, unknown OS
+  static const uint8_t header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+  for (uint8_t b : header)
+    putByte(b);
+  // Single final block with fixed Huffman codes (BFINAL = 1, BTYPE = 01)
+  putBits(1, 1);
+  putBits(1, 2);
+}
+
+bool GzipStream::write(const void* data, size_t length) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  _crc = crc32(bytes, length, _crc);
+  _inputLength += length;
+  while (length > 0) {
+    size_t chunk = sizeof(_buffer) - _fill;
+    if (chunk > length)
+      chunk = length;
+    memcpy(_buffer + _fill, bytes, chunk);
+    _fill += chunk;
+    bytes += chunk;
+    length -= chunk;
+    if (_fill == sizeof(_buffer))
+      compress(false);
+  }
+  return !_error;
+}
+
+size_t GzipStream::finish() {
+  compress(true);
+  putCode(0, 7);                            // End of block (256)
+  if (_bitCount > 0)
+    putBits(0, 8 - _bitCount);
+  for (int i = 0; i < 32; i += 8)
+    putByte(_crc >> i);
+  for (int i = 0; i < 32; i += 8)
+    putByte((uint32_t)_inputLength >> i);
+  flush();
+  return _error ? 0 : _length;
+}
+
+void GzipStream::compress(bool final) {
+  // Keep enough lookahead for the longest match unless it is the end of input
+  while (_position < _fill && (final || _fill - _position >= MAX_MATCH)) {
+    size_t available = _fill - _position;
+    size_t bestLength = 0;
+    size_t distance = 0;
+    if (available >= MIN_MATCH) {
+      uint32_t h = hash(_buffer + _position);
+      // Offsets are kept modulo 2^16, the buffer holds continuous stream, so a stale
+      // candidate only compares different bytes
+      distance = (uint16_t)(_offset + _position - _head[h]);
+      _head[h] = (uint16_t)(_offset + _position);
+      if (distance > 0 && distance <= GZIP_WINDOW_SIZE && distance <= _position) {
+        const uint8_t* current = _buffer + _position;
+        const uint8_t* candidate = current - distance;
+        size_t limit = available < MAX_MATCH ? available : MAX_MATCH;
+        while (bestLength < limit && candidate[bestLength] == current[bestLength])
+          bestLength++;
+      }
+    }
+    if (bestLength >= MIN_MATCH) {
+      match(bestLength, distance);
+      // Matched positions are candidates for the next matches too
+      for (size_t i = 1; i < bestLength && _position + i + MIN_MATCH <= _fill; i++)
+        _head[hash(_buffer + _position + i)] = (uint16_t)(_offset + _position + i);
+      _position += bestLength;
+    }
+    else {
+      literal(_buffer[_position++]);
+    }
+  }
+  if (final)
+    return;
+  // Slide, keep one window of history before the next position
+  size_t shift = _position > GZIP_WINDOW_SIZE ? _position - GZIP_WINDOW_SIZE : 0;
+  if (shift > 0) {
+    memmove(_buffer, _buffer + shift, _fill - shift);
+    _fill -= shift;
+    _position -= shift;
+    _offset += shift;
+  }
+}
+
+void GzipStream::literal(uint8_t value) {
+  if (value < 144)
+    putCode(0x30 + value, 8);
+  else
+    putCode(0x190 + value - 144, 9);
+}
+
+void GzipStream::match(size_t length, size_t distance) {
+  int code = 28;
+  while (lengthBase[code] > length)
+    code--;
+  // Length symbols 257..279 have 7 bit codes, 280..287 8 bit codes
+  uint16_t symbol = 257 + code;
+  if (symbol < 280)
+    putCode(symbol - 256, 7);
+  else
+    putCode(0xC0 + symbol - 280, 8);
+  putBits(length - lengthBase[code], lengthExtra[code]);
+
+  code = 29;
+  while (distanceBase[code] > distance)
+    code--;
+  putCode(code, 5);
+  putBits(distance - distanceBase[code], distanceExtra[code]);
+}
+
+// Extra bits and header fields, least significant bit first
+void GzipStream::putBits(uint32_t value, uint8_t bits) {
+  _bits |= value << _bitCount;
+  _bitCount += bits;
+  while (_bitCount >= 8) {
+    putByte(_bits);
+    _bits >>= 8;
+    _bitCount -= 8;
+  }
+}
+
+// Huffman codes, most significant bit first
+void GzipStream::putCode(uint32_t code, uint8_t bits) {
+  uint32_t reversed = 0;
+  for (uint8_t i = 0; i < bits; i++) {
+    reversed = reversed << 1 | (code & 1);
+    code >>= 1;
+  }
+  putBits(reversed, bits);
+}
+
+void GzipStream::putByte(uint8_t value) {
+  _out[_outLength++] = value;
+  _length++;
+  if (_outLength == sizeof(_out))
+    flush();
+}
+
+void GzipStream::flush() {
+  if (_outLength > 0 && _output->write(_out, _outLength) != _outLength)
+    _error = true;
+  _outLength = 0;
+}
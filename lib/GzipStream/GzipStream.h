@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Streaming gzip compressor
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Deflate (RFC 1951) with fixed Huffman codes in gzip container (RFC 1952).
+ * Input is written in any pieces, compressed data goes out through a small
+ * buffer to the given Print, so neither the whole input nor the whole output
+ * is kept in RAM. Matches are searched in a small window with one hash
+ * candidate per position - line protocol repeats measurement, tags and field
+ * names in every line, which is found even this way.
+ *
+ * RAM: GZIP_WINDOW_SIZE + GZIP_LOOKAHEAD_SIZE + 2 << GZIP_HASH_BITS
+ *      + GZIP_OUTPUT_SIZE bytes (2.7 kB by default)
+ *****************************************************************************/
+#ifndef GZIP_STREAM_H_
+#define GZIP_STREAM_H_
+
+#include <Arduino.h>
+
+#ifndef GZIP_WINDOW_SIZE
+#define GZIP_WINDOW_SIZE 1024               // Match distance limit (bytes, up to 32768)
+#endif
+#ifndef GZIP_LOOKAHEAD_SIZE
+#define GZIP_LOOKAHEAD_SIZE 512             // Input buffered before compression (bytes, at least 258)
+#endif
+#ifndef GZIP_HASH_BITS
+#define GZIP_HASH_BITS 9                    // Match candidates table size (2^bits entries)
+#endif
+#ifndef GZIP_OUTPUT_SIZE
+#define GZIP_OUTPUT_SIZE 128                // Compressed data buffer (bytes)
+#endif
+
+static_assert(GZIP_WINDOW_SIZE <= 32768, "GZIP_WINDOW_SIZE exceeds deflate window");
+static_assert(GZIP_LOOKAHEAD_SIZE >= 258, "GZIP_LOOKAHEAD_SIZE must hold the longest match");
+
+class GzipStream {
+public:
+  GzipStream() {}
+
+  // Start new gzip member written to output
+  void begin(Print* output);
+  // Compress data, returns false when output did not accept all data
+  bool write(const void* data, size_t length);
+  // Compress the rest and write trailer, returns compressed length (0 on output error)
+  size_t finish();
+
+  // Compressed bytes so far (all after finish)
+  size_t length() const { return _length; }
+  // Uncompressed bytes so far
+  size_t inputLength() const { return _inputLength; }
+
+private:
+  void compress(bool final);
+  void literal(uint8_t value);
+  void match(size_t length, size_t distance);
+  void putBits(uint32_t value, uint8_t bits);
+  void putCode(uint32_t code, uint8_t bits);
+  void putByte(uint8_t value);
+  void flush();
+
+  Print* _output = nullptr;
+  uint8_t _buffer[GZIP_WINDOW_SIZE + GZIP_LOOKAHEAD_SIZE]; // Window followed by lookahead
+  size_t _fill = 0;                         // Used buffer bytes
+  size_t _position = 0;                     // Next byte to compress
+  uint32_t _offset = 0;                     // Stream offset of _buffer[0]
+  uint16_t _head[1 << GZIP_HASH_BITS];      // Last stream offset (low 16 bits) of every hash
+  uint8_t _out[GZIP_OUTPUT_SIZE];
+  size_t _outLength = 0;
+  uint32_t _bits = 0;                       // Bits not written yet, LSB first
+  uint8_t _bitCount = 0;
+  uint32_t _crc = 0;
+  size_t _inputLength = 0;
+  size_t _length = 0;
+  bool _error = false;
+};
+
+#endif
@@ -0,0 +1,402 @@
+/*****************************************************************************
+ * InfluxDB v2 write client with persistent connection
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************/
+#include "InfluxWriter.h"
+#include <GzipStream.h>
+
+// Append URL encoded value, returns new length or size when it does not fit
+static size_t appendEncoded(char* out, size_t size, size_t length, const char* value) {
+  static const char hex[] = "0123456789ABCDEF";
+  for (const char* p = value; *p && length < size; p++) {
+    char c = *p;
+    if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      out[length++] = c;
+    }
+    else if (length + 3 < size) {
+      out[length++] = '%';
+      out[length++] = hex[(uint8_t)c >> 4];
+      out[length++] = hex[c & 0x0F];
+    }
+    else {
+      return size;
+    }
+  }
+  if (length < size)
+    out[length] = 0;
+  return length;
+}
+
+// Writes every piece as one HTTP/1.1 chunk, compressed length is not known before the body is sent
+class ChunkedPrint : public Print {
+public:
+  explicit ChunkedPrint(WiFiClient* client) : _client(client) {}
+
+  size_t write(uint8_t value) override { return write(&value, 1); }
+  size_t write(const uint8_t* data, size_t size) override {
+    // Size line, data and CRLF in one client write, not three small segments
+    uint8_t chunk[GZIP_OUTPUT_SIZE + 8];
+    size_t done = 0;
+    while (done < size) {
+      size_t n = size - done < GZIP_OUTPUT_SIZE ? size - done : GZIP_OUTPUT_SIZE;
+      size_t length = snprintf((char*)chunk, sizeof(chunk), "%x\r\n", (unsigned)n);
+      memcpy(chunk + length, data + done, n);
+      length += n;
+      chunk[length++] = '\r';
+      chunk[length++] = '\n';
+      if (_client->write(chunk, length) != length)
+        break;
+      done += n;
+    }
+    return done;
+  }
+  // Last chunk, no trailer
+  bool end() { return _client->write((const uint8_t*)"0\r\n\r\n", 5) == 5; }
+
+private:
+  WiFiClient* _client;
+};
+
+InfluxWriter::InfluxWriter() : _stats() {
+  _host[0] = _path[0] = _error[0] = 0;
+}
+
+bool InfluxWriter::begin(const char* url, const char* org, const char* bucket, const char* token, const char* precision) {
+  stop();
+  _client = nullptr;
+  _datagram = false;
+  _address = IPAddress();
+  _url = url;
+  _token = token;
+  bool secure = false;
+  if (strncmp(url, "https://", 8) == 0) {
+    secure = true;
+    url += 8;
+  }
+  else if (strncmp(url, "http://", 7) == 0) {
+    url += 7;
+  }
+  else if (strncmp(url, "udp://", 6) == 0) {
+    _datagram = true;
+    url += 6;
+  }
+  else {
+    setError(INFLUX_ERROR_INVALID_URL);
+    return false;
+  }
+  // host[:port][/path]
+  size_t hostLength = strcspn(url, ":/");
+  if (hostLength == 0 || hostLength >= sizeof(_host)) {
+    setError(INFLUX_ERROR_INVALID_URL);
+    return false;
+  }
+  memcpy(_host, url, hostLength);
+  _host[hostLength] = 0;
+  url += hostLength;
+  _port = _datagram ? INFLUX_WRITER_UDP_PORT : secure ? 443 : 80;
+  if (*url == ':') {
+    _port = (uint16_t)strtoul(url + 1, (char**)&url, 10);
+  }
+  if (_datagram) {
+    // Listener writes to its configured database, path is not used
+    _path[0] = _error[0] = 0;
+    return true;
+  }
+  // Base path without trailing slash
+  size_t pathLength = strlen(url);
+  while (pathLength > 0 && url[pathLength - 1] == '/')
+    pathLength--;
+  int length = snprintf(_path, sizeof(_path), "%.*s/api/v2/write?org=", (int)pathLength, url);
+  size_t used = length < (int)sizeof(_path) ? length : sizeof(_path);
+  used = appendEncoded(_path, sizeof(_path), used, org);
+  if (used < sizeof(_path))
+    used += snprintf(_path + used, sizeof(_path) - used, "&bucket=");
+  used = appendEncoded(_path, sizeof(_path), used, bucket);
+  if (used < sizeof(_path))
+    used += snprintf(_path + used, sizeof(_path) - used, "&precision=%s", precision);
+  if (used >= sizeof(_path)) {
+    setError(INFLUX_ERROR_INVALID_URL);
+    return false;
+  }
+
+  if (secure) {
+    // Ignore invalid certificates, we are not able to validate chain correctly anyway
+    _tls.setInsecure();
+    // Session parameters are stored after handshake and offered by the next connect
+    _tls.setSession(&_session);
+    _client = &_tls;
+  }
+  else {
+    _client = &_tcp;
+  }
+  _error[0] = 0;
+  return true;
+}
+
+bool InfluxWriter::connect() {
+  if (_datagram)
+    return resolve();
+  if (!_client) {
+    setError(INFLUX_ERROR_INVALID_URL);
+    return false;
+  }
+  return connected() || open();
+}
+
+bool InfluxWriter::connected() {
+  if (_datagram)
+    return _address.isSet();
+  return _client && _client->connected();
+}
+
+void InfluxWriter::stop() {
+  if (_client)
+    _client->stop();
+  _keepAlive = false;
+}
+
+bool InfluxWriter::open() {
+  stop();
+  uint32_t start = millis();
+  _client->setTimeout(_timeout);
+  if (!_client->connect(_host, _port)) {
+    setError(INFLUX_ERROR_CONNECTION_REFUSED);
+    return false;
+  }
+  _client->setNoDelay(true);
+  _keepAlive = true;
+  _stats.connects++;
+  _stats.connectMillis = millis() - start;
+  if (_stats.connectMillis > _stats.connectMaxMillis)
+    _stats.connectMaxMillis = _stats.connectMillis;
+  return true;
+}
+
+// Host name is resolved once, the address is used by all datagrams
+bool InfluxWriter::resolve() {
+  if (!_address.isSet() && !WiFi.hostByName(_host, _address)) {
+    _address = IPAddress();
+    setError(INFLUX_ERROR_CONNECTION_REFUSED);
+    return false;
+  }
+  return true;
+}
+
+bool InfluxWriter::write(const char* body, size_t length) {
+  if (!_client && !_datagram) {
+    setError(INFLUX_ERROR_INVALID_URL);
+    _stats.failures++;
+    return false;
+  }
+  uint32_t start = millis();
+  _stats.writes++;
+  _error[0] = 0;
+  int status;
+  if (_datagram) {
+    status = resolve() ? send(body, length) : INFLUX_ERROR_CONNECTION_REFUSED;
+  }
+  else {
+    bool reused = _reuse && _keepAlive && connected();
+    if (!reused && !open()) {
+      status = INFLUX_ERROR_CONNECTION_REFUSED;
+    }
+    else {
+      status = request(body, length);
+      // Kept-alive connection may be closed by server meanwhile, try once with new one. Only when no
+      // response arrived, the server may have written the points before it closed the connection.
+      if (reused && (status == INFLUX_ERROR_SEND_FAILED || (status == INFLUX_ERROR_CONNECTION_LOST && !_answered))) {
+        reused = false;
+        status = open() ? request(body, length) : INFLUX_ERROR_CONNECTION_REFUSED;
+      }
+    }
+    if (reused)
+      _stats.reused++;
+    if (!_reuse || !_keepAlive || status < 0)
+      stop();
+  }
+
+  _status = status;
+  _stats.writeMillis = millis() - start;
+  _stats.writeTotalMillis += _stats.writeMillis;
+  if (_stats.writeMillis > _stats.writeMaxMillis)
+    _stats.writeMaxMillis = _stats.writeMillis;
+  if (status >= 200 && status < 300)
+    return true;
+  if (!_error[0])
+    setError(status);
+  _stats.failures++;
+  return false;
+}
+
+int InfluxWriter::request(const char* body, size_t length) {
+  // Compressed body is streamed chunked, so it is compressed only once
+  bool compress = _gzip && length >= _gzipThreshold;
+  char framing[64];
+  if (compress)
+    strcpy(framing, "Content-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n");
+  else
+    snprintf(framing, sizeof(framing), "Content-Length: %u\r\n", (unsigned)length);
+  char head[INFLUX_WRITER_PATH_SIZE + 320];
+  int headLength = snprintf(head, sizeof(head),
+    "POST %s HTTP/1.1\r\n"
+    "Host: %s\r\n"
+    "Authorization: Token %s\r\n"
+    "User-Agent: ESP-FLUX-TEMP\r\n"
+    "Content-Type: text/plain; charset=utf-8\r\n"
+    "%s"
+    "Connection: %s\r\n"
+    "\r\n",
+    _path, _host, _token, framing, _reuse ? "keep-alive" : "close");
+  if (headLength <= 0 || headLength >= (int)sizeof(head))
+    return INFLUX_ERROR_SEND_FAILED;
+  if (_client->write((const uint8_t*)head, headLength) != (size_t)headLength)
+    return INFLUX_ERROR_SEND_FAILED;
+  if (compress) {
+    ChunkedPrint chunked(_client);
+    _gzip->begin(&chunked);
+    if (!_gzip->write(body, length) || _gzip->finish() == 0 || !chunked.end())
+      return INFLUX_ERROR_SEND_FAILED;
+    _stats.compressed++;
+  }
+  else if (_client->write((const uint8_t*)body, length) != length) {
+    return INFLUX_ERROR_SEND_FAILED;
+  }
+  _stats.bodyBytes += length;
+  _stats.sentBytes += compress ? _gzip->length() : length;
+  return response();
+}
+
+// Packs whole lines into datagrams, a line longer than datagram is sent alone (fragmented by IP).
+// Datagrams sent before a failure are sent again by the retry, the server overwrites equal points.
+int InfluxWriter::send(const char* body, size_t length) {
+  size_t start = 0;
+  while (start < length) {
+    size_t end = start;
+    do {
+      const char* newline = (const char*)memchr(body + end, '\n', length - end);
+      size_t next = newline ? newline - body + 1 : length;
+      if (end > start && next - start > INFLUX_WRITER_DATAGRAM_SIZE)
+        break;
+      end = next;
+    } while (end < length && end - start < INFLUX_WRITER_DATAGRAM_SIZE);
+    size_t size = end - start;
+    if (!_udp.beginPacket(_address, _port) || _udp.write((const uint8_t*)body + start, size) != size || !_udp.endPacket())
+      return INFLUX_ERROR_SEND_FAILED;
+    _stats.datagrams++;
+    _stats.sentBytes += size;
+    start = end;
+  }
+  _stats.bodyBytes += length;
+  // No response, handed to network stack is reported as 204 No Content
+  return 204;
+}
+
+int InfluxWriter::response() {
+  char line[96];
+  _retryAfter = 0;
+  _answered = false;
+  int length = readLine(line, sizeof(line));
+  if (length < 0)
+    return _client->connected() ? INFLUX_ERROR_READ_TIMEOUT : INFLUX_ERROR_CONNECTION_LOST;
+  _answered = true;
+  // HTTP/1.1 204 No Content
+  if (strncmp(line, "HTTP/1.", 7) != 0 || length < 12)
+    return INFLUX_ERROR_CONNECTION_LOST;
+  int status = atoi(line + 9);
+  _keepAlive = _reuse && line[7] != '0';
+
+  // Headers
+  long contentLength = -1;
+  while ((length = readLine(line, sizeof(line))) > 0) {
+    char* value = strchr(line, ':');
+    if (!value)
+      continue;
+    *value++ = 0;
+    while (*value == ' ')
+      value++;
+    if (strcasecmp(line, "Content-Length") == 0)
+      contentLength = atol(value);
+    else if (strcasecmp(line, "Connection") == 0 && strcasecmp(value, "close") == 0)
+      _keepAlive = false;
+    else if (strcasecmp(line, "Retry-After") == 0)
+      _retryAfter = atol(value);
+  }
+  if (length < 0)
+    return INFLUX_ERROR_CONNECTION_LOST;
+
+  // Body, error message is kept, the rest is skipped
+  if (contentLength < 0) {
+    // Unknown length (chunked or until close), connection cannot be reused
+    if (status != 204 && status != 304)
+      _keepAlive = false;
+    return status;
+  }
+  size_t used = 0;
+  char skip[32];
+  while (contentLength > 0) {
+    bool keep = used < sizeof(line) - 1;
+    char* target = keep ? line + used : skip;
+    long space = keep ? sizeof(line) - 1 - used : sizeof(skip);
+    size_t n = _client->readBytes(target, space < contentLength ? space : contentLength);
+    if (n == 0) {
+      _keepAlive = false;
+      break;
+    }
+    if (keep)
+      used += n;
+    contentLength -= n;
+  }
+  line[used] = 0;
+  if ((status < 200 || status >= 300) && used > 0) {
+    // {"code":"invalid","message":"..."}
+    const char* message = strstr(line, "\"message\":\"");
+    if (message) {
+      message += 11;
+      snprintf(_error, sizeof(_error), "HTTP %d: %.*s", status, (int)strcspn(message, "\""), message);
+    }
+  }
+  return status;
+}
+
+// Reads header line without CRLF, returns its length or -1 on timeout or close.
+// Longer line is truncated, 0 is returned only for the empty line ending the headers.
+int InfluxWriter::readLine(char* line, size_t size) {
+  size_t length = _client->readBytesUntil('\n', line, size - 1);
+  if (length == 0)
+    return -1;
+  if (length == size - 1) {
+    // LF was not reached, the rest of the line is skipped, not read as the next line
+    char skip[32];
+    while (_client->readBytesUntil('\n', skip, sizeof(skip)) == sizeof(skip))
+      ;
+  }
+  if (line[length - 1] == '\r')
+    length--;
+  line[length] = 0;
+  return length;
+}
+
+void InfluxWriter::setError(int status) {
+  switch (status) {
+  case INFLUX_ERROR_CONNECTION_REFUSED:
+    strcpy(_error, "connection refused");
+    break;
+  case INFLUX_ERROR_SEND_FAILED:
+    strcpy(_error, "send failed");
+    break;
+  case INFLUX_ERROR_CONNECTION_LOST:
+    strcpy(_error, "connection lost");
+    break;
+  case INFLUX_ERROR_INVALID_URL:
+    strcpy(_error, "invalid URL");
+    break;
+  case INFLUX_ERROR_READ_TIMEOUT:
+    strcpy(_error, "read timeout");
+    break;
+  default:
+    snprintf(_error, sizeof(_error), "HTTP status %d", status);
+    break;
+  }
+}
@@ -0,0 +1,129 @@
+/*****************************************************************************
+ * InfluxDB v2 write client with persistent connection
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Sends line protocol bodies to /api/v2/write over HTTP/1.1 keep-alive.
+ * The connection (TCP and TLS) is opened once and reused by the next writes,
+ * it is opened again only after the server or network closed it. TLS session
+ * is cached, so a new connection resumes the session instead of doing a full
+ * handshake. Server certificate is not validated. Bodies from the set size
+ * up are sent gzip compressed with chunked transfer encoding, compressed while
+ * sending in a single pass.
+ *
+ * URL udp://host:port selects fire-and-forget datagrams instead (InfluxDB 1.x
+ * UDP listener or Telegraf socket_listener): whole lines are packed into
+ * datagrams of up to INFLUX_WRITER_DATAGRAM_SIZE bytes, there is no connection,
+ * no header and no response. Org, bucket and token are not used, timestamp
+ * precision is set on the listener. A write is accepted when all datagrams
+ * were handed to the network stack, delivery is not confirmed.
+ *****************************************************************************/
+#ifndef INFLUX_WRITER_H_
+#define INFLUX_WRITER_H_
+
+#include <ESP8266WiFi.h>
+#include <WiFiClientSecureBearSSL.h>
+#include <WiFiUdp.h>
+
+#ifndef INFLUX_WRITER_TIMEOUT
+#define INFLUX_WRITER_TIMEOUT 5000          // Connect and response timeout (ms)
+#endif
+#ifndef INFLUX_WRITER_PATH_SIZE
+#define INFLUX_WRITER_PATH_SIZE 192         // Request target with org, bucket and precision
+#endif
+#ifndef INFLUX_WRITER_DATAGRAM_SIZE
+#define INFLUX_WRITER_DATAGRAM_SIZE 1472    // UDP payload in one frame (MTU 1500 - IP and UDP headers)
+#endif
+#ifndef INFLUX_WRITER_UDP_PORT
+#define INFLUX_WRITER_UDP_PORT 8089         // Default port of udp:// URL (InfluxDB 1.x UDP listener)
+#endif
+
+// Transport errors (same values as ESP8266HTTPClient), HTTP status otherwise
+#define INFLUX_ERROR_CONNECTION_REFUSED (-1)
+#define INFLUX_ERROR_SEND_FAILED (-3)
+#define INFLUX_ERROR_CONNECTION_LOST (-5)
+#define INFLUX_ERROR_INVALID_URL (-6)
+#define INFLUX_ERROR_READ_TIMEOUT (-11)
+
+class GzipStream;
+
+struct InfluxWriterStats {
+  uint32_t writes;                          // Write requests
+  uint32_t failures;                        // Failed writes, transport or HTTP error
+  uint32_t connects;                        // Opened connections (TCP and TLS handshake)
+  uint32_t reused;                          // Writes over already open connection
+  uint32_t connectMillis;                   // Last connection handshake time
+  uint32_t connectMaxMillis;                // Longest connection handshake
+  uint32_t writeMillis;                     // Last write time including handshake
+  uint32_t writeMaxMillis;                  // Longest write
+  uint64_t writeTotalMillis;                // Sum of write times
+  uint32_t compressed;                      // Writes sent gzip compressed
+  uint64_t bodyBytes;                       // Line protocol bytes written
+  uint64_t sentBytes;                       // Body bytes sent (after compression)
+  uint32_t datagrams;                       // UDP datagrams sent
+};
+
+class InfluxWriter {
+public:
+  InfluxWriter();
+
+  // Server URL http(s)://host[:port][/path] or udp://host[:port], timestamp precision "s", "ms", "us" or "ns"
+  bool begin(const char* url, const char* org, const char* bucket, const char* token, const char* precision = "s");
+  // Keep connection open between writes (default true)
+  void setReuse(bool reuse) { _reuse = reuse; }
+  void setTimeout(uint32_t timeout) { _timeout = timeout; }
+  // Compress bodies of at least threshold bytes with gzip, nullptr = never
+  void setCompression(GzipStream* gzip, size_t threshold) { _gzip = gzip; _gzipThreshold = threshold; }
+
+  // Open connection now, the next write uses it
+  bool connect();
+  bool connected();
+  void stop();
+
+  // Send line protocol, returns true when accepted by server (2xx, 204 for sent datagrams)
+  bool write(const char* body, size_t length);
+
+  // Last HTTP status or INFLUX_ERROR_* code
+  int lastStatus() const { return _status; }
+  // Retry-After of the last response (s), 0 when not sent
+  uint32_t retryAfter() const { return _retryAfter; }
+  const char* lastError() const { return _error; }
+  const char* serverUrl() const { return _url; }
+  bool datagrams() const { return _datagram; }
+  const InfluxWriterStats& stats() const { return _stats; }
+
+private:
+  bool open();
+  bool resolve();
+  int request(const char* body, size_t length);
+  int response();
+  int send(const char* body, size_t length);
+  int readLine(char* line, size_t size);
+  void setError(int status);
+
+  BearSSL::WiFiClientSecure _tls;
+  BearSSL::Session _session;                // TLS session kept for resumption
+  WiFiClient _tcp;
+  WiFiClient* _client = nullptr;            // _tls or _tcp by URL scheme
+  WiFiUDP _udp;
+  bool _datagram = false;                   // udp:// URL, _client is not used
+  IPAddress _address;                       // Resolved udp:// host
+  const char* _url = "";
+  const char* _token = "";
+  char _host[64];
+  uint16_t _port = 0;
+  char _path[INFLUX_WRITER_PATH_SIZE];
+  bool _reuse = true;
+  bool _keepAlive = false;                  // Server keeps the connection open
+  bool _answered = false;                   // Response of the last request started to arrive
+  uint32_t _timeout = INFLUX_WRITER_TIMEOUT;
+  GzipStream* _gzip = nullptr;
+  size_t _gzipThreshold = 0;
+  int _status = 0;
+  uint32_t _retryAfter = 0;
+  char _error[64];
+  InfluxWriterStats _stats;
+};
+
+#endif
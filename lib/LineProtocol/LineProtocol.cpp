@@ -0,0 +1,220 @@
+/*****************************************************************************
+ * InfluxDB line protocol encoder
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************/
+#include "LineProtocol.h"
+#include <string.h>
+#include <math.h>
+
+// Characters escaped by backslash
+#define ESCAPE_MEASUREMENT ", "
+#define ESCAPE_KEY ",= "
+
+LineProtocol::LineProtocol(char* buffer, size_t size) : _buffer(buffer), _size(size) {
+  _prefix[0] = 0;
+  clear();
+}
+
+bool LineProtocol::setMeasurement(const char* measurement) {
+  _prefixLength = escape(_prefix, sizeof(_prefix), measurement, ESCAPE_MEASUREMENT);
+  return _prefixLength > 0;
+}
+
+bool LineProtocol::addTag(const char* key, const char* value) {
+  // Empty tag values are not allowed by line protocol
+  if (!value || !*value)
+    return true;
+  size_t length = _prefixLength;
+  if (length + 1 >= sizeof(_prefix))
+    return false;
+  _prefix[length++] = ',';
+  size_t n = escape(_prefix + length, sizeof(_prefix) - length, key, ESCAPE_KEY);
+  if (n == 0 || length + n + 1 >= sizeof(_prefix))
+    return false;
+  length += n;
+  _prefix[length++] = '=';
+  n = escape(_prefix + length, sizeof(_prefix) - length, value, ESCAPE_KEY);
+  if (n == 0) {
+    _prefix[_prefixLength] = 0;
+    return false;
+  }
+  _prefixLength = length + n;
+  return true;
+}
+
+void LineProtocol::clear() {
+  _length = _lineStart = _lines = 0;
+  if (_size > 0)
+    _buffer[0] = 0;
+}
+
+bool LineProtocol::beginLine() {
+  _lineStart = _length;
+  _firstField = true;
+  _overflow = false;
+  if (_lines > 0)
+    appendChar('\n');
+  append(_prefix, _prefixLength);
+  appendChar(' ');
+  return !_overflow;
+}
+
+bool LineProtocol::addField(const char* name, float value, uint8_t decimals) {
+  if (isnan(value) || isinf(value))
+    return false;
+  char number[32];
+  size_t n = formatFloat(number, sizeof(number), value, decimals);
+  if (n == 0)
+    return false;
+  fieldName(name);
+  append(number, n);
+  return !_overflow;
+}
+
+bool LineProtocol::addField(const char* name, int32_t value) {
+  return fieldInteger(name, value < 0 ? -(int64_t)value : value, value < 0);
+}
+
+bool LineProtocol::addField(const char* name, uint32_t value) {
+  return fieldInteger(name, value, false);
+}
+
+bool LineProtocol::addField(const char* name, uint64_t value) {
+  return fieldInteger(name, value, false);
+}
+
+bool LineProtocol::endLine(uint64_t timestamp) {
+  if (!_overflow && timestamp > 0) {
+    char number[24];
+    appendChar(' ');
+    append(number, formatUnsigned(number, sizeof(number), timestamp));
+  }
+  if (_overflow || _firstField) {
+    // Roll back incomplete line
+    _length = _lineStart;
+    _buffer[_length] = 0;
+    return false;
+  }
+  _lines++;
+  return true;
+}
+
+bool LineProtocol::append(const char* value, size_t length) {
+  if (_overflow || _length + length >= _size) {
+    _overflow = true;
+    return false;
+  }
+  memcpy(_buffer + _length, value, length);
+  _length += length;
+  _buffer[_length] = 0;
+  return true;
+}
+
+bool LineProtocol::appendChar(char c) {
+  return append(&c, 1);
+}
+
+bool LineProtocol::fieldName(const char* name) {
+  if (!_firstField)
+    appendChar(',');
+  _firstField = false;
+  if (_overflow)
+    return false;
+  size_t n = escape(_buffer + _length, _size - _length, name, ESCAPE_KEY);
+  if (n == 0) {
+    _overflow = true;
+    return false;
+  }
+  _length += n;
+  return appendChar('=');
+}
+
+bool LineProtocol::fieldInteger(const char* name, uint64_t magnitude, bool negative) {
+  char number[24];
+  size_t n = 0;
+  if (negative)
+    number[n++] = '-';
+  n += formatUnsigned(number + n, sizeof(number) - n - 1, magnitude);
+  number[n++] = 'i';
+  fieldName(name);
+  append(number, n);
+  return !_overflow;
+}
+
+size_t LineProtocol::escape(char* out, size_t size, const char* value, const char* special) {
+  size_t n = 0;
+  for (const char* c = value; *c; c++) {
+    bool escaped = strchr(special, *c) != nullptr;
+    if (n + escaped + 1 >= size)
+      return 0;
+    if (escaped)
+      out[n++] = '\\';
+    out[n++] = *c;
+  }
+  if (n < size)
+    out[n] = 0;
+  return n;
+}
+
+size_t LineProtocol::formatUnsigned(char* out, size_t size, uint64_t value) {
+  char digits[20];
+  size_t n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  if (n >= size)
+    return 0;
+  for (size_t i = 0; i < n; i++)
+    out[i] = digits[n - 1 - i];
+  out[n] = 0;
+  return n;
+}
+
+size_t LineProtocol::formatInteger(char* out, size_t size, int64_t value) {
+  if (value >= 0)
+    return formatUnsigned(out, size, value);
+  if (size < 2)
+    return 0;
+  out[0] = '-';
+  size_t n = formatUnsigned(out + 1, size - 1, -(uint64_t)value);
+  return n ? n + 1 : 0;
+}
+
+size_t LineProtocol::formatFloat(char* out, size_t size, float value, uint8_t decimals) {
+  static const uint32_t scales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+  if (decimals > 6)
+    decimals = 6;
+  bool negative = value < 0;
+  // Scaled value must fit into 64 bit integer
+  double scaled = fabs((double)value) * scales[decimals] + 0.5;
+  if (isnan(scaled) || scaled >= 1e18)
+    return 0;
+  uint64_t fixed = (uint64_t)scaled;
+  uint64_t integer = fixed / scales[decimals];
+  uint32_t fraction = fixed % scales[decimals];
+  size_t n = 0;
+  if (negative && fixed > 0) {
+    if (size < 2)
+      return 0;
+    out[n++] = '-';
+  }
+  size_t m = formatUnsigned(out + n, size - n, integer);
+  if (m == 0)
+    return 0;
+  n += m;
+  if (decimals > 0) {
+    if (n + decimals + 1 >= size)
+      return 0;
+    out[n++] = '.';
+    for (uint8_t i = decimals; i > 0; i--) {
+      out[n + i - 1] = '0' + fraction % 10;
+      fraction /= 10;
+    }
+    n += decimals;
+  }
+  out[n] = 0;
+  return n;
+}
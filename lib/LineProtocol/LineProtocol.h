@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * InfluxDB line protocol encoder
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Writes lines straight into caller provided buffer, nothing is allocated.
+ * Measurement and tag set are escaped once and cached as line prefix, only
+ * fields and timestamp are encoded for every line.
+ *****************************************************************************/
+#ifndef LINE_PROTOCOL_H_
+#define LINE_PROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef LINE_PROTOCOL_PREFIX_SIZE
+#define LINE_PROTOCOL_PREFIX_SIZE 192       // Escaped measurement and tag set buffer
+#endif
+
+class LineProtocol {
+public:
+  LineProtocol(char* buffer, size_t size);
+
+  // Line prefix, call setMeasurement() first and then addTag() for every tag
+  bool setMeasurement(const char* measurement);
+  bool addTag(const char* key, const char* value);
+  const char* prefix() const { return _prefix; }
+  size_t prefixLength() const { return _prefixLength; }
+
+  // Remove all lines from buffer
+  void clear();
+  // Start new line with cached prefix
+  bool beginLine();
+  // Float field with fixed number of decimals, NaN and infinity are skipped
+  bool addField(const char* name, float value, uint8_t decimals = 2);
+  // Integer fields
+  bool addField(const char* name, int32_t value);
+  bool addField(const char* name, uint32_t value);
+  bool addField(const char* name, uint64_t value);
+  // Finish line, timestamp 0 = server time. Line without fields or which does not fit is removed.
+  bool endLine(uint64_t timestamp = 0);
+
+  const char* c_str() const { return _buffer; }
+  size_t length() const { return _length; }
+  size_t lines() const { return _lines; }
+
+  // Formatting helpers, return written length (0 when value does not fit)
+  static size_t escape(char* out, size_t size, const char* value, const char* special);
+  static size_t formatUnsigned(char* out, size_t size, uint64_t value);
+  static size_t formatInteger(char* out, size_t size, int64_t value);
+  static size_t formatFloat(char* out, size_t size, float value, uint8_t decimals);
+
+private:
+  bool append(const char* value, size_t length);
+  bool appendChar(char c);
+  bool fieldName(const char* name);
+  bool fieldInteger(const char* name, uint64_t magnitude, bool negative);
+
+  char* _buffer;                            // Output buffer
+  size_t _size;                             // Output buffer size
+  size_t _length = 0;                       // Used length
+  size_t _lineStart = 0;                    // Start of current line
+  size_t _lines = 0;                        // Finished lines
+  bool _firstField = true;                  // No field in current line yet
+  bool _overflow = false;                   // Current line does not fit
+  char _prefix[LINE_PROTOCOL_PREFIX_SIZE];  // Escaped measurement and tags
+  size_t _prefixLength = 0;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*****************************************************************************
+ * Connectivity state machine with backoff and circuit breaker
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************/
+#include "Link.h"
+
+void Link::begin(uint32_t seed) {
+  _random = seed ? seed : 1;
+  _state = _resume = LINK_HEALTHY;
+  _since = _clock();
+  _next = 0;
+  _failures = 0;
+}
+
+void Link::wifi(bool connected) {
+  if (!connected && _state != LINK_WIFI_DOWN) {
+    _resume = _state;
+    enter(LINK_WIFI_DOWN);
+  }
+  else if (connected && _state == LINK_WIFI_DOWN) {
+    // Backoff continues, WiFi outage is not a server failure
+    enter(_resume);
+  }
+}
+
+bool Link::ready() const {
+  return _state != LINK_WIFI_DOWN && _clock() >= _next;
+}
+
+uint32_t Link::wait() const {
+  if (_state == LINK_WIFI_DOWN)
+    return UINT32_MAX;
+  uint64_t now = _clock();
+  if (now >= _next)
+    return 0;
+  return _next - now > UINT32_MAX ? UINT32_MAX : (uint32_t)(_next - now);
+}
+
+void Link::success() {
+  _failures = 0;
+  _next = 0;
+  if (_state != LINK_HEALTHY)
+    enter(LINK_HEALTHY);
+}
+
+void Link::failure(bool throttled, uint32_t retryAfter) {
+  uint64_t now = _clock();
+  _failures++;
+  _stats.failures++;
+  if (retryAfter > _stats.retryAfterMax)
+    _stats.retryAfterMax = retryAfter;
+
+  // Failed probe of open circuit opens it again
+  bool open = _failures >= LINK_FAILURES;
+  uint64_t delay;
+  if (open) {
+    // Spread by up to a quarter, devices opened together do not probe together
+    delay = LINK_OPEN_TIME + random(LINK_OPEN_TIME / 4);
+    _stats.opens++;
+  }
+  else {
+    uint32_t shift = _failures - 1 < 31 ? _failures - 1 : 31;
+    uint64_t backoff = (uint64_t)LINK_BACKOFF_BASE << shift;
+    if (backoff > LINK_BACKOFF_MAX)
+      backoff = LINK_BACKOFF_MAX;
+    delay = random((uint32_t)backoff + 1);
+  }
+  // Server knows best, never before Retry-After and spread after it as well
+  if (retryAfter > 0) {
+    uint64_t server = (uint64_t)retryAfter * 1000;
+    if (delay < server)
+      delay = server + random((uint32_t)(server / 4 < UINT32_MAX ? server / 4 : UINT32_MAX));
+  }
+  _next = now + delay;
+
+  LinkState state = open ? LINK_OPEN : throttled ? LINK_THROTTLED : LINK_UNREACHABLE;
+  if (state != _state)
+    enter(state);
+}
+
+uint64_t Link::stateMillis(LinkState state) const {
+  uint64_t total = _stats.stateMillis[state];
+  if (state == _state)
+    total += _clock() - _since;
+  return total;
+}
+
+const char* Link::stateName(LinkState state) {
+  static const char* const names[LINK_STATE_COUNT] = { "healthy", "wifi_down", "unreachable", "throttled", "open" };
+  return state < LINK_STATE_COUNT ? names[state] : "";
+}
+
+void Link::enter(LinkState state) {
+  uint64_t now = _clock();
+  _stats.stateMillis[_state] += now - _since;
+  _since = now;
+  _state = state;
+}
+
+uint32_t Link::random(uint32_t range) {
+  if (range == 0)
+    return 0;
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return _random % range;
+}
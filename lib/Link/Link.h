@@ -0,0 +1,92 @@
+/*****************************************************************************
+ * Connectivity state machine with backoff and circuit breaker
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Decides when the next server write may be attempted. A failed write
+ * delays the next one by exponential backoff with full jitter (uniform
+ * random 0 .. base * 2^(failures - 1), up to max), so devices failing at the
+ * same moment do not retry in lockstep; Retry-After of a throttled write is
+ * a lower bound. After repeated failures the circuit opens: no write for
+ * the open time, then a single probe write closes it again or reopens it.
+ *
+ * Nothing blocks, the caller checks ready() and reports results. Time
+ * spent in every state is counted. No hardware dependency (fleet
+ * simulator uses the same logic).
+ *****************************************************************************/
+#ifndef LINK_H_
+#define LINK_H_
+
+#include <stdint.h>
+
+#ifndef LINK_BACKOFF_BASE
+#define LINK_BACKOFF_BASE 2000              // Backoff after the first failure, before jitter (ms)
+#endif
+#ifndef LINK_BACKOFF_MAX
+#define LINK_BACKOFF_MAX 5*60*1000UL        // Backoff limit, before jitter (ms)
+#endif
+#ifndef LINK_FAILURES
+#define LINK_FAILURES 5                     // Consecutive failures opening the circuit
+#endif
+#ifndef LINK_OPEN_TIME
+#define LINK_OPEN_TIME 10*60*1000UL         // Open circuit blocks writes for (ms)
+#endif
+
+enum LinkState : uint8_t {
+  LINK_HEALTHY,                             // Last write succeeded
+  LINK_WIFI_DOWN,                           // No WiFi connection
+  LINK_UNREACHABLE,                         // Write failed (connection, timeout, server error), backing off
+  LINK_THROTTLED,                           // Server asked to slow down (429, 503), backing off
+  LINK_OPEN,                                // Circuit open after repeated failures, waiting for probe
+  LINK_STATE_COUNT
+};
+
+struct LinkStats {
+  uint64_t stateMillis[LINK_STATE_COUNT];   // Time spent in state (ms), without the current period
+  uint32_t failures;                        // Failed writes
+  uint32_t opens;                           // Circuit openings
+  uint32_t retryAfterMax;                   // Longest Retry-After received (s)
+};
+
+class Link {
+public:
+  Link(uint64_t (*clock)()) : _clock(clock), _stats() {}
+
+  // Start in healthy state, seed of jitter should differ between devices
+  void begin(uint32_t seed);
+  // WiFi connection state, call periodically
+  void wifi(bool connected);
+  // Write may be attempted now
+  bool ready() const;
+  // Time until write may be attempted (ms), UINT32_MAX with WiFi down
+  uint32_t wait() const;
+  // Write accepted
+  void success();
+  // Write failed, throttled by server (429, 503) or not, Retry-After (s, 0 = not sent)
+  void failure(bool throttled, uint32_t retryAfter);
+
+  LinkState state() const { return _state; }
+  // Consecutive failed writes
+  uint32_t failures() const { return _failures; }
+  // Time spent in state including the current period (ms)
+  uint64_t stateMillis(LinkState state) const;
+  const LinkStats& stats() const { return _stats; }
+  static const char* stateName(LinkState state);
+
+private:
+  void enter(LinkState state);
+  // Uniform random 0 .. range - 1 (xorshift32)
+  uint32_t random(uint32_t range);
+
+  uint64_t (*_clock)();
+  LinkState _state = LINK_HEALTHY;
+  LinkState _resume = LINK_HEALTHY;         // State after WiFi is restored
+  uint64_t _since = 0;                      // State entered (clock)
+  uint64_t _next = 0;                       // No write before (clock)
+  uint32_t _failures = 0;
+  uint32_t _random = 1;
+  LinkStats _stats;
+};
+
+#endif
@@ -0,0 +1,281 @@
+/*****************************************************************************
+ * Append-only record log on LittleFS
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************/
+#include "RecordLog.h"
+#include <Crc32.h>
+
+#define CRC_SIZE sizeof(uint32_t)
+
+RecordLog::RecordLog(const char* dir, uint16_t recordSize, uint8_t* page, uint16_t pageSize)
+  : _dir(dir), _recordSize(recordSize), _page(page), _pageSize(pageSize),
+    _pageRecords(pageSize / (CRC_SIZE + recordSize)), _unread(), _stats() {
+}
+
+bool RecordLog::begin(uint16_t segmentPages, uint8_t segments) {
+  _segmentPages = segmentPages;
+  _capacity = min(segments, (uint8_t)RECORD_LOG_MAX_SEGMENTS);
+  _first = 0;
+  _segments = 0;
+  _writePages = 0;
+  _pending = 0;
+  _cached = false;
+  memset(_unread, 0, sizeof(_unread));
+  _read = _peek = {};
+  if (_pageRecords == 0 || _segmentPages == 0 || _capacity == 0)
+    return false;
+  if (!LittleFS.exists(_dir) && !LittleFS.mkdir(_dir)) {
+    _stats.failures++;
+    return false;
+  }
+
+  // Segment range, cursor and unknown files are skipped
+  uint32_t first = UINT32_MAX;
+  uint32_t last = 0;
+  Dir dir = LittleFS.openDir(_dir);
+  while (dir.next()) {
+    String name = dir.fileName();
+    char* end;
+    uint32_t segment = strtoul(name.c_str(), &end, 16);
+    if (name.length() != 8 || *end)
+      continue;
+    first = min(first, segment);
+    last = max(last, segment);
+  }
+  if (first == UINT32_MAX) {
+    char name[32];
+    cursorPath(name);
+    LittleFS.remove(name);
+    return true;
+  }
+  // Capacity may be lower than before, the oldest segments are removed
+  while (last - first >= _capacity)
+    removeSegment(first++);
+  _first = first;
+  _segments = last - first + 1;
+  loadCursor();
+
+  // Count valid unread records, a torn or damaged end closes the last segment for appends
+  for (uint32_t segment = _first; segment <= last; segment++) {
+    uint16_t page = 0;
+    int length = 0;
+    bool torn = false;
+    while (page < _segmentPages && (length = loadPage(segment, page)) == _pageSize) {
+      for (uint16_t i = 0; i < _pageRecords; i++) {
+        const uint8_t* record = slot(i);
+        if (valid(record)) {
+          if (segment > _read.segment || page * _pageRecords + i >= _read.slot) {
+            _unread[segment % RECORD_LOG_MAX_SEGMENTS]++;
+            _pending++;
+          }
+          continue;
+        }
+        // Unused slots of padded page are erased (0xFF)
+        for (uint16_t j = 0; j < CRC_SIZE + _recordSize; j++) {
+          if (record[j] != 0xFF) {
+            _stats.corrupt++;
+            torn = true;
+            break;
+          }
+        }
+      }
+      page++;
+    }
+    if (length > 0 && length < _pageSize)
+      torn = true;
+    if (segment == last)
+      _writePages = torn ? _segmentPages : page;
+  }
+  // Read segments left by power loss before they were removed
+  consume(0);
+  return true;
+}
+
+bool RecordLog::append(const void* records, uint16_t count) {
+  if (_capacity == 0)
+    return false;
+  const uint8_t* record = (const uint8_t*)records;
+  while (count > 0) {
+    if (_segments == 0 || _writePages >= _segmentPages)
+      startSegment();
+    uint32_t segment = _first + _segments - 1;
+    uint16_t n = min(count, _pageRecords);
+    // Page is built in the shared buffer, unused slots stay erased
+    _cached = false;
+    memset(_page, 0xFF, _pageSize);
+    for (uint16_t i = 0; i < n; i++) {
+      uint32_t crc = crc32(record, _recordSize);
+      memcpy(slot(i), &crc, CRC_SIZE);
+      memcpy(slot(i) + CRC_SIZE, record, _recordSize);
+      record += _recordSize;
+    }
+    char name[32];
+    path(name, segment);
+    File file = LittleFS.open(name, "a");
+    bool written = file && file.size() == (size_t)_writePages * _pageSize && file.write(_page, _pageSize) == _pageSize;
+    file.close();
+    if (!written) {
+      // Segment end is not known, the next append starts a new segment
+      _writePages = _segmentPages;
+      _stats.failures++;
+      return false;
+    }
+    _writePages++;
+    _unread[segment % RECORD_LOG_MAX_SEGMENTS] += n;
+    _pending += n;
+    _stats.appended += n;
+    _stats.pageWrites++;
+    count -= n;
+  }
+  return true;
+}
+
+bool RecordLog::next(void* record) {
+  return advance(_peek, record);
+}
+
+void RecordLog::consume(uint16_t count) {
+  uint16_t consumed = 0;
+  uint32_t segment;
+  while (consumed < count && advance(_read, nullptr, &segment)) {
+    uint16_t& unread = _unread[segment % RECORD_LOG_MAX_SEGMENTS];
+    if (unread > 0)
+      unread--;
+    consumed++;
+  }
+  _pending -= min((uint32_t)consumed, _pending);
+  _stats.consumed += consumed;
+  // Read segments are removed from the oldest one, the last one too when everything is read
+  while (_segments > 0 && _unread[_first % RECORD_LOG_MAX_SEGMENTS] == 0) {
+    removeSegment(_first++);
+    _segments--;
+  }
+  if (_read.segment < _first)
+    _read = { _first, 0 };
+  _peek = _read;
+  char name[32];
+  cursorPath(name);
+  if (_segments == 0) {
+    _writePages = 0;
+    LittleFS.remove(name);
+  }
+  else if (consumed > 0) {
+    saveCursor();
+  }
+}
+
+// Moves position past the next valid record, copies it when record is set
+bool RecordLog::advance(Position& position, void* record, uint32_t* segment) {
+  if (_segments == 0)
+    return false;
+  uint32_t last = _first + _segments - 1;
+  if (position.segment < _first)
+    position = { _first, 0 };
+  while (position.segment <= last) {
+    uint16_t page = position.slot / _pageRecords;
+    uint16_t pages = position.segment == last ? _writePages : _segmentPages;
+    if (page >= pages || loadPage(position.segment, page) != _pageSize) {
+      // The last segment may get more records
+      if (position.segment == last)
+        return false;
+      position = { position.segment + 1, 0 };
+      continue;
+    }
+    const uint8_t* data = slot(position.slot % _pageRecords);
+    position.slot++;
+    if (!valid(data))
+      continue;
+    if (record)
+      memcpy(record, data + CRC_SIZE, _recordSize);
+    if (segment)
+      *segment = position.segment;
+    return true;
+  }
+  return false;
+}
+
+// Reads page to the page buffer, returns bytes read (page size when complete)
+int RecordLog::loadPage(uint32_t segment, uint16_t page) {
+  if (_cached && _cacheSegment == segment && _cachePage == page)
+    return _pageSize;
+  _cached = false;
+  char name[32];
+  path(name, segment);
+  File file = LittleFS.open(name, "r");
+  if (!file || !file.seek((uint32_t)page * _pageSize))
+    return 0;
+  int length = file.read(_page, _pageSize);
+  _cached = length == _pageSize;
+  _cacheSegment = segment;
+  _cachePage = page;
+  return length;
+}
+
+void RecordLog::startSegment() {
+  if (_segments >= _capacity) {
+    // Log is full, unread records of the oldest segment are given up
+    uint16_t& unread = _unread[_first % RECORD_LOG_MAX_SEGMENTS];
+    _stats.dropped += unread;
+    _pending -= unread;
+    unread = 0;
+    removeSegment(_first++);
+    _segments--;
+    // Cursor in removed segment is moved to the oldest one by begin(), it is not written here
+    if (_read.segment < _first)
+      _read = { _first, 0 };
+  }
+  _unread[(_first + _segments) % RECORD_LOG_MAX_SEGMENTS] = 0;
+  _segments++;
+  _writePages = 0;
+}
+
+void RecordLog::removeSegment(uint32_t segment) {
+  char name[32];
+  path(name, segment);
+  LittleFS.remove(name);
+  if (_cacheSegment == segment)
+    _cached = false;
+}
+
+void RecordLog::loadCursor() {
+  _read = { _first, 0 };
+  char name[32];
+  cursorPath(name);
+  File file = LittleFS.open(name, "r");
+  Cursor cursor;
+  if (!file || file.read((uint8_t*)&cursor, sizeof(cursor)) != sizeof(cursor) ||
+      cursor.crc != crc32((uint8_t*)&cursor + CRC_SIZE, sizeof(cursor) - CRC_SIZE))
+    return;
+  if (cursor.read.segment >= _first && cursor.read.segment - _first < _segments)
+    _read = cursor.read;
+  _peek = _read;
+}
+
+void RecordLog::saveCursor() {
+  Cursor cursor;
+  memset(&cursor, 0, sizeof(cursor));
+  cursor.read = _read;
+  cursor.crc = crc32((uint8_t*)&cursor + CRC_SIZE, sizeof(cursor) - CRC_SIZE);
+  char name[32];
+  cursorPath(name);
+  File file = LittleFS.open(name, "w");
+  if (!file || file.write((const uint8_t*)&cursor, sizeof(cursor)) != sizeof(cursor))
+    _stats.failures++;
+}
+
+// Paths fit into 32 bytes (LittleFS name limit) with a short directory name
+void RecordLog::path(char* out, uint32_t segment) const {
+  snprintf(out, 32, "%s/%08x", _dir, (unsigned)segment);
+}
+
+void RecordLog::cursorPath(char* out) const {
+  snprintf(out, 32, "%s/cursor", _dir);
+}
+
+bool RecordLog::valid(const uint8_t* slot) const {
+  uint32_t crc;
+  memcpy(&crc, slot, CRC_SIZE);
+  return crc == crc32(slot + CRC_SIZE, _recordSize);
+}
@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * Append-only record log on LittleFS
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Fixed size records are appended to numbered segment files (<dir>/<seq> as
+ * 8 hex digits), a new segment is started when the current one has all its
+ * pages, the oldest segment is deleted (unread records counted as dropped)
+ * when the log has all its segments. Flash is written in whole pages at page
+ * aligned offsets, a record never spans two pages, so one page write never
+ * touches two flash pages and a segment of one erase block is erased once.
+ * Read segments are deleted as a whole, nothing is rewritten in place.
+ *
+ * Every record carries CRC32. Read position is kept in a small cursor file
+ * (inline in LittleFS metadata, no block erase). After power loss begin()
+ * scans the segments: records with invalid CRC are skipped and counted, the
+ * last segment is closed for appends when its end is torn, a damaged cursor
+ * starts reading from the oldest segment again.
+ *****************************************************************************/
+#ifndef RECORD_LOG_H_
+#define RECORD_LOG_H_
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#define RECORD_LOG_MAX_SEGMENTS 64          // Most segments of one log (unread counts kept in RAM)
+
+struct RecordLogStats {
+  uint32_t appended;                        // Records written
+  uint32_t consumed;                        // Records read and removed
+  uint32_t dropped;                         // Unread records deleted with the oldest segment
+  uint32_t corrupt;                         // Records with invalid CRC found by begin(), skipped
+  uint32_t pageWrites;                      // Pages written to flash
+  uint32_t failures;                        // File system errors
+};
+
+class RecordLog {
+public:
+  // Records of recordSize bytes, page buffer is the write unit (record and its CRC must fit)
+  RecordLog(const char* dir, uint16_t recordSize, uint8_t* page, uint16_t pageSize);
+
+  // Recover segments and read position, file system must be mounted
+  bool begin(uint16_t segmentPages, uint8_t segments);
+  // Append records, written as whole pages (the last one padded), returns false on file system error
+  bool append(const void* records, uint16_t count);
+  // Records in one page, appends of this many records are not padded
+  uint16_t pageRecords() const { return _pageRecords; }
+
+  // Read from the oldest unread record: rewind(), then next() until it returns false
+  void rewind() { _peek = _read; }
+  bool next(void* record);
+  // Remove the oldest count records (read since rewind), fully read segments are deleted
+  void consume(uint16_t count);
+
+  // Records not read yet
+  uint32_t pending() const { return _pending; }
+  // Segment files in use and most segments
+  uint8_t segments() const { return _segments; }
+  uint8_t capacity() const { return _capacity; }
+  const RecordLogStats& stats() const { return _stats; }
+
+private:
+  struct Position {
+    uint32_t segment;                       // Segment number
+    uint16_t slot;                          // Record slot in segment
+  };
+  struct Cursor {
+    uint32_t crc;                           // CRC32 of the rest of cursor
+    Position read;
+  };
+
+  bool advance(Position& position, void* record, uint32_t* segment = nullptr);
+  int loadPage(uint32_t segment, uint16_t page);
+  void startSegment();
+  void removeSegment(uint32_t segment);
+  void loadCursor();
+  void saveCursor();
+  void path(char* out, uint32_t segment) const;
+  void cursorPath(char* out) const;
+  uint8_t* slot(uint16_t index) const { return _page + index * (sizeof(uint32_t) + _recordSize); }
+  bool valid(const uint8_t* slot) const;
+
+  const char* _dir;
+  uint16_t _recordSize;
+  uint8_t* _page;                           // Page being written or cached page being read
+  uint16_t _pageSize;
+  uint16_t _pageRecords;
+  uint16_t _segmentPages = 0;
+  uint8_t _capacity = 0;
+  uint32_t _first = 0;                      // Oldest segment
+  uint8_t _segments = 0;                    // Segments from the oldest one, the last one is appended
+  uint16_t _writePages = 0;                 // Pages in the last segment
+  uint16_t _unread[RECORD_LOG_MAX_SEGMENTS]; // Valid unread records of segment (index segment % max)
+  uint32_t _pending = 0;
+  Position _read = {};                      // Oldest unread record
+  Position _peek = {};                      // Next record of next()
+  bool _cached = false;                     // Page buffer holds _cacheSegment/_cachePage
+  uint32_t _cacheSegment = 0;
+  uint16_t _cachePage = 0;
+  RecordLogStats _stats;
+};
+
+#endif
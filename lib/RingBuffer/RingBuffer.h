@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * Fixed-capacity ring buffer
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Statically allocated FIFO, no heap is ever touched. When the buffer is full
+ * the oldest item is overwritten and the overflow counter is incremented.
+ *****************************************************************************/
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+template <typename T, size_t N>
+class RingBuffer {
+  static_assert(N > 0, "RingBuffer capacity must be positive");
+public:
+  // Append item, overwrite the oldest one when full (returns false in such case)
+  bool push(const T& item) {
+    bool dropped = full();
+    if (dropped) {
+      _head = next(_head);
+      _count--;
+      _overflows++;
+    }
+    _items[_tail] = item;
+    _tail = next(_tail);
+    _count++;
+    return !dropped;
+  }
+  // Oldest item, buffer must not be empty
+  T& front() { return _items[_head]; }
+  const T& front() const { return _items[_head]; }
+  // Item at position from the oldest one (0 = front)
+  T& at(size_t index) { return _items[(_head + index) % N]; }
+  const T& at(size_t index) const { return _items[(_head + index) % N]; }
+  // Remove the oldest item
+  void pop() {
+    if (_count == 0) return;
+    _head = next(_head);
+    _count--;
+  }
+  // Remove all items (overflow counter is kept)
+  void clear() { _head = _tail = _count = 0; }
+
+  size_t size() const { return _count; }
+  static constexpr size_t capacity() { return N; }
+  bool empty() const { return _count == 0; }
+  bool full() const { return _count == N; }
+  // Number of items lost because the buffer was full
+  uint32_t overflows() const { return _overflows; }
+
+private:
+  static size_t next(size_t index) { return index + 1 == N ? 0 : index + 1; }
+
+  T _items[N];
+  size_t _head = 0;                         // Oldest item
+  size_t _tail = 0;                         // Next free slot
+  size_t _count = 0;                        // Items stored
+  uint32_t _overflows = 0;                  // Items dropped when full
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*****************************************************************************
+ * Cooperative task scheduler
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Fixed set of periodic tasks run from loop(). Deadlines advance by whole
+ * periods, so the period does not drift by the time spent in the task.
+ * A task may yield while it waits for I/O: it returns the time (ms) after
+ * which it wants to be called again, other tasks run in the meantime.
+ *****************************************************************************/
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TASK_DONE 0                         // Task finished its work for this period
+
+// Task body, returns TASK_DONE or time to wait before it is called again (ms)
+typedef uint32_t (*TaskFunction)();
+
+struct Task {
+  const char* name;                         // Task name for statistics
+  TaskFunction function;                    // Task body
+  uint32_t period;                          // Task period (ms), 0 = run only when triggered
+  uint64_t deadline;                        // Start of next period
+  uint64_t resume;                          // Resume time of yielded task
+  bool waiting;                             // Task yielded and waits for resume
+  // Statistics
+  uint32_t runs;                            // Started periods
+  uint32_t calls;                           // Calls including resumes after yield
+  uint32_t overruns;                        // Periods skipped because task was late
+  uint32_t lateMax;                         // Maximum start delay after deadline (ms)
+  uint64_t lateSum;                         // Sum of start delays (ms)
+  uint64_t busyMicros;                      // Time spent in task (us)
+  uint32_t busyMaxMicros;                   // Longest single call (us)
+};
+
+template <size_t N>
+class Scheduler {
+public:
+  // Clock sources: millis64() for deadlines, micros() for time spent in tasks
+  Scheduler(uint64_t (*millisClock)(), uint32_t (*microsClock)())
+    : _millis(millisClock), _micros(microsClock), _tasks() {}
+
+  // Define task, first run after offset (ms)
+  void set(size_t id, const char* name, TaskFunction function, uint32_t period, uint32_t offset = 0) {
+    Task& task = _tasks[id];
+    task = Task();
+    task.name = name;
+    task.function = function;
+    task.period = period;
+    task.deadline = period > 0 || offset > 0 ? _millis() + offset : NEVER;
+  }
+  // Change task period, keeps current deadline
+  void setPeriod(size_t id, uint32_t period) { _tasks[id].period = period; }
+  // Run task as soon as possible (does not change its period)
+  void trigger(size_t id) {
+    Task& task = _tasks[id];
+    if (!task.waiting) {
+      uint64_t now = _millis();
+      if (task.deadline > now)
+        task.deadline = now;
+    }
+  }
+
+  // Run due tasks once, returns time to the nearest deadline (ms)
+  uint32_t run() {
+    for (size_t id = 0; id < N; id++) {
+      Task& task = _tasks[id];
+      if (!task.function)
+        continue;
+      uint64_t now = _millis();
+      if (task.waiting ? now < task.resume : now < task.deadline)
+        continue;
+      if (!task.waiting) {
+        // New period, measure start delay
+        uint32_t late = (uint32_t)(now - task.deadline);
+        task.runs++;
+        task.lateSum += late;
+        if (late > task.lateMax)
+          task.lateMax = late;
+      }
+      uint32_t start = _micros();
+      uint32_t wait = task.function();
+      uint32_t busy = _micros() - start;
+      task.calls++;
+      task.busyMicros += busy;
+      if (busy > task.busyMaxMicros)
+        task.busyMaxMicros = busy;
+      if (wait != TASK_DONE) {
+        task.waiting = true;
+        task.resume = _millis() + wait;
+        continue;
+      }
+      task.waiting = false;
+      advance(task);
+    }
+    return idle();
+  }
+
+  // Time to the nearest deadline or resume (ms)
+  uint32_t idle() const {
+    uint64_t now = _millis();
+    uint64_t next = NEVER;
+    for (size_t id = 0; id < N; id++) {
+      const Task& task = _tasks[id];
+      if (!task.function)
+        continue;
+      uint64_t due = task.waiting ? task.resume : task.deadline;
+      if (due < next)
+        next = due;
+    }
+    if (next <= now)
+      return 0;
+    return next - now > UINT32_MAX ? UINT32_MAX : (uint32_t)(next - now);
+  }
+
+  const Task& task(size_t id) const { return _tasks[id]; }
+  static constexpr size_t size() { return N; }
+  // Average start delay after deadline (ms)
+  uint32_t lateAverage(size_t id) const { return _tasks[id].runs ? _tasks[id].lateSum / _tasks[id].runs : 0; }
+  // Clear statistics of all tasks
+  void resetStatistics() {
+    for (size_t id = 0; id < N; id++) {
+      Task& task = _tasks[id];
+      task.runs = task.calls = task.overruns = task.lateMax = task.busyMaxMicros = 0;
+      task.lateSum = task.busyMicros = 0;
+    }
+  }
+
+private:
+  static constexpr uint64_t NEVER = UINT64_MAX;
+
+  // Move deadline to the next period, skip periods which are already over
+  void advance(Task& task) {
+    if (task.period == 0) {
+      task.deadline = NEVER;
+      return;
+    }
+    task.deadline += task.period;
+    uint64_t now = _millis();
+    if (task.deadline < now) {
+      uint64_t missed = (now - task.deadline) / task.period + 1;
+      task.overruns += missed;
+      task.deadline += missed * task.period;
+    }
+  }
+
+  uint64_t (*_millis)();
+  uint32_t (*_micros)();
+  Task _tasks[N];
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*****************************************************************************
+ * SNTP time synchronization with drift correction
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************/
+#include "TimeSync.h"
+
+#define NTP_PORT 123
+#define NTP_LOCAL_PORT 2390
+#define NTP_PACKET_SIZE 48
+#define NTP_UNIX_OFFSET 2208988800UL        // Seconds 1900-01-01 to 1970-01-01
+#define POLL_INTERVAL 10                    // Response check while waiting (ms)
+
+static uint32_t readUint32(const uint8_t* p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// NTP timestamp (seconds and fraction since 1900) to Unix time (ms)
+static uint64_t ntpMillis(const uint8_t* p) {
+  uint64_t seconds = readUint32(p) - NTP_UNIX_OFFSET;
+  return seconds * 1000 + (((uint64_t)readUint32(p + 4) * 1000) >> 32);
+}
+
+void TimeSync::begin(const char* server1, const char* server2, uint32_t interval) {
+  _servers[0] = server1 ? server1 : "";
+  _servers[1] = server2 ? server2 : "";
+  _server = _servers[0][0] ? 0 : 1;
+  _interval = interval;
+  _pending = false;
+  _next = synced() ? _state.monotonic + interval : _clock();
+  _udp.begin(NTP_LOCAL_PORT);
+}
+
+uint32_t TimeSync::update() {
+  uint64_t now = _clock();
+  if (_pending) {
+    int result = _udp.parsePacket() > 0 ? receive(now) : 0;
+    if (result > 0) {
+      _pending = false;
+      _next = now + _interval;
+    }
+    else if (result < 0 || now - _sent >= TIME_SYNC_TIMEOUT) {
+      _pending = false;
+      fail(now);
+    }
+    else {
+      return POLL_INTERVAL;
+    }
+  }
+  if (now >= _next) {
+    if (WiFi.status() != WL_CONNECTED) {
+      // Not a server failure, just try later
+      _next = now + TIME_SYNC_RETRY;
+    }
+    else if (send()) {
+      _pending = true;
+      return POLL_INTERVAL;
+    }
+    else {
+      fail(now);
+    }
+  }
+  uint64_t wait = _next - now;
+  return wait < UINT32_MAX ? (uint32_t)wait : UINT32_MAX;
+}
+
+uint64_t TimeSync::epochMillis(uint64_t monotonic) const {
+  if (!synced())
+    return 0;
+  int64_t elapsed = (int64_t)(monotonic - _state.monotonic);
+  return _state.epochMillis + elapsed - elapsed * _state.driftPpb / 1000000000;
+}
+
+bool TimeSync::send() {
+  const char* server = _servers[_server];
+  if (!server[0])
+    return false;
+  // host[:port], port is for testing against local server
+  char host[64];
+  uint16_t port = NTP_PORT;
+  const char* colon = strchr(server, ':');
+  size_t length = colon ? (size_t)(colon - server) : strlen(server);
+  if (length >= sizeof(host))
+    return false;
+  memcpy(host, server, length);
+  host[length] = 0;
+  if (colon)
+    port = (uint16_t)atoi(colon + 1);
+  // Drop late responses of previous requests, every parsePacket() discards the previous packet
+  while (_udp.parsePacket() > 0) {
+  }
+
+  // Host name is resolved here, request time is taken after that
+  if (!_udp.beginPacket(host, port))
+    return false;
+  uint8_t packet[NTP_PACKET_SIZE] = {};
+  packet[0] = 0x23;                         // No leap warning, version 4, client mode
+  // Transmit timestamp is returned as originate timestamp, monotonic time identifies the response
+  _sent = _clock();
+  for (int i = 0; i < 8; i++)
+    packet[40 + i] = (uint8_t)(_sent >> (56 - i * 8));
+  _udp.write(packet, sizeof(packet));
+  return _udp.endPacket();
+}
+
+int TimeSync::receive(uint64_t now) {
+  uint8_t packet[NTP_PACKET_SIZE];
+  if (_udp.read(packet, sizeof(packet)) != NTP_PACKET_SIZE)
+    return -1;
+  // Late response to previous request is ignored
+  uint64_t origin = 0;
+  for (int i = 0; i < 8; i++)
+    origin = origin << 8 | packet[24 + i];
+  if (origin != _sent)
+    return 0;
+  // Server mode, synchronized server (no alarm, stratum 1-15, 0 is kiss-o'-death)
+  if ((packet[0] & 0x07) != 4 || (packet[0] >> 6) == 3 || packet[1] == 0 || packet[1] > 15)
+    return -1;
+
+  uint64_t received = ntpMillis(packet + 32);
+  uint64_t transmitted = ntpMillis(packet + 40);
+  // Round trip without server processing time, the server time is valid in its middle
+  int64_t roundTrip = (int64_t)(now - _sent) - (int64_t)(transmitted - received);
+  if (roundTrip < 0)
+    roundTrip = 0;
+  uint64_t epoch = transmitted + roundTrip / 2;
+
+  int64_t offset = 0;
+  if (synced()) {
+    offset = (int64_t)(epoch - epochMillis(now));
+    // Error accumulated since previous anchor is the rate error, too short interval is only jitter
+    uint64_t elapsed = now - _state.monotonic;
+    if (elapsed >= TIME_SYNC_DRIFT_MIN) {
+      int64_t drift = _state.driftPpb - offset * 1000000000 / (int64_t)elapsed;
+      if (drift >= -TIME_SYNC_DRIFT_MAX && drift <= TIME_SYNC_DRIFT_MAX)
+        _state.driftPpb = (int32_t)drift;
+    }
+  }
+  _state.epochMillis = epoch;
+  _state.monotonic = now;
+
+  _stats.syncs++;
+  _stats.offsetMillis = (int32_t)constrain(offset, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+  uint32_t magnitude = (uint32_t)min(offset < 0 ? -offset : offset, (int64_t)UINT32_MAX);
+  if (magnitude > _stats.offsetMaxMillis)
+    _stats.offsetMaxMillis = magnitude;
+  _stats.roundTripMillis = (uint32_t)roundTrip;
+  return 1;
+}
+
+void TimeSync::fail(uint64_t now) {
+  _stats.failures++;
+  // Next request to the other server, if there is any
+  if (_servers[_server ^ 1][0])
+    _server ^= 1;
+  _next = now + TIME_SYNC_RETRY;
+}
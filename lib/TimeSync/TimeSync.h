@@ -0,0 +1,94 @@
+/*****************************************************************************
+ * SNTP time synchronization with drift correction
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Maps the monotonic clock (millis64) to Unix time. Every synchronization
+ * anchors the mapping to the server time, round trip is compensated as in
+ * SNTP (RFC 4330). The error found by the next synchronization, divided by
+ * the time since the previous one, corrects the clock rate (drift), so time
+ * between synchronizations and of samples taken before them stays accurate.
+ * The state is small and can be kept over deep sleep (RTC memory).
+ *
+ * Requests are not blocking, update() is called from a task and returns time
+ * to the next call.
+ *****************************************************************************/
+#ifndef TIME_SYNC_H_
+#define TIME_SYNC_H_
+
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#ifndef TIME_SYNC_TIMEOUT
+#define TIME_SYNC_TIMEOUT 1000              // Server response timeout (ms)
+#endif
+#ifndef TIME_SYNC_RETRY
+#define TIME_SYNC_RETRY 15000               // Next request after failed one (ms)
+#endif
+#ifndef TIME_SYNC_DRIFT_MIN
+#define TIME_SYNC_DRIFT_MIN 10*60*1000UL    // Shorter intervals do not correct drift (ms)
+#endif
+#ifndef TIME_SYNC_DRIFT_MAX
+#define TIME_SYNC_DRIFT_MAX 50000000L       // Larger drift is a time step, not drift (ppb, 5 %)
+#endif
+
+// Mapping of monotonic clock to Unix time
+struct TimeSyncState {
+  uint64_t epochMillis;                     // Unix time at anchor (ms), 0 = not synchronized
+  uint64_t monotonic;                       // Monotonic clock at anchor (ms)
+  int32_t driftPpb;                         // Monotonic clock runs faster by (parts per billion)
+  uint32_t reserved;
+};
+
+struct TimeSyncStats {
+  uint32_t syncs;                           // Successful synchronizations
+  uint32_t failures;                        // Timeouts and invalid responses
+  int32_t offsetMillis;                     // Correction of the last synchronization (ms)
+  uint32_t offsetMaxMillis;                 // Largest correction (absolute, ms)
+  uint32_t roundTripMillis;                 // Round trip of the last synchronization (ms)
+};
+
+class TimeSync {
+public:
+  TimeSync(uint64_t (*clock)()) : _clock(clock), _state(), _stats() {}
+
+  // Servers host[:port] may be empty, interval between synchronizations (ms). Restored state
+  // (setState) is synchronized again when the interval since its anchor elapsed.
+  void begin(const char* server1, const char* server2, uint32_t interval);
+  // Send request when due and process response, returns time to the next call (ms)
+  uint32_t update();
+  // Synchronize now (next update() sends request)
+  void trigger() { _next = _clock(); }
+
+  bool synced() const { return _state.epochMillis != 0; }
+  // Request sent, waiting for response
+  bool pending() const { return _pending; }
+  // Unix time (ms) of monotonic clock value, 0 when not synchronized
+  uint64_t epochMillis(uint64_t monotonic) const;
+  uint64_t epochMillis() const { return epochMillis(_clock()); }
+
+  // State for keeping over deep sleep
+  const TimeSyncState& state() const { return _state; }
+  void setState(const TimeSyncState& state) { _state = state; }
+  const TimeSyncStats& stats() const { return _stats; }
+
+private:
+  bool send();
+  // Returns 1 when accepted, 0 when not response to the last request, -1 when invalid
+  int receive(uint64_t now);
+  void fail(uint64_t now);
+
+  uint64_t (*_clock)();
+  const char* _servers[2] = { "", "" };
+  uint8_t _server = 0;                      // Server used by the next request
+  uint32_t _interval = 0;
+  uint64_t _next = 0;                       // Next request time (monotonic)
+  bool _pending = false;                    // Waiting for response
+  uint64_t _sent = 0;                       // Request time (monotonic)
+  WiFiUDP _udp;
+  TimeSyncState _state;
+  TimeSyncStats _stats;
+};
+
+#endif
@@ -31,6 +31,35 @@ void setup() {
   digitalWrite(LED_PIN, LED_ON); 
   #endif
 
+  // Sensor defaults, replaced by configuration
+  eachChannel([](const SensorChannel& channel, SensorSetting& setting) {
+    strlcpy(setting.name, channel.name, sizeof(setting.name));
+    setting.deadband = channel.deadband;
+  });
+
+  #ifdef USE_DEEP_SLEEP
+  // Wake without radio, just store sample to RTC memory and sleep again
+  if (!sleepWake()) {
+    #ifdef USE_SETUP_PIN
+    // Configuration requested, radio is needed - wake again immediately with radio
+    pinMode(SETUP_PIN, INPUT_PULLUP);
+    if (digitalRead(SETUP_PIN) == LOW) {
+      sleepNow(1, true);
+    }
+    #endif
+    // Deadbands and heartbeat from binary configuration (single read), defaults when it is not valid
+    if (LittleFS.begin())
+      loadConfigRecord();
+    reportBegin();
+    sensorsBegin();
+    Sample sample = {};
+    if (readSample(sample) && reportFilter(sample)) {
+      samples.push(sample);
+    }
+    sleepEnd();
+  }
+  #endif
+
   // Read configuration from LittleFS
   bool configLoaded = loadConfigFile();
   // Configure WiFiManager options
@@ -39,7 +68,7 @@ void setup() {
   wm.setAPCallback(configModeCallback);  
 
   WiFiManagerParameter influxHeader("<h3>InfluxDB parameters</h3>");
-  WiFiManagerParameter influxUrlParameter("influx_url", "InfluxDB URL", influxUrl, sizeof(influxUrl));  
+  WiFiManagerParameter influxUrlParameter("influx_url", "InfluxDB URL (http(s):// or udp://)", influxUrl, sizeof(influxUrl));  
   WiFiManagerParameter influxOrgParameter("influx_org", "InfluxDB ORG", influxOrg, sizeof(influxOrg));
   WiFiManagerParameter influxBucketParameter("influx_bucket", "InfluxDB Bucket", influxBucket, sizeof(influxBucket));
   WiFiManagerParameter influxTokenParameter("influx_token", "InfluxDB Token", influxToken, sizeof(influxToken));
@@ -54,32 +83,50 @@ void setup() {
   wm.addParameter(&measurementNameParameter);
   wm.addParameter(&locationParameter);
 
-  #ifdef USE_DHT_SENSOR
-  WiFiManagerParameter dhtHeader("<h3>DHT sensor field names</h3>");
-  WiFiManagerParameter dhtFieldTemperatureParameter("dht_field_temperature", "Temperature", dhtFieldTemperature, sizeof(dhtFieldTemperature));
-  WiFiManagerParameter dhtFieldHumidityParameter("dht_field_humidity", "Humidity", dhtFieldHumidity, sizeof(dhtFieldHumidity));
-  wm.addParameter(&dhtHeader);
-  wm.addParameter(&dhtFieldTemperatureParameter);
-  wm.addParameter(&dhtFieldHumidityParameter);  
-  #endif
+  char batchSizeValue[6];
+  char batchAgeValue[11];
+  char heartbeatValue[11];
+  snprintf(batchSizeValue, sizeof(batchSizeValue), "%u", batchSize);
+  snprintf(batchAgeValue, sizeof(batchAgeValue), "%u", batchMaxAge);
+  snprintf(heartbeatValue, sizeof(heartbeatValue), "%u", heartbeatInterval);
+  WiFiManagerParameter batchHeader("<h3>Batch write</h3>");
+  WiFiManagerParameter batchSizeParameter("batch_size", "Samples in one write", batchSizeValue, sizeof(batchSizeValue));
+  WiFiManagerParameter batchAgeParameter("batch_age", "Maximum batch age (s)", batchAgeValue, sizeof(batchAgeValue));
+  WiFiManagerParameter heartbeatParameter("heartbeat", "All fields sent at least every (s)", heartbeatValue, sizeof(heartbeatValue));
+  wm.addParameter(&batchHeader);
+  wm.addParameter(&batchSizeParameter);
+  wm.addParameter(&batchAgeParameter);
+  wm.addParameter(&heartbeatParameter);
 
-  #ifdef USE_BMP280_SENSOR
-  WiFiManagerParameter bmp280Header("<h3>BMP280 sensor field names</h3>");
-  wm.addParameter(&bmp280Header);
-  #ifndef BMP280_NO_TEMPERATURE
-  WiFiManagerParameter bmp280FieldTemperatureParameter("bmp280_field_temperature", "Temperature", bmp280FieldTemperature, sizeof(bmp280FieldTemperature));
-  wm.addParameter(&bmp280FieldTemperatureParameter);
-  #endif
-  WiFiManagerParameter bmp280FieldPressureParameter("bmp280_field_pressure", "Pressure", bmp280FieldPressure, sizeof(bmp280FieldPressure));
-  wm.addParameter(&bmp280FieldPressureParameter);  
-  #endif
+  WiFiManagerParameter timeHeader("<h3>Time synchronization</h3>");
+  WiFiManagerParameter ntpServer1Parameter("ntp_server_1", "NTP server", ntpServer1, sizeof(ntpServer1));
+  WiFiManagerParameter ntpServer2Parameter("ntp_server_2", "Secondary NTP server", ntpServer2, sizeof(ntpServer2));
+  WiFiManagerParameter timePrecisionParameter("time_precision", "Timestamp precision (s, ms)", timePrecision, sizeof(timePrecision));
+  wm.addParameter(&timeHeader);
+  wm.addParameter(&ntpServer1Parameter);
+  wm.addParameter(&ntpServer2Parameter);
+  wm.addParameter(&timePrecisionParameter);
 
-  #ifdef USE_DS18B20_SENSOR
-  WiFiManagerParameter ds18b20Header("<h3>DS18B20 sensor field names</h3>");
-  WiFiManagerParameter ds18b20FieldTemperatureParameter("ds18b20_field_temperature", "Temperature", ds18b20FieldTemperature, sizeof(ds18b20FieldTemperature));
-  wm.addParameter(&ds18b20Header);
-  wm.addParameter(&ds18b20FieldTemperatureParameter);
-  #endif
+  // Sensor field names and deadbands, section of every sensor in the list
+  WiFiManagerParameter* sensorParameters[Sensors::COUNT + 2 * Sensors::CHANNELS];
+  char deadbandValues[sizeof(sensorSettings) / sizeof(SensorSetting)][16];
+  uint8_t sensorParameterCount = 0;
+  sensors.each([&](auto& sensor, const SensorSlot& slot) {
+    sensorParameters[sensorParameterCount++] = new WiFiManagerParameter(sensor.TITLE);
+    for (uint8_t i = 0; i < sensor.CHANNELS; i++) {
+      const SensorChannel& channel = sensor.channels[i];
+      SensorSetting& setting = sensorSettings[slot.channel + i];
+      sensorParameters[sensorParameterCount++] = new WiFiManagerParameter(channel.id, channel.label, setting.name, sizeof(setting.name));
+    }
+    for (uint8_t i = 0; i < sensor.CHANNELS; i++) {
+      const SensorChannel& channel = sensor.channels[i];
+      char* value = deadbandValues[slot.channel + i];
+      snprintf(value, sizeof(deadbandValues[0]), "%g", sensorSettings[slot.channel + i].deadband);
+      sensorParameters[sensorParameterCount++] = new WiFiManagerParameter(channel.deadbandId, channel.deadbandLabel, value, sizeof(deadbandValues[0]));
+    }
+  });
+  for (uint8_t i = 0; i < sensorParameterCount; i++)
+    wm.addParameter(sensorParameters[i]);
 
   // Set setup pin
   #ifdef USE_SETUP_PIN
@@ -108,7 +155,9 @@ void setup() {
       DPRINTLN_F("Config load successful, connecting to WiFi...");
       // Set configuration portal timeout
       wm.setConfigPortalTimeout(CONFIG_PORTAL_TIMEOUT);
-      if (!wm.autoConnect(deviceId)) {
+      wifiStart = millis();
+      wifiFast = FAST_CONNECT();
+      if (!wifiFast && !wm.autoConnect(deviceId)) {
         DPRINTLN_F("Config portal failed, rebooting.");      
         ESP.restart();
       }
@@ -118,10 +167,15 @@ void setup() {
   #endif
 
   // We are connected
+  wifiMillis = millis() - wifiStart;
   DPRINT_F("Connected to network ");
   DPRINT(WiFi.SSID());
   DPRINT_F(", IP ");
   DPRINTLN(WiFi.localIP());
+  DPRINTFLN("WiFi connected in %u ms (%s)", (unsigned)wifiMillis, wifiFast ? "fast" : "full");
+  #ifdef USE_FAST_CONNECT
+  saveWifiCache();
+  #endif
 
   // Save configuration if needed
   if (shouldSaveConfig) {
@@ -131,135 +185,505 @@ void setup() {
     strncpy(influxToken, influxTokenParameter.getValue(), sizeof(influxToken));
     strncpy(measurementName, measurementNameParameter.getValue(), sizeof(measurementName));
     strncpy(location, locationParameter.getValue(), sizeof(location));
-    #ifdef USE_DHT_SENSOR    
-    strncpy(dhtFieldTemperature, dhtFieldTemperatureParameter.getValue(), sizeof(dhtFieldTemperature));
-    strncpy(dhtFieldHumidity, dhtFieldHumidityParameter.getValue(), sizeof(dhtFieldHumidity));    
-    #endif   
-    #ifdef USE_BMP280_SENSOR
-    #ifndef BMP280_NO_TEMPERATURE
-    strncpy(bmp280FieldTemperature, bmp280FieldTemperatureParameter.getValue(), sizeof(bmp280FieldTemperature));
-    #endif
-    strncpy(bmp280FieldPressure, bmp280FieldPressureParameter.getValue(), sizeof(bmp280FieldPressure));
-    #endif
-    #ifdef USE_DS18B20_SENSOR
-    strncpy(ds18b20FieldTemperature, ds18b20FieldTemperatureParameter.getValue(), sizeof(ds18b20FieldTemperature));
-    #endif
+    batchSize = constrain(atoi(batchSizeParameter.getValue()), 1, SAMPLE_BUFFER_SIZE);
+    batchMaxAge = strtoul(batchAgeParameter.getValue(), nullptr, 10);
+    heartbeatInterval = strtoul(heartbeatParameter.getValue(), nullptr, 10);
+    strncpy(ntpServer1, ntpServer1Parameter.getValue(), sizeof(ntpServer1));
+    strncpy(ntpServer2, ntpServer2Parameter.getValue(), sizeof(ntpServer2));
+    strcpy(timePrecision, strcmp(timePrecisionParameter.getValue(), "ms") == 0 ? "ms" : "s");
+    // Sensor parameters are in the order they were added, header, names, deadbands
+    uint8_t parameter = 0;
+    sensors.each([&](auto& sensor, const SensorSlot& slot) {
+      parameter++;
+      for (uint8_t i = 0; i < sensor.CHANNELS; i++) {
+        SensorSetting& setting = sensorSettings[slot.channel + i];
+        strncpy(setting.name, sensorParameters[parameter++]->getValue(), sizeof(setting.name));
+      }
+      for (uint8_t i = 0; i < sensor.CHANNELS; i++)
+        sensorSettings[slot.channel + i].deadband = fabs(atof(sensorParameters[parameter++]->getValue()));
+    });
     saveConfigFile();
     shouldSaveConfig = false;
     // Restart after configuration changes
     ESP.restart();
   }
+  // Portal is not started again, parameters of other sections are freed at the end of setup
+  for (uint8_t i = 0; i < sensorParameterCount; i++)
+    delete sensorParameters[i];
   
-  // Configure InfluxDB client
-  client.setConnectionParams(influxUrl, influxOrg, influxBucket, influxToken);
-  client.setInsecure();  // Ignore invalid certificates, we are not able to validate chain correctly anyway
-
-  // Check server connection
-  if (client.validateConnection()) {
-    DPRINT_F("Connected to InfluxDB: ");
-    DPRINTLN(client.getServerUrl());
-  } else {
-    DPRINT_F("InfluxDB connection failed: ");
-    DPRINTLN(client.getLastErrorMessage());
-  }
+  // Cache line protocol prefix for this connection
+  encoderBegin();
+  // Deadbands from configuration, last reported values are kept
+  reportBegin();
 
-  #ifdef USE_DHT_SENSOR
-  // Initialize DHT sensor device
-  dht.begin();
+  #ifdef USE_SAMPLE_LOG
+  // Samples logged before restart or power loss are written again
+  bootId = ESP.random();
+  if (!sampleLog.begin(SAMPLE_LOG_SEGMENT_PAGES, SAMPLE_LOG_SEGMENTS)) {
+    DPRINTLN_F("Sample log is not available.");
+  }
+  DPRINTFLN("Sample log: %u samples in %u/%u segments, %u damaged", (unsigned)sampleLog.pending(),
+    sampleLog.segments(), sampleLog.capacity(), sampleLog.stats().corrupt);
   #endif
 
-  #ifdef USE_BMP280_SENSOR
-  if (!bmp280.begin(BMP280_I2C_ADDRESS)) { 
-    DPRINTLN_F("Could not find a valid BMP280 sensor, check wiring!");
-    fail(FAIL_I2C);
+  // Configure InfluxDB writer, samples are written with own timestamps
+  if (!writer.begin(influxUrl, influxOrg, influxBucket, influxToken, timePrecision)) {
+    DPRINT_F("InfluxDB configuration failed: ");
+    DPRINTLN(writer.lastError());
   }
+  writer.setTimeout(INFLUXDB_TIMEOUT);
+  #ifdef INFLUXDB_NO_REUSE
+  writer.setReuse(false);
+  #endif
+  #ifdef INFLUXDB_GZIP
+  writer.setCompression(&gzip, INFLUXDB_GZIP_THRESHOLD);
   #endif
+  // Synchronize time for sample timestamps, the first request is sent by time task (or before deep sleep write)
+  timeSync.begin(ntpServer1, ntpServer2, TIME_SYNC_INTERVAL);
 
-  #ifdef USE_DS18B20_SENSOR
-  //Initialize Dallas OneWire sensor device
-  dallas.begin();
-  dsCount = dallas.getDeviceCount();
-  if (dsCount == 0) {
-    DPRINTLN_F("Could not find any DS18B20 sensor, check wiring!");
-    fail(FAIL_DALLAS);
+  // Writes start healthy, jitter differs between devices
+  connectivity.begin(ESP.getChipId() ^ micros());
+
+  // Open server connection once, the first write uses it (no separate health check request)
+  if (writer.connect()) {
+    firstByteMillis = millis() - wifiStart;
+    DPRINTFLN("Connected to InfluxDB %s in %u ms", writer.serverUrl(), (unsigned)writer.stats().connectMillis);
+    DPRINTFLN("Ready to send %u ms after WiFi start (%s connect)", (unsigned)firstByteMillis, wifiFast ? "fast" : "full");
+  } else {
+    DPRINT_F("InfluxDB connection failed: ");
+    DPRINTLN(writer.lastError());
   }
-  DPRINTFLN("Find %i DS18B20 devices", dsCount);
-  #endif
+
+  // Initialize sensors
+  sensorsBegin();
 
   #ifdef USE_LED
   // End setup
   digitalWrite(LED_PIN, LED_OFF); 
   #endif
+
+  #ifdef USE_DEEP_SLEEP
+  // Wake with radio, write all stored samples and sleep again
+  rtcState.header.batchSize = batchSize;
+  rtcState.header.batchMaxAge = batchMaxAge;
+  Sample sample = {};
+  uint32_t sampleReady = millis() + sampleStart(sample);
+  // Wait for time synchronization (when due) while sensors convert, samples are written with own timestamps
+  uint32_t ntpStart = millis();
+  for (;;) {
+    uint32_t wait = timeSync.update();
+    if ((timeSync.synced() && !timeSync.pending()) || millis() - ntpStart >= NTP_TIMEOUT)
+      break;
+    delay(min(wait, (uint32_t)50));
+  }
+  if ((int32_t)(sampleReady - millis()) > 0) {
+    delay(sampleReady - millis());
+  }
+  if (sampleCollect(sample) && reportFilter(sample)) {
+    samples.push(sample);
+  }
+  if (!flushSamples()) {
+    BLINK(ERROR_WRITE);
+  }
+  sleepEnd();
+  #endif
+
+  // Start tasks
+  #ifdef USE_LED
+  scheduler.set(TASK_LED, "led", ledTask, LED_INTERVAL);
+  #endif
+  scheduler.set(TASK_SAMPLE, "sample", sampleTask, SAMPLE_INTERVAL);
+  scheduler.set(TASK_FLUSH, "flush", flushTask, FLUSH_INTERVAL);
+  scheduler.set(TASK_CONNECT, "connect", connectTask, CONNECT_INTERVAL);
+  scheduler.set(TASK_TIME, "time", timeTask, TIME_CHECK_INTERVAL);
+  #ifdef USE_TELEMETRY
+  scheduler.set(TASK_TELEMETRY, "telemetry", telemetryTask, TELEMETRY_INTERVAL, TELEMETRY_OFFSET);
+  #endif
+  #ifdef USE_SAMPLE_LOG
+  // Replay rate is per second
+  scheduler.set(TASK_REPLAY, "replay", replayTask, 1000);
+  #endif
+  #ifdef DEBUG
+  scheduler.set(TASK_STATS, "stats", statsTask, STATS_INTERVAL, STATS_INTERVAL);
+  #endif
 }
 
 void loop() {
-  if (WiFi.status() != WL_CONNECTED)
-  {
-    
+  // Run due tasks and wait for the nearest deadline, delay() lets WiFi stack work meanwhile
+  delay(scheduler.run());
+}
+
+/***** Tasks *****/
+uint32_t sampleTask() {
+  static Sample sample;                     // Sample being acquired
+  static bool converting = false;           // Waiting for sensor conversions
+
+  if (!converting) {
+    BLINK(1); // Blink at every measure  
+
+    // Start sensor conversions
+    sample = {};
+    uint32_t wait = sampleStart(sample);
+    if (wait > 0) {
+      converting = true;
+      // Let pending write run while sensors convert
+      if (batchDue()) {
+        scheduler.trigger(TASK_FLUSH);
+      }
+      return wait;
+    }
   }
+  converting = false;
 
-  BLINK(1); // Blink at every measure  
+  // Collect sensor values
+  bool saveToInflux = sampleCollect(sample);
 
-  bool saveToInflux = false; // Are there any data to save?
+  #ifdef USE_AGGREGATION
+  // Readings go to window statistics, one sample is written per window
+  aggregateAdd(sample);
+  if (++windowReadings < AGGREGATE_READINGS) {
+    return TASK_DONE;
+  }
+  windowReadings = 0;
+  saveToInflux = aggregateSample(sample);
+  #endif
 
-  // Define data point with measurement name
-  Point pointDevice(measurementName);
-  // Set tags
-  pointDevice.addTag("device", deviceId);
-  pointDevice.addTag("SSID", WiFi.SSID());
-  pointDevice.addTag("location", location);
+  // Queue sample, the oldest one is dropped when buffer is full (moved to the log with USE_SAMPLE_LOG)
+  #ifdef USE_SAMPLE_LOG
+  if (saveToInflux && samples.full()) {
+    sampleLogSpill();
+  }
+  #endif
+  if (!saveToInflux) {
+    DPRINTLN_F("No data to write to InfluxDB.");
+  }
+  else if (reportFilter(sample)) {
+    samples.push(sample);
+  }
+  else {
+    DPRINTLN_F("No field changed over deadband, sample skipped.");
+  }
+  DPRINTFLN("Pending samples %u/%u, logged %u, dropped %u", (unsigned)samples.size(), (unsigned)samples.capacity(),
+    (unsigned)SAMPLE_LOG_PENDING(), (unsigned)(samples.overflows() + SAMPLE_LOG_DROPPED()));
 
-  // Add device data
-  pointDevice.addField("rssi", WiFi.RSSI());
-  pointDevice.addField("uptime", millis64());
+  // Write pending samples as soon as batch is complete
+  if (batchDue()) {
+    scheduler.trigger(TASK_FLUSH);
+  }
+  return TASK_DONE;
+}
 
-  #ifdef USE_DHT_SENSOR
-  DPRINTF("Reading DHT%i sensor ... ", DHT_TYPE);
-  // Read data from sensor
-  // Reading temperature or humidity takes about 250 milliseconds!
-  // Sensor readings may also be up to 2 seconds 'old' (its a very slow sensor)
-  // Read temperature as Celsius (the default)
-  float dhtT = dht.readTemperature(false, true);
-  // Read humidity
-  float dhtH = dht.readHumidity();
+uint32_t flushTask() {
+  // Backing off or circuit open, samples stay buffered
+  if (!batchDue() || WiFi.status() != WL_CONNECTED || !connectivity.ready()) {
+    return TASK_DONE;
+  }
+  if (!flushSamples()) {
+    BLINK(ERROR_WRITE);
+  }
+  return TASK_DONE;
+}
 
-  // Check if any reads failed and exit early (to try again).
-  if (isnan(dhtT) || isnan(dhtH)) {
-    DPRINTFLN("Failed to read from DHT%i sensor on pin %i", DHT_TYPE, DHT_PIN);
+uint32_t connectTask() {
+  static bool disconnected = false;         // WiFi connection was lost
+  static uint64_t disconnectedAt;           // Time of disconnection or last reconnect attempt
+  static uint32_t lostMicros;               // Time of disconnection (micros())
+  connectivity.wifi(WiFi.status() == WL_CONNECTED);
+  if (WiFi.status() == WL_CONNECTED) {
+    if (disconnected) {
+      DPRINTLN_F("WiFi connection restored.");
+      #ifdef USE_TELEMETRY
+      telemetry.reconnects++;
+      #endif
+      TELEMETRY_STAGE(STAGE_RECONNECT, lostMicros);
+      disconnected = false;
+      // Network name may change
+      encoderBegin();
+    }
+    return TASK_DONE;
+  }
+  uint64_t now = millis64();
+  if (!disconnected) {
+    DPRINTLN_F("WiFi connection lost.");
+    disconnected = true;
+    disconnectedAt = now;
+    lostMicros = micros();
+    // Server connection is gone with WiFi, TLS session stays for resumption
+    writer.stop();
+  }
+  else if (now - disconnectedAt >= CONNECT_TIMEOUT) {
+    DPRINTLN_F("Reconnecting WiFi...");
+    WiFi.reconnect();
+    disconnectedAt = now;
+  }
+  return TASK_DONE;
+}
+
+uint32_t timeTask() {
+  uint32_t syncs = timeSync.stats().syncs;
+  uint32_t wait = timeSync.update();
+  if (timeSync.stats().syncs != syncs) {
+    const TimeSyncStats& stats = timeSync.stats();
+    DPRINTFLN("Time synchronized, correction %d ms, round trip %u ms, drift %d ppm", stats.offsetMillis,
+      stats.roundTripMillis, (int)(timeSync.state().driftPpb / 1000));
+  }
+  // Yield while waiting for server response
+  return timeSync.pending() ? wait : TASK_DONE;
+}
+
+#ifdef USE_TELEMETRY
+uint32_t telemetryTask() {
+  if (WiFi.status() != WL_CONNECTED || !connectivity.ready()) {
+    return TASK_DONE;
+  }
+  // Counters are cumulative, a lost telemetry write is covered by the next one
+  if (!telemetryLine()) {
+    DPRINTLN_F("Telemetry does not fit into buffer.");
+    return TASK_DONE;
+  }
+  DPRINTLN_F("InfluxDB writing telemetry:");
+  DPRINTLN(telemetryBody);
+  bool written = writer.write(telemetryBody, telemetryEncoder.length());
+  connectivityResult(written);
+  if (!written) {
+    telemetryError(writer.lastStatus());
+    DPRINT_F("Telemetry write failed: ");
+    DPRINTLN(writer.lastError());
+    return TASK_DONE;
+  }
+  // Maxima start again for the next interval
+  memset(telemetry.maxMicros, 0, sizeof(telemetry.maxMicros));
+  telemetry.heapMin = 0;
+  return TASK_DONE;
+}
+#endif
+
+#ifdef DEBUG
+uint32_t statsTask() {
+  DPRINTLN_F("Task statistics (runs, overruns, late avg/max ms, busy avg/max us):");
+  for (size_t id = 0; id < scheduler.size(); id++) {
+    const Task& task = scheduler.task(id);
+    DPRINTFLN("  %-8s %6u %4u %6u %6u %8u %8u", task.name, task.runs, task.overruns,
+      scheduler.lateAverage(id), task.lateMax,
+      task.calls ? (unsigned)(task.busyMicros / task.calls) : 0, task.busyMaxMicros);
+  }
+  const InfluxWriterStats& stats = writer.stats();
+  DPRINTFLN("InfluxDB writes %u (failed %u, reused connection %u), connections %u, connect last/max %u/%u ms, write avg/max %u/%u ms",
+    stats.writes, stats.failures, stats.reused, stats.connects, stats.connectMillis, stats.connectMaxMillis,
+    stats.writes ? (unsigned)(stats.writeTotalMillis / stats.writes) : 0, stats.writeMaxMillis);
+  DPRINTFLN("InfluxDB body bytes %llu, sent %llu (%u writes compressed, %u datagrams)",
+    (unsigned long long)stats.bodyBytes, (unsigned long long)stats.sentBytes, stats.compressed, stats.datagrams);
+  DPRINTFLN("Connectivity %s, failures %u, circuit opens %u, Retry-After max %u s",
+    Link::stateName(connectivity.state()), connectivity.stats().failures, connectivity.stats().opens,
+    connectivity.stats().retryAfterMax);
+  DPRINTF("Time in state (s):");
+  for (uint8_t state = 0; state < LINK_STATE_COUNT; state++)
+    DPRINTF(" %s %u", Link::stateName((LinkState)state), (unsigned)(connectivity.stateMillis((LinkState)state) / 1000));
+  DPRINTLN();
+  const TimeSyncStats& timeStats = timeSync.stats();
+  DPRINTFLN("Time syncs %u (failed %u), correction last/max %d/%u ms, round trip %u ms, drift %d ppb",
+    timeStats.syncs, timeStats.failures, timeStats.offsetMillis, timeStats.offsetMaxMillis,
+    timeStats.roundTripMillis, timeSync.state().driftPpb);
+  DPRINTFLN("Report on change: samples sent %u (skipped %u), fields sent %u (suppressed %u)",
+    reportStats.samplesSent, reportStats.samplesSuppressed, reportStats.fieldsSent, reportStats.fieldsSuppressed);
+  #ifdef USE_SAMPLE_LOG
+  const RecordLogStats& logStats = sampleLog.stats();
+  DPRINTFLN("Sample log %u pending in %u/%u segments, lag %u s, logged %u (%u pages), replayed %u, dropped %u (damaged %u, untimed %u)",
+    (unsigned)sampleLog.pending(), sampleLog.segments(), sampleLog.capacity(), sampleLogLag(), logStats.appended,
+    logStats.pageWrites, logStats.consumed, logStats.dropped, logStats.corrupt, samplesUntimed);
+  #endif
+  return TASK_DONE;
+}
+#endif
+
+/***** Deep sleep *****/
+#ifdef USE_DEEP_SLEEP
+bool sleepWake() {
+  RtcHeader& header = rtcState.header;
+  // Read state, the first boot (or corrupted memory) starts with radio
+  if (!ESP.rtcUserMemoryRead(RTC_OFFSET, (uint32_t*)&rtcState, sizeof(rtcState)) ||
+      header.magic != RTC_MAGIC || header.count > RTC_SAMPLES ||
+      header.crc != crc32((uint8_t*)&rtcState + sizeof(header.crc), sizeof(rtcState) - sizeof(header.crc))) {
+    DPRINTLN_F("RTC memory is not valid, starting with radio.");
+    memset(&rtcState, 0, sizeof(rtcState));
+    header.magic = RTC_MAGIC;
+    header.batchSize = BATCH_SIZE;
+    header.batchMaxAge = BATCH_MAX_AGE;
+    header.radio = true;
+  }
+  header.wakes++;
+  // Continue with time from previous wake
+  millisOffset = header.clockMillis;
+  timeSync.setState(header.time);
+  report = header.report;
+  reportStats.samplesSuppressed = header.skipped;
+  samplesDropped = header.dropped;
+  for (uint16_t i = 0; i < header.count; i++) {
+    samples.push(rtcState.samples[i]);
+  }
+  DPRINTFLN("Wake %u, %u samples stored, last wake took %u ms, radio %s", header.wakes, header.count, header.awakeMillis, header.radio ? "on" : "off");
+  return header.radio;
+}
+
+void sleepEnd() {
+  RtcHeader& header = rtcState.header;
+  // Radio is needed in next wake when batch will be complete or too old
+  size_t flushCount = min((size_t)header.batchSize, RTC_SAMPLES);
+  bool radio = samples.size() + 1 >= flushCount;
+  if (!samples.empty() && millis64() + LOOP_INTERVAL - samples.front().timestamp >= (uint64_t)header.batchMaxAge * 1000)
+    radio = true;
+  // Keep period, subtract time spent in this wake
+  uint32_t awake = millis();
+  sleepNow(awake < LOOP_INTERVAL ? LOOP_INTERVAL - awake : 1, radio);
+}
+
+void sleepNow(uint32_t sleepMillis, bool radio) {
+  RtcHeader& header = rtcState.header;
+  // Keep the newest samples which fit into RTC memory
+  uint32_t trimmed = 0;
+  while (samples.size() > RTC_SAMPLES) {
+    samples.pop();
+    trimmed++;
+  }
+  header.count = samples.size();
+  for (uint16_t i = 0; i < header.count; i++) {
+    rtcState.samples[i] = samples.at(i);
+  }
+  header.dropped = samplesDropped + samples.overflows() + trimmed;
+  header.awakeMillis = millis();
+  header.clockMillis = millis64() + sleepMillis;
+  header.time = timeSync.state();
+  header.report = report;
+  header.skipped = reportStats.samplesSuppressed;
+  header.radio = radio;
+  header.crc = crc32((uint8_t*)&rtcState + sizeof(header.crc), sizeof(rtcState) - sizeof(header.crc));
+  ESP.rtcUserMemoryWrite(RTC_OFFSET, (uint32_t*)&rtcState, sizeof(rtcState));
+  DPRINTFLN("Sleeping %u ms after %u ms awake, next wake radio %s", sleepMillis, header.awakeMillis, radio ? "on" : "off");
+  ESP.deepSleep((uint64_t)sleepMillis * 1000, radio ? RF_DEFAULT : RF_DISABLED);
+}
+#endif
+
+/***** Sensors *****/
+void sensorsBegin() {
+  sensors.each([](auto& sensor, const SensorSlot& slot) { sensor.begin(slot); });
+}
+
+uint32_t sampleStart(Sample& sample) {
+  uint32_t wait = 0;
+
+  // Set acquisition time
+  sample.timestamp = millis64();
+
+  // Add device data (signal strength only when connected)
+  if (WiFi.status() == WL_CONNECTED)
+    sample.set(FIELD_RSSI, WiFi.RSSI());
+  #ifdef USE_DEEP_SLEEP
+  if (rtcState.header.awakeMillis > 0)
+    sample.set(FIELD_AWAKE, rtcState.header.awakeMillis);
+  #endif
+
+  // Start conversions, sensors without conversion are read here
+  sensors.acquire([&](auto& sensor, const SensorSlot& slot) {
+    wait = max(wait, sensor.start(sample, slot));
+  });
+  return wait;
+}
+
+bool sampleCollect(Sample& sample) {
+  sensors.acquire([&](auto& sensor, const SensorSlot& slot) { sensor.collect(sample, slot); });
+
+  DPRINTFLN("Sample acquired in %u ms", (unsigned)(millis64() - sample.timestamp));
+  // Are there any sensor data to save?
+  return (sample.valid & ~DEVICE_FIELDS) != 0;
+}
+
+#ifdef USE_DHT_SENSOR
+void DhtSensor::begin(const SensorSlot& slot) {
+  // Initialize DHT sensor line, reads run in background
+  _reader.begin();
+}
+
+uint32_t DhtSensor::start(Sample& sample, const SensorSlot& slot) {
+  // Start pulse is ended by timer and the frame is taken by interrupt, nothing blocks
+  // Sensor readings may be up to 2 seconds 'old', closer reads keep the last values
+  return _reader.start() ? _reader.readTime() : 0;
+}
+
+void DhtSensor::collect(Sample& sample, const SensorSlot& slot) {
+  DPRINTF("Reading DHT%i sensor ... ", DHT_TYPE);
+  uint32_t dhtStart = micros();
+  DhtStatus status = _reader.poll();
+  if (status != DHT_OK) {
+    TELEMETRY_STAGE(STAGE_SENSORS + slot.index, dhtStart);
+    DPRINTFLN("Failed to read from DHT%i sensor on pin %i (%s)", DHT_TYPE, DHT_PIN, DhtReader::statusName(status));
     BLINK(ERROR_READ);
+    return;
   }
-  else {
-    DPRINTLN_F("OK");
-    // Add sensor data (only not NaN)
-    if (!isnan(dhtT))
-      pointDevice.addField(dhtFieldTemperature, dhtT);
-    if (!isnan(dhtH))
-      pointDevice.addField(dhtFieldHumidity, dhtH);
-    // There are some data to write to
-    saveToInflux = true; 
-    #ifndef DHT_NO_HEATINDEX
-    // Compute heat index in Celsius (isFahreheit = false)
-    float hic = dht.computeHeatIndex(dhtT, dhtH, false);
-    pointDevice.addField(DHT_FIELD_HEATINDEX, hic);
-    #endif
-    #ifndef DHT_NO_DEWPOINT
-    // Compute dew point 
-    float dp =  243.04 * (log(dhtH / 100.0) + ((17.625 * dhtT) / (243.04 + dhtT))) / (17.625 - log(dhtH / 100.0) - ((17.625 * dhtT) / (243.04 + dhtT)));
-    pointDevice.addField(DHT_FIELD_DEWPOINT, dp);
-    #endif
-  }  
+  float dhtT = _reader.temperature();
+  float dhtH = _reader.humidity();
+  sample.set(slot.field + TEMPERATURE, dhtT);
+  sample.set(slot.field + HUMIDITY, dhtH);
+  // Derived values in fixed point (Derived.h)
+  #ifndef DHT_NO_HEATINDEX
+  sample.set(slot.field + HEATINDEX, heatIndex(dhtT, dhtH));
+  #endif
+  #ifndef DHT_NO_DEWPOINT
+  sample.set(slot.field + DEWPOINT, dewPoint(dhtT, dhtH));
   #endif
+  #ifndef DHT_NO_ABSHUMIDITY
+  sample.set(slot.field + ABSHUMIDITY, absoluteHumidity(dhtT, dhtH));
+  #endif
+  // Frame decode and derived values
+  TELEMETRY_STAGE(STAGE_SENSORS + slot.index, dhtStart);
+  DPRINTLN_F("OK");
+}
 
-  #ifdef USE_BMP280_SENSOR 
+void DhtSensor::line(const Sample& sample, const SensorSlot& slot) {
+  sampleField(sample, slot.field + TEMPERATURE, sensorSettings[slot.channel + TEMPERATURE].name);
+  sampleField(sample, slot.field + HUMIDITY, sensorSettings[slot.channel + HUMIDITY].name);
+  #ifndef DHT_NO_HEATINDEX
+  sampleField(sample, slot.field + HEATINDEX, DHT_FIELD_HEATINDEX);
+  #endif
+  #ifndef DHT_NO_DEWPOINT
+  sampleField(sample, slot.field + DEWPOINT, DHT_FIELD_DEWPOINT);
+  #endif
+  #ifndef DHT_NO_ABSHUMIDITY
+  sampleField(sample, slot.field + ABSHUMIDITY, DHT_FIELD_ABSHUMIDITY);
+  #endif
+}
+#endif
+
+#ifdef USE_BMP280_SENSOR
+void Bmp280Sensor::begin(const SensorSlot& slot) {
+  if (!_bmp280.begin(BMP280_I2C_ADDRESS)) { 
+    DPRINTLN_F("Could not find a valid BMP280 sensor, check wiring!");
+    fail(FAIL_I2C);
+  }
+  // Sleep between forced conversions
+  _bmp280.setSampling(Adafruit_BMP280::MODE_SLEEP, BMP280_SAMPLING_TEMPERATURE, BMP280_SAMPLING_PRESSURE,
+    Adafruit_BMP280::FILTER_OFF, Adafruit_BMP280::STANDBY_MS_1);
+}
+
+uint32_t Bmp280Sensor::start(Sample& sample, const SensorSlot& slot) {
+  // Writing forced mode starts one conversion
+  _bmp280.setSampling(Adafruit_BMP280::MODE_FORCED, BMP280_SAMPLING_TEMPERATURE, BMP280_SAMPLING_PRESSURE,
+    Adafruit_BMP280::FILTER_OFF, Adafruit_BMP280::STANDBY_MS_1);
+  return BMP280_CONVERSION_TIME;
+}
+
+void Bmp280Sensor::collect(Sample& sample, const SensorSlot& slot) {
   DPRINT_F("Reading BMP280 sensor ... ");
-  // Read pressure
-  float bmp280P = bmp280.readPressure();
+  // Read pressure (forced conversion is complete)
+  uint32_t bmp280Start = micros();
+  float bmp280P = _bmp280.readPressure();
   #ifndef BMP280_NO_TEMPERATURE
   // Read temperature
-  float bmp280T = bmp280.readTemperature();
+  float bmp280T = _bmp280.readTemperature();
+  TELEMETRY_STAGE(STAGE_SENSORS + slot.index, bmp280Start);
   // Check if any reads failed and exit early (to try again).
   if (isnan(bmp280P) || isnan(bmp280T)) {
   #else
+  TELEMETRY_STAGE(STAGE_SENSORS + slot.index, bmp280Start);
   if (isnan(bmp280P)) {
   #endif
     DPRINTLN_F("Failed to read from BMP280 sensor");
@@ -269,62 +693,680 @@ void loop() {
     DPRINTLN_F("OK");
     // Add sensor data (only not NaN)
     if (!isnan(bmp280P))
-      pointDevice.addField(bmp280FieldPressure, bmp280P);
+      sample.set(slot.field + PRESSURE, bmp280P);
     #ifndef BMP280_NO_TEMPERATURE
     if (!isnan(bmp280T))
-      pointDevice.addField(bmp280FieldTemperature, bmp280T);
+      sample.set(slot.field + TEMPERATURE, bmp280T);
+    #endif
+    // Derived values in fixed point (Derived.h)
+    #ifdef BMP280_ALTITUDE
+    sample.set(slot.field + SEALEVEL, seaLevelPressure(bmp280P, BMP280_ALTITUDE));
+    #endif
+    #ifdef BMP280_SEALEVEL_PRESSURE
+    sample.set(slot.field + ALTITUDE, altitude(bmp280P, BMP280_SEALEVEL_PRESSURE));
     #endif
-    // There are some data to write to
-    saveToInflux = true; 
   }
+}
+
+void Bmp280Sensor::line(const Sample& sample, const SensorSlot& slot) {
+  sampleField(sample, slot.field + PRESSURE, sensorSettings[slot.channel + channel(PRESSURE)].name);
+  #ifndef BMP280_NO_TEMPERATURE
+  sampleField(sample, slot.field + TEMPERATURE, sensorSettings[slot.channel + channel(TEMPERATURE)].name);
+  #endif
+  #ifdef BMP280_ALTITUDE
+  sampleField(sample, slot.field + SEALEVEL, BMP280_FIELD_SEALEVEL);
+  #endif
+  #ifdef BMP280_SEALEVEL_PRESSURE
+  sampleField(sample, slot.field + ALTITUDE, BMP280_FIELD_ALTITUDE);
   #endif
+}
+#endif
 
-  #ifdef USE_DS18B20_SENSOR  
-  DPRINT_F("Reading DS18B20 sensor ... ");
-  // Send the command to get temperatures
-  if (dallas.requestTemperatures()) {
+#ifdef USE_BME280_SENSOR
+void Bme280Sensor::begin(const SensorSlot& slot) {
+  if (!_bme280.begin(BME280_I2C_ADDRESS)) { 
+    DPRINTLN_F("Could not find a valid BME280 sensor, check wiring!");
+    fail(FAIL_I2C);
+  }
+  // Sleep between forced conversions
+  _bme280.setSampling(Adafruit_BME280::MODE_SLEEP, BME280_SAMPLING_TEMPERATURE, BME280_SAMPLING_PRESSURE,
+    BME280_SAMPLING_HUMIDITY, Adafruit_BME280::FILTER_OFF, Adafruit_BME280::STANDBY_MS_0_5);
+}
+
+uint32_t Bme280Sensor::start(Sample& sample, const SensorSlot& slot) {
+  // Writing forced mode starts one conversion
+  _bme280.setSampling(Adafruit_BME280::MODE_FORCED, BME280_SAMPLING_TEMPERATURE, BME280_SAMPLING_PRESSURE,
+    BME280_SAMPLING_HUMIDITY, Adafruit_BME280::FILTER_OFF, Adafruit_BME280::STANDBY_MS_0_5);
+  return BME280_CONVERSION_TIME;
+}
+
+void Bme280Sensor::collect(Sample& sample, const SensorSlot& slot) {
+  DPRINT_F("Reading BME280 sensor ... ");
+  // Read all values (forced conversion is complete), temperature first for compensation
+  uint32_t bme280Start = micros();
+  float bme280T = _bme280.readTemperature();
+  float bme280H = _bme280.readHumidity();
+  float bme280P = _bme280.readPressure();
+  TELEMETRY_STAGE(STAGE_SENSORS + slot.index, bme280Start);
+  if (isnan(bme280T) || isnan(bme280H) || isnan(bme280P)) {
+    DPRINTLN_F("Failed to read from BME280 sensor");
+    BLINK(ERROR_READ);
+  }
+  else {
     DPRINTLN_F("OK");
-    float dsTemp;
-    if (dsCount == 1) {
-      dsTemp = dallas.getTempCByIndex(0);
-      pointDevice.addField(ds18b20FieldTemperature, dsTemp);
-    }
-    else {
-      char fieldName[25];
-      for (uint8_t i = 0; i < dsCount; i++) {
-        dsTemp = dallas.getTempCByIndex(0);        
-        sprintf(fieldName, "%s_%i", ds18b20FieldTemperature, i);
-        pointDevice.addField(fieldName, dsTemp);
+  }
+  // Add sensor data (only not NaN)
+  if (!isnan(bme280T))
+    sample.set(slot.field + TEMPERATURE, bme280T);
+  if (!isnan(bme280H))
+    sample.set(slot.field + HUMIDITY, bme280H);
+  if (!isnan(bme280P))
+    sample.set(slot.field + PRESSURE, bme280P);
+}
+
+void Bme280Sensor::line(const Sample& sample, const SensorSlot& slot) {
+  sampleField(sample, slot.field + TEMPERATURE, sensorSettings[slot.channel + TEMPERATURE].name);
+  sampleField(sample, slot.field + HUMIDITY, sensorSettings[slot.channel + HUMIDITY].name);
+  sampleField(sample, slot.field + PRESSURE, sensorSettings[slot.channel + PRESSURE].name);
+}
+#endif
+
+#ifdef USE_DS18B20_SENSOR
+void Ds18b20Sensor::begin(const SensorSlot& slot) {
+  // Conversion is started by requestTemperatures() and collected later
+  _dallas.setWaitForConversion(false);
+  // Known addresses, no search (DallasTemperature::begin() searches the bus on every start)
+  if (!loadDevices() || _devices.search)
+    searchBus();
+  else if (_devices.parasite)
+    _dallas.begin();                        // Library holds the bus powered during conversion only after begin()
+  if (_devices.count == 0) {
+    DPRINTLN_F("Could not find any DS18B20 sensor, check wiring!");
+    fail(FAIL_DALLAS);
+  }
+  writeResolution();
+}
+
+void Ds18b20Sensor::writeResolution() {
+  // Resolution is kept in device EEPROM, written only when changed
+  if (_devices.resolution != DS18B20_RESOLUTION) {
+    for (uint8_t i = 0; i < _devices.count; i++)
+      _dallas.setResolution(_devices.addresses[i], DS18B20_RESOLUTION, true);
+    _devices.resolution = DS18B20_RESOLUTION;
+    saveDevices();
+  }
+}
+
+bool Ds18b20Sensor::loadDevices() {
+  if (!LittleFS.begin())
+    return false;
+  File cacheFile = LittleFS.open(DS18B20_CACHE_FILE, "r");
+  if (!cacheFile)
+    return false;
+  size_t length = cacheFile.read((uint8_t*)&_devices, sizeof(_devices));
+  cacheFile.close();
+  if (length != sizeof(_devices) || _devices.count == 0 || _devices.count > DS18B20_MAX_DEVICES ||
+      _devices.crc != crc32((uint8_t*)&_devices + sizeof(_devices.crc), sizeof(_devices) - sizeof(_devices.crc))) {
+    DPRINTLN_F("DS18B20 cache " DS18B20_CACHE_FILE " is not valid.");
+    memset(&_devices, 0, sizeof(_devices));
+    return false;
+  }
+  DPRINTFLN("DS18B20 %i devices from cache", _devices.count);
+  return true;
+}
+
+void Ds18b20Sensor::searchBus() {
+  DPRINT_F("Searching DS18B20 bus ... ");
+  uint32_t scanStart = micros();
+  // One search pass, index lookups would search the bus again for every device
+  DeviceAddress bus[DS18B20_MAX_DEVICES];
+  DeviceAddress address;
+  uint8_t present = 0;
+  _oneWire.reset_search();
+  while (_oneWire.search(address)) {
+    if (!_dallas.validAddress(address) || !_dallas.validFamily(address))
+      continue;
+    if (present < DS18B20_MAX_DEVICES)
+      memcpy(bus[present], address, sizeof(address));
+    present++;
+  }
+  uint8_t count = min(present, (uint8_t)DS18B20_MAX_DEVICES);
+  // Devices still present keep their order, new devices follow in search order
+  Ds18b20Cache found = {};
+  for (uint8_t i = 0; i < _devices.count; i++)
+    for (uint8_t j = 0; j < count; j++)
+      if (memcmp(bus[j], _devices.addresses[i], sizeof(DeviceAddress)) == 0) {
+        memcpy(found.addresses[found.count++], bus[j], sizeof(DeviceAddress));
+        bus[j][0] = 0;                      // Used, family code is never 0
+        break;
       }
+  for (uint8_t j = 0; j < count; j++)
+    if (bus[j][0] != 0)
+      memcpy(found.addresses[found.count++], bus[j], sizeof(DeviceAddress));
+  // Parasite powered devices need the bus held high during conversion
+  found.parasite = count > 0 && _dallas.readPowerSupply();
+  // Resolution is written to all devices found
+  _devices = found;
+  TELEMETRY_STAGE(STAGE_BUS_SCAN, scanStart);
+  DPRINTFLN("%i devices in %lu us", present, (unsigned long)(micros() - scanStart));
+  if (present > DS18B20_MAX_DEVICES) {
+    DPRINTFLN("Only first %i DS18B20 devices are used", DS18B20_MAX_DEVICES);
+  }
+  if (found.parasite) {
+    DPRINTLN_F("DS18B20 parasite power detected");
+    _dallas.begin();
+  }
+}
+
+void Ds18b20Sensor::saveDevices() {
+  _devices.crc = crc32((uint8_t*)&_devices + sizeof(_devices.crc), sizeof(_devices) - sizeof(_devices.crc));
+  DPRINT_F("Saving " DS18B20_CACHE_FILE "...");
+  File cacheFile = LittleFS.open(DS18B20_CACHE_FILE, "w");
+  if (!cacheFile || cacheFile.write((const uint8_t*)&_devices, sizeof(_devices)) != sizeof(_devices)) {
+    // Not fatal, next start searches the bus
+    DPRINTLN_F("Failed!");
+    return;
+  }
+  cacheFile.close();
+  DPRINTLN_F("OK");
+}
+
+uint32_t Ds18b20Sensor::start(Sample& sample, const SensorSlot& slot) {
+  // Device failed to read last time, replaced device gets the resolution too
+  if (_devices.search) {
+    searchBus();
+    if (_devices.count == 0) {
+      DPRINTLN_F("Could not find any DS18B20 sensor, check wiring!");
+      _devices.search = true;               // Search again by the next start
+      BLINK(ERROR_READ);
+      return 0;
     }
+    writeResolution();
   }
-  else {
-    DPRINTLN_F("Failed to request temperature from DS18B20 sensors");
-    BLINK(ERROR_READ);
+  // Send the command to start conversion, do not wait for it
+  DPRINT_F("Starting DS18B20 conversion ... ");
+  if (_dallas.requestTemperatures()) {
+    DPRINTLN_F("OK");
+    _converting = true;
+    return _dallas.millisToWaitForConversion(_devices.resolution);
+  }
+  DPRINTLN_F("Failed to request temperature from DS18B20 sensors");
+  BLINK(ERROR_READ);
+  return 0;
+}
+
+void Ds18b20Sensor::collect(Sample& sample, const SensorSlot& slot) {
+  if (!_converting)
+    return;
+  DPRINT_F("Reading DS18B20 sensor ... ");
+  uint32_t dsStart = micros();
+  uint8_t failed = 0;
+  for (uint8_t i = 0; i < _devices.count; i++) {
+    // Read by address, no bus search
+    float dsTemp = _dallas.getTempC(_devices.addresses[i]);
+    if (dsTemp != DEVICE_DISCONNECTED_C)
+      sample.set(slot.field + i, dsTemp);
+    else
+      failed++;
+  }
+  TELEMETRY_STAGE(STAGE_SENSORS + slot.index, dsStart);
+  _converting = false;
+  if (failed == 0) {
+    DPRINTFLN("OK (%lu us)", (unsigned long)(micros() - dsStart));
+    return;
+  }
+  DPRINTFLN("Failed to read %i of %i DS18B20 devices", failed, _devices.count);
+  BLINK(ERROR_READ);
+  // Device removed or replaced, next start searches the bus
+  if (!_devices.search) {
+    _devices.search = true;
+    saveDevices();
   }
+}
+
+void Ds18b20Sensor::line(const Sample& sample, const SensorSlot& slot) {
+  const char* name = sensorSettings[slot.channel].name;
+  if (_devices.count == 1) {
+    sampleField(sample, slot.field, name);
+    return;
+  }
+  // Field name suffix is the device serial number (ROM without family and CRC, as Linux w1 names devices)
+  char fieldName[sizeof(SensorSetting::name) + 13];
+  for (uint8_t i = 0; i < _devices.count; i++) {
+    if (!sample.has(slot.field + i))
+      continue;
+    const uint8_t* rom = _devices.addresses[i];
+    snprintf(fieldName, sizeof(fieldName), "%s_%02x%02x%02x%02x%02x%02x", name, rom[6], rom[5], rom[4], rom[3], rom[2], rom[1]);
+    sampleField(sample, slot.field + i, fieldName);
+  }
+}
+#endif
+
+bool readSample(Sample& sample) {
+  delay(sampleStart(sample));
+  return sampleCollect(sample);
+}
+
+/***** Aggregation *****/
+#ifdef USE_AGGREGATION
+void aggregateAdd(const Sample& reading) {
+  for (uint8_t field = 0; field < FIELD_COUNT; field++) {
+    if (reading.has(field) && !(DEVICE_FIELDS & 1UL << field))
+      aggregates[field].add(reading.values[field]);
+  }
+}
+
+bool aggregateSample(Sample& sample) {
+  // Device fields and timestamp (window end) are kept from the last reading
+  sample.valid &= DEVICE_FIELDS;
+  for (uint8_t field = 0; field < FIELD_COUNT; field++) {
+    Aggregate& aggregate = aggregates[field];
+    if (aggregate.count() == 0)
+      continue;
+    sample.set(field, aggregate.mean());
+    #ifdef AGGREGATE_MIN
+    sample.minimum[field] = aggregate.minimum();
+    #endif
+    #ifdef AGGREGATE_MAX
+    sample.maximum[field] = aggregate.maximum();
+    #endif
+    #ifdef AGGREGATE_STDDEV
+    sample.stddev[field] = aggregate.stddev();
+    #endif
+    #ifdef AGGREGATE_COUNT
+    sample.count[field] = aggregate.count();
+    #endif
+    aggregate.clear();
+  }
+  return (sample.valid & ~DEVICE_FIELDS) != 0;
+}
+#endif
+
+/***** Report on change *****/
+void reportBegin() {
+  for (uint8_t field = 0; field < FIELD_COUNT; field++)
+    reportDeadband[field] = 0;
+  sensors.each([](auto& sensor, const SensorSlot& slot) {
+    for (uint8_t i = 0; i < sensor.FIELDS; i++)
+      reportDeadband[slot.field + i] = sensorSettings[slot.channel + sensor.channel(i)].deadband;
+  });
+}
+
+bool reportFilter(Sample& sample) {
+  // Heartbeat sends all fields, so the series stay continuous even without changes
+  bool heartbeat = report.valid == 0 ||
+    sample.timestamp - report.heartbeat >= (uint64_t)heartbeatInterval * 1000;
+  uint32_t sensors = sample.valid & ~DEVICE_FIELDS;
+  uint32_t changed = 0;
+  for (uint8_t field = FIELD_SENSORS; field < FIELD_COUNT; field++) {
+    uint32_t bit = 1UL << field;
+    if (!(sensors & bit))
+      continue;
+    // Compared with the last reported value, so slow drift is reported once it exceeds deadband
+    float& last = report.values[field - FIELD_SENSORS];
+    if (heartbeat || !(report.valid & bit) || reportDeadband[field] <= 0 ||
+        fabs(sample.values[field] - last) > reportDeadband[field]) {
+      changed |= bit;
+      last = sample.values[field];
+    }
+  }
+  reportStats.fieldsSent += __builtin_popcount(changed);
+  reportStats.fieldsSuppressed += __builtin_popcount(sensors & ~changed);
+  if (changed == 0) {
+    reportStats.samplesSuppressed++;
+    return false;
+  }
+  if (heartbeat)
+    report.heartbeat = sample.timestamp;
+  report.valid |= changed;
+  reportStats.samplesSent++;
+  // Device fields go with every written sample
+  sample.valid = (sample.valid & DEVICE_FIELDS) | changed;
+  return true;
+}
+
+/***** InfluxDB write *****/
+void encoderBegin() {
+  encoder.setMeasurement(measurementName);
+  encoder.addTag("device", deviceId);
+  encoder.addTag("SSID", WiFi.SSID().c_str());
+  encoder.addTag("location", location);
+  #ifdef USE_TELEMETRY
+  telemetryEncoder.setMeasurement(TELEMETRY_MEASUREMENT);
+  telemetryEncoder.addTag("device", deviceId);
+  telemetryEncoder.addTag("SSID", WiFi.SSID().c_str());
+  telemetryEncoder.addTag("location", location);
+  #endif
+}
+
+bool sampleLine(const Sample& sample, uint64_t timestamp) {
+  encoder.beginLine();
+
+  // Add device data
+  if (sample.has(FIELD_RSSI))
+    encoder.addField("rssi", (int32_t)sample.values[FIELD_RSSI]);
+  #ifdef USE_DEEP_SLEEP
+  if (sample.has(FIELD_AWAKE))
+    encoder.addField("awake", (uint32_t)sample.values[FIELD_AWAKE]);
+  #endif
+  encoder.addField("uptime", sample.timestamp);
+  encoder.addField("pending", (uint32_t)(samples.size() + SAMPLE_LOG_PENDING()));
+  encoder.addField("dropped", (uint32_t)(samplesDropped + samples.overflows() + SAMPLE_LOG_DROPPED()));
+  encoder.addField("skipped", reportStats.samplesSuppressed);
+
+  sensors.each([&](auto& sensor, const SensorSlot& slot) { sensor.line(sample, slot); });
+
+  return encoder.endLine(timestamp);
+}
+
+void sampleField(const Sample& sample, uint8_t field, const char* name) {
+  if (!sample.has(field))
+    return;
+  encoder.addField(name, sample.values[field], FIELD_DECIMALS);
+  #ifdef USE_AGGREGATION
+  // Statistics are sent as <name>_min, <name>_max, <name>_sd and <name>_n
+  char statName[32];
+  #ifdef AGGREGATE_MIN
+  snprintf(statName, sizeof(statName), "%s_min", name);
+  encoder.addField(statName, sample.minimum[field], FIELD_DECIMALS);
+  #endif
+  #ifdef AGGREGATE_MAX
+  snprintf(statName, sizeof(statName), "%s_max", name);
+  encoder.addField(statName, sample.maximum[field], FIELD_DECIMALS);
+  #endif
+  #ifdef AGGREGATE_STDDEV
+  snprintf(statName, sizeof(statName), "%s_sd", name);
+  encoder.addField(statName, sample.stddev[field], FIELD_DECIMALS);
   #endif
+  #ifdef AGGREGATE_COUNT
+  snprintf(statName, sizeof(statName), "%s_n", name);
+  encoder.addField(statName, (uint32_t)sample.count[field]);
+  #endif
+  #endif
+}
+
+bool batchDue() {
+  if (samples.empty())
+    return false;
+  return samples.size() >= batchSize || samples.full() ||
+    millis64() - samples.front().timestamp >= (uint64_t)batchMaxAge * 1000;
+}
 
-  // Write data
-  if (saveToInflux) {
-    DPRINT_F("InfluxDB writing: ");
-    DPRINTLN(pointDevice.toLineProtocol()); 
-    if (!client.writePoint(pointDevice)) {
-      // Cannot write data
+uint64_t clockTime(uint64_t monotonic) {
+  // Mapped to Unix time with the current drift estimate
+  return precisionTime(timeSync.epochMillis(monotonic));
+}
+
+uint64_t precisionTime(uint64_t epochMillis) {
+  return strcmp(timePrecision, "ms") == 0 ? epochMillis : epochMillis / 1000;
+}
+
+uint64_t sampleTime(const Sample& sample) {
+  // Acquisition time
+  return clockTime(sample.timestamp);
+}
+
+bool flushSamples() {
+  while (!samples.empty()) {
+    // Samples carry own timestamp only with synchronized clock, otherwise server time is used
+    // and batching would put several samples to the same time - write them one by one
+    bool timestamped = timeSync.synced();
+    size_t limit = timestamped ? batchSize : 1;
+    size_t count = 0;
+    uint32_t encodeStart = micros();
+    encoder.clear();
+    while (count < limit && count < samples.size()) {
+      const Sample& sample = samples.at(count);
+      // Stop when the line does not fit into write buffer
+      if (!sampleLine(sample, sampleTime(sample)))
+        break;
+      count++;
+    }
+    if (count == 0) {
+      DPRINTLN_F("Sample does not fit into write buffer, dropped.");
+      samples.pop();
+      continue;
+    }
+
+    TELEMETRY_STAGE(STAGE_ENCODE, encodeStart);
+
+    DPRINTF("InfluxDB writing %u samples:\n", (unsigned)count);
+    DPRINTLN(batchBody);
+    uint32_t connects = writer.stats().connects;
+    uint64_t sentBytes = writer.stats().sentBytes;
+    uint32_t writeStart = micros();
+    bool written = writer.write(batchBody, encoder.length());
+    TELEMETRY_STAGE(STAGE_WRITE, writeStart);
+    connectivityResult(written);
+    if (!written) {
+      // Cannot write data, keep it for next loop
+      TELEMETRY_ERROR(writer.lastStatus());
       DPRINT_F("InfluxDB write failed: ");
-      DPRINTLN(client.getLastErrorMessage());
-      BLINK(ERROR_WRITE);
+      DPRINTLN(writer.lastError());
+      return false;
     }
+    DPRINTFLN("InfluxDB write of %u samples (%u bytes, %u sent) took %u ms, %s connection", (unsigned)count, (unsigned)encoder.length(),
+      (unsigned)(writer.stats().sentBytes - sentBytes), (unsigned)writer.stats().writeMillis,
+      writer.datagrams() ? "no" : writer.stats().connects != connects ? "new" : "reused");
+    for (size_t i = 0; i < count; i++)
+      samples.pop();
   }
-  else {
-    DPRINTLN_F("No data to write to InfluxDB.");
+  return true;
+}
+
+void connectivityResult(bool written) {
+  if (written) {
+    connectivity.success();
+    return;
+  }
+  // Server is up but overloaded, other failures (no connection, timeout, errors) back off the same way
+  int status = writer.lastStatus();
+  connectivity.failure(status == 429 || status == 503, writer.retryAfter());
+  DPRINTFLN("Connectivity %s after %u failures, next write in %u ms", Link::stateName(connectivity.state()),
+    connectivity.failures(), connectivity.wait());
+}
+
+/***** Sample log *****/
+#ifdef USE_SAMPLE_LOG
+void sampleLogSpill() {
+  // One full page of the oldest samples, the buffer keeps the newest ones
+  LoggedSample records[SAMPLE_LOG_PAGE_RECORDS];
+  memset(records, 0, sizeof(records));
+  size_t count = min((size_t)SAMPLE_LOG_PAGE_RECORDS, samples.size());
+  for (size_t i = 0; i < count; i++) {
+    records[i].sample = samples.at(i);
+    records[i].epochMillis = timeSync.epochMillis(records[i].sample.timestamp);
+    records[i].boot = bootId;
+  }
+  if (!sampleLog.append(records, count)) {
+    DPRINTLN_F("Sample log write failed, the oldest sample is dropped.");
+    return;
+  }
+  for (size_t i = 0; i < count; i++)
+    samples.pop();
+  DPRINTFLN("%u samples moved to log, %u logged in %u segments", (unsigned)count, (unsigned)sampleLog.pending(),
+    sampleLog.segments());
+}
+
+uint64_t loggedTime(const LoggedSample& logged) {
+  if (logged.epochMillis)
+    return logged.epochMillis;
+  // Logged before time synchronization, monotonic time can be mapped in the same boot only
+  return logged.boot == bootId ? timeSync.epochMillis(logged.sample.timestamp) : 0;
+}
+
+uint32_t sampleLogLag() {
+  LoggedSample logged;
+  sampleLog.rewind();
+  if (!timeSync.synced() || !sampleLog.next(&logged))
+    return 0;
+  uint64_t time = loggedTime(logged);
+  uint64_t now = timeSync.epochMillis(millis64());
+  return time && now > time ? (uint32_t)((now - time) / 1000) : 0;
+}
+
+uint32_t replayTask() {
+  // Live samples go first, logged ones are written with own timestamps only
+  if (sampleLog.pending() == 0 || batchDue() || !timeSync.synced() ||
+      WiFi.status() != WL_CONNECTED || !connectivity.ready()) {
+    return TASK_DONE;
+  }
+  // At most SAMPLE_LOG_REPLAY_RATE samples per run (every second), as many as fit into one write body
+  LoggedSample logged;
+  uint16_t read = 0;
+  uint16_t lines = 0;
+  uint32_t encodeStart = micros();
+  encoder.clear();
+  sampleLog.rewind();
+  while (read < SAMPLE_LOG_REPLAY_RATE && sampleLog.next(&logged)) {
+    uint64_t time = loggedTime(logged);
+    if (time == 0) {
+      // Not synchronized time of previous boot, the sample cannot be placed in time
+      samplesUntimed++;
+      read++;
+      continue;
+    }
+    if (!sampleLine(logged.sample, precisionTime(time))) {
+      if (lines == 0) {
+        DPRINTLN_F("Logged sample does not fit into write buffer, dropped.");
+        read++;
+      }
+      break;
+    }
+    read++;
+    lines++;
+  }
+  if (lines == 0) {
+    sampleLog.consume(read);
+    return TASK_DONE;
+  }
+
+  TELEMETRY_STAGE(STAGE_ENCODE, encodeStart);
+
+  uint32_t writeStart = micros();
+  bool written = writer.write(batchBody, encoder.length());
+  TELEMETRY_STAGE(STAGE_WRITE, writeStart);
+  connectivityResult(written);
+  if (!written) {
+    // Logged samples stay in the log
+    TELEMETRY_ERROR(writer.lastStatus());
+    DPRINT_F("InfluxDB write of logged samples failed: ");
+    DPRINTLN(writer.lastError());
+    return TASK_DONE;
+  }
+  sampleLog.consume(read);
+  DPRINTFLN("InfluxDB write of %u logged samples took %u ms, %u left", lines, (unsigned)writer.stats().writeMillis,
+    (unsigned)sampleLog.pending());
+  return TASK_DONE;
+}
+#endif
+
+/***** Telemetry *****/
+#ifdef USE_TELEMETRY
+void telemetryStage(uint8_t stage, uint32_t startMicros) {
+  uint32_t duration = micros() - startMicros;
+  telemetry.lastMicros[stage] = duration;
+  if (duration > telemetry.maxMicros[stage])
+    telemetry.maxMicros[stage] = duration;
+  // Heap is lowest around stages (TLS buffers during write)
+  uint32_t heap = ESP.getFreeHeap();
+  if (telemetry.heapMin == 0 || heap < telemetry.heapMin)
+    telemetry.heapMin = heap;
+}
+
+void telemetryError(int status) {
+  telemetry.writeFailures++;
+  switch (status) {
+  case INFLUX_ERROR_INVALID_URL:
+    telemetry.lastError = WRITE_ERROR_CONFIG;
+    break;
+  case INFLUX_ERROR_CONNECTION_REFUSED:
+    telemetry.lastError = WRITE_ERROR_CONNECT;
+    break;
+  case INFLUX_ERROR_READ_TIMEOUT:
+    telemetry.lastError = WRITE_ERROR_TIMEOUT;
+    break;
+  case 401:
+  case 403:
+    telemetry.lastError = WRITE_ERROR_AUTH;
+    break;
+  case 429:
+    telemetry.lastError = WRITE_ERROR_THROTTLED;
+    break;
+  default:
+    if (status >= 500)
+      telemetry.lastError = WRITE_ERROR_SERVER;
+    else if (status >= 400)
+      telemetry.lastError = WRITE_ERROR_REQUEST;
+    else
+      telemetry.lastError = WRITE_ERROR_NETWORK;
   }
+}
 
-  delay(LOOP_INTERVAL);
+bool telemetryLine() {
+  // Field name prefixes of TelemetryStage, sensor stages are named by sensor
+  const char* stageNames[STAGE_COUNT];
+  sensors.each([&](auto& sensor, const SensorSlot& slot) { stageNames[STAGE_SENSORS + slot.index] = sensor.ID; });
+  stageNames[STAGE_ENCODE] = "encode";
+  stageNames[STAGE_WRITE] = "write";
+  stageNames[STAGE_RECONNECT] = "reconnect";
+  stageNames[STAGE_BUS_SCAN] = "ds18b20_scan";
+  telemetry.overruns = 0;
+  for (size_t id = 0; id < scheduler.size(); id++)
+    telemetry.overruns += scheduler.task(id).overruns;
+
+  telemetryEncoder.clear();
+  telemetryEncoder.beginLine();
+  telemetryEncoder.addField("uptime", millis64());
+  telemetryEncoder.addField("config_ms", configMillis);
+  telemetryEncoder.addField("wifi_ms", wifiMillis);
+  telemetryEncoder.addField("first_byte_ms", firstByteMillis);
+  telemetryEncoder.addField("wifi_fast", (uint32_t)wifiFast);
+  telemetryEncoder.addField("heap_free", ESP.getFreeHeap());
+  telemetryEncoder.addField("heap_block", ESP.getMaxFreeBlockSize());
+  telemetryEncoder.addField("heap_frag", (uint32_t)ESP.getHeapFragmentation());
+  if (telemetry.heapMin > 0)
+    telemetryEncoder.addField("heap_min", telemetry.heapMin);
+  telemetryEncoder.addField("overruns", telemetry.overruns);
+  telemetryEncoder.addField("reconnects", telemetry.reconnects);
+  telemetryEncoder.addField("write_failures", telemetry.writeFailures);
+  telemetryEncoder.addField("write_error", (uint32_t)telemetry.lastError);
+  telemetryEncoder.addField("link_state", (uint32_t)connectivity.state());
+  telemetryEncoder.addField("circuit_opens", connectivity.stats().opens);
+  #ifdef USE_SAMPLE_LOG
+  telemetryEncoder.addField("log_pending", sampleLog.pending());
+  telemetryEncoder.addField("log_segments", (uint32_t)sampleLog.segments());
+  telemetryEncoder.addField("log_lag_s", sampleLogLag());
+  telemetryEncoder.addField("log_dropped", sampleLog.stats().dropped);
+  telemetryEncoder.addField("log_damaged", sampleLog.stats().corrupt + samplesUntimed);
+  #endif
+  char fieldName[24];
+  for (uint8_t state = 0; state < LINK_STATE_COUNT; state++) {
+    snprintf(fieldName, sizeof(fieldName), "%s_ms", Link::stateName((LinkState)state));
+    telemetryEncoder.addField(fieldName, connectivity.stateMillis((LinkState)state));
+  }
+  for (uint8_t stage = 0; stage < STAGE_COUNT; stage++) {
+    // Stages which did not run yet are left out
+    if (telemetry.lastMicros[stage] == 0)
+      continue;
+    snprintf(fieldName, sizeof(fieldName), "%s_us", stageNames[stage]);
+    telemetryEncoder.addField(fieldName, telemetry.lastMicros[stage]);
+    if (telemetry.maxMicros[stage] > 0) {
+      snprintf(fieldName, sizeof(fieldName), "%s_max_us", stageNames[stage]);
+      telemetryEncoder.addField(fieldName, telemetry.maxMicros[stage]);
+    }
+  }
+  return telemetryEncoder.endLine(clockTime(millis64()));
 }
+#endif
 
 /***** LED blink *****/
 #ifdef USE_LED
 void blink(int count) {
+  blinkQueue.push(count);
+}
+
+void blinkWait(int count) {
   for (int i = 0; i < count; i++)
   {
     digitalWrite(LED_PIN, LED_ON); 
@@ -333,6 +1375,33 @@ void blink(int count) {
     delay(LED_INTERVAL);
   }
 }
+
+uint32_t ledTask() {
+  static uint8_t remaining = 0;             // Blinks left in current group
+  static uint8_t pause = 0;                 // Intervals left to the next group
+  static bool on = false;                   // LED is on
+  if (on) {
+    digitalWrite(LED_PIN, LED_OFF); 
+    on = false;
+    if (remaining == 0)
+      pause = LED_PAUSE;
+  }
+  else if (pause > 0) {
+    pause--;
+  }
+  else if (remaining > 0 || !blinkQueue.empty()) {
+    if (remaining == 0) {
+      remaining = blinkQueue.front();
+      blinkQueue.pop();
+    }
+    if (remaining > 0) {
+      digitalWrite(LED_PIN, LED_ON); 
+      on = true;
+      remaining--;
+    }
+  }
+  return TASK_DONE;
+}
 #endif
 
 // FAIL stop with blinking
@@ -340,7 +1409,7 @@ void fail(int count) {
   while (true)
   {
     #ifdef USE_LED
-    BLINK(count);    
+    blinkWait(count);    
     delay(2*LED_INTERVAL);
     #endif
   }  
@@ -352,7 +1421,7 @@ uint64_t millis64() {
     uint32_t new_low32 = millis();
     if (new_low32 < low32) high32++;
     low32 = new_low32;
-    return (uint64_t) high32 << 32 | low32;
+    return millisOffset + ((uint64_t) high32 << 32 | low32);
 }
 
 /***** Interrupt *****/
@@ -365,6 +1434,104 @@ void IRAM_ATTR interruptRestart()
 
 void saveConfigFile() {
   DPRINTLN_F("Saving configuration");
+  saveConfigRecord();
+  saveConfigJson();
+}
+
+bool loadConfigFile() {
+  // Read configuration from FS
+  DPRINT_F("Opening LittleFS...");
+  if (!LittleFS.begin()) {
+    DPRINTLN_F("Failed!");
+    fail(FAIL_FS);
+  }
+  DPRINTLN_F("OK");
+
+  uint32_t start = millis();
+  if (!loadConfigRecord()) {
+    // Older firmware or changed layout, JSON is migrated to binary record
+    if (!loadConfigJson())
+      return false;
+    saveConfigRecord();
+  }
+  configMillis = millis();
+  DPRINTFLN("Configuration loaded in %u ms, %u ms after boot", (unsigned)(configMillis - start), (unsigned)configMillis);
+  return true;
+}
+
+// Copy string to fixed record field, always terminated
+#define CONFIG_COPY(to, from) strlcpy(to, from, sizeof(to))
+
+void saveConfigRecord() {
+  ConfigRecord record;
+  memset(&record, 0, sizeof(record));
+  record.magic = CONFIG_MAGIC;
+  record.version = CONFIG_VERSION;
+  record.size = sizeof(record);
+  record.sensors = CONFIG_SENSORS;
+  record.batchSize = batchSize;
+  record.batchMaxAge = batchMaxAge;
+  record.heartbeatInterval = heartbeatInterval;
+  CONFIG_COPY(record.influxUrl, influxUrl);
+  CONFIG_COPY(record.influxOrg, influxOrg);
+  CONFIG_COPY(record.influxBucket, influxBucket);
+  CONFIG_COPY(record.influxToken, influxToken);
+  CONFIG_COPY(record.measurementName, measurementName);
+  CONFIG_COPY(record.location, location);
+  CONFIG_COPY(record.ntpServer1, ntpServer1);
+  CONFIG_COPY(record.ntpServer2, ntpServer2);
+  CONFIG_COPY(record.timePrecision, timePrecision);
+  for (uint8_t i = 0; i < Sensors::CHANNELS; i++) {
+    CONFIG_COPY(record.sensorSettings[i].name, sensorSettings[i].name);
+    record.sensorSettings[i].deadband = sensorSettings[i].deadband;
+  }
+  record.crc = crc32((uint8_t*)&record + sizeof(record.crc), sizeof(record) - sizeof(record.crc));
+
+  DPRINT_F("Saving " CONFIG_FILE "...");
+  File configFile = LittleFS.open(CONFIG_FILE, "w");
+  if (!configFile || configFile.write((const uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+    DPRINTLN_F("Failed!");
+    fail(FAIL_FS);
+  }
+  configFile.close();
+  DPRINTLN_F("OK");
+}
+
+bool loadConfigRecord() {
+  File configFile = LittleFS.open(CONFIG_FILE, "r");
+  if (!configFile) {
+    DPRINTLN_F("Configuration file " CONFIG_FILE " not found.");
+    return false;
+  }
+  ConfigRecord record;
+  size_t length = configFile.read((uint8_t*)&record, sizeof(record));
+  configFile.close();
+  if (length != sizeof(record) || record.magic != CONFIG_MAGIC || record.version != CONFIG_VERSION ||
+      record.size != sizeof(record) || record.sensors != CONFIG_SENSORS ||
+      record.crc != crc32((uint8_t*)&record + sizeof(record.crc), sizeof(record) - sizeof(record.crc))) {
+    DPRINTLN_F("Configuration file " CONFIG_FILE " is not valid.");
+    return false;
+  }
+  batchSize = constrain(record.batchSize, 1, SAMPLE_BUFFER_SIZE);
+  batchMaxAge = record.batchMaxAge;
+  heartbeatInterval = record.heartbeatInterval;
+  CONFIG_COPY(influxUrl, record.influxUrl);
+  CONFIG_COPY(influxOrg, record.influxOrg);
+  CONFIG_COPY(influxBucket, record.influxBucket);
+  CONFIG_COPY(influxToken, record.influxToken);
+  CONFIG_COPY(measurementName, record.measurementName);
+  CONFIG_COPY(location, record.location);
+  CONFIG_COPY(ntpServer1, record.ntpServer1);
+  CONFIG_COPY(ntpServer2, record.ntpServer2);
+  CONFIG_COPY(timePrecision, record.timePrecision);
+  for (uint8_t i = 0; i < Sensors::CHANNELS; i++) {
+    CONFIG_COPY(sensorSettings[i].name, record.sensorSettings[i].name);
+    sensorSettings[i].deadband = record.sensorSettings[i].deadband;
+  }
+  return true;
+}
+
+void saveConfigJson() {
   // Create a JSON document
   StaticJsonDocument<JSON_SIZE> json;
   json[JSON_INFLUXDB_URL] = influxUrl;
@@ -373,23 +1540,18 @@ void saveConfigFile() {
   json[JSON_INFLUXDB_BUCKET] = influxBucket;
   json[JSON_INFLUXDB_TOKEN] = influxToken;
   json[JSON_INFLUXDB_MEAS] = measurementName;
-  //json[JSON_NTP_SERVER_1] = ntpServer1;
-  //json[JSON_NTP_SERVER_2] = ntpServer2;
+  json[JSON_NTP_SERVER_1] = ntpServer1;
+  json[JSON_NTP_SERVER_2] = ntpServer2;
   //json[JSON_NTP_TZ] = ntpZone;  
+  json[JSON_TIME_PRECISION] = timePrecision;
   json[JSON_TAG_LOCATION] = location;  
-  #ifdef USE_DHT_SENSOR
-  json[JSON_DHT_TEMPERATURE] = dhtFieldTemperature;
-  json[JSON_DHT_HUMIDITY] = dhtFieldHumidity;
-  #endif
-  #ifdef USE_BMP280_SENSOR
-  #ifndef BMP280_NO_TEMPERATURE
-  json[JSON_BMP280_TEMPERATURE] = bmp280FieldTemperature;
-  #endif
-  json[JSON_BMP280_PRESSURE] = bmp280FieldPressure;
-  #endif
-  #ifdef USE_DS18B20_SENSOR
-  json[JSON_DS18B20_TEMPERATURE] = ds18b20FieldTemperature;
-  #endif
+  json[JSON_BATCH_SIZE] = batchSize;
+  json[JSON_BATCH_AGE] = batchMaxAge;
+  json[JSON_HEARTBEAT] = heartbeatInterval;
+  eachChannel([&](const SensorChannel& channel, SensorSetting& setting) {
+    json[channel.key] = setting.name;
+    json[channel.deadbandKey] = setting.deadband;
+  });
   // Open/create JSON file
   DPRINT_F("Opening " JSON_CONFIG_FILE "...");
   File configFile = LittleFS.open(JSON_CONFIG_FILE, "w");
@@ -400,7 +1562,7 @@ void saveConfigFile() {
   DPRINTLN_F("OK");
 
   // Serialize JSON data to file
-  DPRINT_F("Saving configuration...");
+  DPRINT_F("Saving JSON export...");
   if (serializeJson(json, configFile) == 0) {
     DPRINTLN_F("Failed!");
     fail(FAIL_FS);
@@ -411,15 +1573,7 @@ void saveConfigFile() {
   configFile.close();
 }
 
-bool loadConfigFile() {
-  // Read configuration from FS json
-  DPRINT_F("Opening LittleFS...");
-  if (!LittleFS.begin()) {
-    DPRINTLN_F("Failed!");
-    fail(FAIL_FS);
-  }
-  DPRINTLN_F("OK");
-
+bool loadConfigJson() {
   // Read existing file
   if (!LittleFS.exists(JSON_CONFIG_FILE)) {
     DPRINTLN_F("Configuration file " JSON_CONFIG_FILE " not found.");
@@ -448,27 +1602,101 @@ bool loadConfigFile() {
   strncpy(influxToken, json[JSON_INFLUXDB_TOKEN], sizeof(influxToken));
   strncpy(measurementName, json[JSON_INFLUXDB_MEAS] | INFLUXDB_MEASUREMENT, sizeof(measurementName));
   strncpy(location, json[JSON_TAG_LOCATION] | INFLUXDB_LOCATION, sizeof(location));
-  #ifdef USE_DHT_SENSOR
-  strncpy(dhtFieldTemperature, json[JSON_DHT_TEMPERATURE] | DHT_FIELD_TEMPERATURE, sizeof(dhtFieldTemperature));
-  strncpy(dhtFieldHumidity, json[JSON_DHT_HUMIDITY] | DHT_FIELD_HUMIDITY, sizeof(dhtFieldHumidity));
-  #endif
-  #ifdef USE_BMP280_SENSOR
-  #ifndef BMP280_NO_TEMPERATURE
-  strncpy(bmp280FieldTemperature, json[JSON_BMP280_TEMPERATURE] | BMP280_FIELD_TEMPERATURE, sizeof(bmp280FieldTemperature));
-  #endif
-  strncpy(bmp280FieldPressure, json[JSON_BMP280_PRESSURE] | BMP280_FIELD_PRESSURE, sizeof(bmp280FieldPressure));
-  #endif
-  #ifdef USE_DS18B20_SENSOR
-  strncpy(ds18b20FieldTemperature, json[JSON_DS18B20_TEMPERATURE] | DS18B20_FIELD_TEMPERATURE, sizeof(ds18b20FieldTemperature));  
-  #endif
-  //strcpy(ntpServer1, json[JSON_NTP_SERVER_1]);
-  //strcpy(ntpServer2, json[JSON_NTP_SERVER_2]);
+  batchSize = constrain(json[JSON_BATCH_SIZE] | BATCH_SIZE, 1, SAMPLE_BUFFER_SIZE);
+  batchMaxAge = json[JSON_BATCH_AGE] | BATCH_MAX_AGE;
+  heartbeatInterval = json[JSON_HEARTBEAT] | HEARTBEAT_INTERVAL;
+  eachChannel([&](const SensorChannel& channel, SensorSetting& setting) {
+    strncpy(setting.name, json[channel.key] | channel.name, sizeof(setting.name));
+    setting.deadband = json[channel.deadbandKey] | channel.deadband;
+  });
+  strncpy(ntpServer1, json[JSON_NTP_SERVER_1] | NTP_SERVER_1, sizeof(ntpServer1));
+  strncpy(ntpServer2, json[JSON_NTP_SERVER_2] | NTP_SERVER_2, sizeof(ntpServer2));
   //strcpy(ntpZone, json[JSON_NTP_TZ]);
+  strcpy(timePrecision, strcmp(json[JSON_TIME_PRECISION] | TIME_PRECISION, "ms") == 0 ? "ms" : "s");
   DPRINTLN_F("OK");
   return true;
 }
 
-// **** WiFiManager callbacks 
+#ifdef USE_FAST_CONNECT
+// **** Fast WiFi connect
+
+bool fastConnect() {
+  File cacheFile = LittleFS.open(WIFI_CACHE_FILE, "r");
+  if (!cacheFile)
+    return false;
+  WifiCache cache;
+  size_t length = cacheFile.read((uint8_t*)&cache, sizeof(cache));
+  cacheFile.close();
+  // Credentials are stored by SDK (saved by WiFiManager)
+  String ssid = WiFi.SSID();
+  String psk = WiFi.psk();
+  if (length != sizeof(cache) || ssid.length() == 0 ||
+      cache.crc != crc32((uint8_t*)&cache + sizeof(cache.crc), sizeof(cache) - sizeof(cache.crc))) {
+    DPRINTLN_F("WiFi cache " WIFI_CACHE_FILE " is not valid.");
+    return false;
+  }
+
+  DPRINTF("Fast connect to %02X:%02X:%02X:%02X:%02X:%02X channel %u...", cache.bssid[0], cache.bssid[1],
+          cache.bssid[2], cache.bssid[3], cache.bssid[4], cache.bssid[5], cache.channel);
+  // Channel and BSSID are not written to flash, WiFiManager finds stored credentials unchanged
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  #ifdef FAST_CONNECT_STATIC_IP
+  // Lease is not renewed, the address must be reserved for this device in the DHCP server
+  WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.mask), IPAddress(cache.dns));
+  #endif
+  WiFi.begin(ssid.c_str(), psk.c_str(), cache.channel, cache.bssid);
+  uint32_t start = millis();
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start >= FAST_CONNECT_TIMEOUT) {
+      DPRINTLN_F("Failed!");
+      // Access point moved or lease is not valid, next connect scans channels and uses DHCP
+      WiFi.config(IPAddress(), IPAddress(), IPAddress());
+      WiFi.begin(ssid.c_str(), psk.c_str(), 0, nullptr, false);
+      WiFi.persistent(true);
+      LittleFS.remove(WIFI_CACHE_FILE);
+      return false;
+    }
+    delay(10);
+  }
+  WiFi.persistent(true);
+  DPRINTLN_F("OK");
+  return true;
+}
+
+void saveWifiCache() {
+  WifiCache cache;
+  memset(&cache, 0, sizeof(cache));
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  cache.ip = WiFi.localIP();
+  cache.gateway = WiFi.gatewayIP();
+  cache.mask = WiFi.subnetMask();
+  cache.dns = WiFi.dnsIP();
+  cache.crc = crc32((uint8_t*)&cache + sizeof(cache.crc), sizeof(cache) - sizeof(cache.crc));
+
+  // Flash is written only when access point or lease changed
+  WifiCache saved;
+  File cacheFile = LittleFS.open(WIFI_CACHE_FILE, "r");
+  if (cacheFile) {
+    size_t length = cacheFile.read((uint8_t*)&saved, sizeof(saved));
+    cacheFile.close();
+    if (length == sizeof(saved) && memcmp(&saved, &cache, sizeof(cache)) == 0)
+      return;
+  }
+  DPRINT_F("Saving " WIFI_CACHE_FILE "...");
+  cacheFile = LittleFS.open(WIFI_CACHE_FILE, "w");
+  if (!cacheFile || cacheFile.write((const uint8_t*)&cache, sizeof(cache)) != sizeof(cache)) {
+    // Not fatal, next boot connects by WiFiManager
+    DPRINTLN_F("Failed!");
+    return;
+  }
+  cacheFile.close();
+  DPRINTLN_F("OK");
+}
+#endif
+
+// **** WiFiManager callbacks
 
 void saveConfigCallback() {
   shouldSaveConfig = true;
@@ -0,0 +1,47 @@
+/*****************************************************************************
+ * Double precision formulas of derived quantities
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * References of the fixed point kernels (Derived.h), the same formulas as
+ * the float implementations they replace.
+ *****************************************************************************/
+#ifndef DERIVED_REFERENCE_H_
+#define DERIVED_REFERENCE_H_
+
+#include <math.h>
+
+static double refDewPoint(double temperature, double humidity) {
+  double gamma = log(humidity / 100.0) + 17.625 * temperature / (243.04 + temperature);
+  return 243.04 * gamma / (17.625 - gamma);
+}
+
+static double refAbsoluteHumidity(double temperature, double humidity) {
+  return 2.1674 * 610.94 * humidity / 100.0 * exp(17.625 * temperature / (243.04 + temperature)) / (273.15 + temperature);
+}
+
+static double refHeatIndex(double temperature, double humidity) {
+  double t = temperature * 1.8 + 32;
+  double hi = 0.5 * (t + 61.0 + (t - 68.0) * 1.2 + humidity * 0.094);
+  if (hi > 79) {
+    hi = -42.379 + 2.04901523 * t + 10.14333127 * humidity - 0.22475541 * t * humidity - 0.00683783 * t * t -
+         0.05481717 * humidity * humidity + 0.00122874 * t * t * humidity + 0.00085282 * t * humidity * humidity -
+         0.00000199 * t * t * humidity * humidity;
+    if (humidity < 13 && t >= 80.0 && t <= 112.0)
+      hi -= (13.0 - humidity) * 0.25 * sqrt((17.0 - fabs(t - 95.0)) * 0.05882);
+    else if (humidity > 85.0 && t >= 80.0 && t <= 87.0)
+      hi += (humidity - 85.0) * 0.1 * ((87.0 - t) * 0.2);
+  }
+  return (hi - 32) / 1.8;
+}
+
+static double refAltitude(double pressure, double seaLevelPressure) {
+  return 44330 * (1.0 - pow(pressure / seaLevelPressure, 0.1903));
+}
+
+static double refSeaLevelPressure(double pressure, double altitude) {
+  return pressure / pow(1.0 - altitude / 44330.0, 5.255);
+}
+
+#endif
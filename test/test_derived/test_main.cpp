@@ -0,0 +1,88 @@
+/*****************************************************************************
+ * Fixed point derived quantities tests
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Every kernel against its double precision formula (reference.h) over a
+ * grid of the range stated in Derived.h, the largest error must be within
+ * the DERIVED_ERROR_* bound.
+ *
+ *   pio test -e native -f test_derived
+ *****************************************************************************/
+#include <Arduino.h>
+#include <Derived.h>
+#include <unity.h>
+
+#include "reference.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Largest error of kernel over a grid (relative when relative is set) within limit
+template <typename F, typename R>
+static void checkKernel(const char* name, F kernel, R reference, float x0, float x1, float dx, float y0, float y1,
+                        float dy, double limit, bool relative = false) {
+  double worst = 0;
+  float worstX = x0;
+  float worstY = y0;
+  for (int i = 0; x0 + i * dx <= x1; i++) {
+    float x = x0 + i * dx;
+    for (int j = 0; y0 + j * dy <= y1; j++) {
+      float y = y0 + j * dy;
+      double expected = reference(x, y);
+      double error = fabs(kernel(x, y) - expected);
+      if (relative)
+        error /= fabs(expected);
+      if (!(error <= worst)) {
+        worst = error;
+        worstX = x;
+        worstY = y;
+      }
+    }
+  }
+  char message[100];
+  snprintf(message, sizeof(message), "%s max error %.5f%s at (%g, %g), limit %g", name, relative ? worst * 100 : worst,
+           relative ? " %" : "", worstX, worstY, relative ? limit * 100 : limit);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_MESSAGE(worst <= limit, message);
+}
+
+void test_dew_point() {
+  checkKernel("dew_point", dewPoint, refDewPoint, -60, 80, 0.1f, 1, 100, 0.5f, DERIVED_ERROR_DEWPOINT);
+}
+
+void test_abs_humidity() {
+  checkKernel("abs_humidity", absoluteHumidity, refAbsoluteHumidity, -60, 80, 0.1f, 1, 100, 0.5f,
+              DERIVED_ERROR_ABSHUMIDITY, true);
+}
+
+void test_heat_index() {
+  checkKernel("heat_index", heatIndex, refHeatIndex, -40, 60, 0.1f, 0, 100, 0.5f, DERIVED_ERROR_HEATINDEX);
+}
+
+void test_altitude() {
+  checkKernel("altitude", altitude, refAltitude, 30000, 110000, 10, 95000, 105000, 2500, DERIVED_ERROR_ALTITUDE);
+}
+
+void test_sea_level_pressure() {
+  checkKernel("sea_level_pressure", seaLevelPressure, refSeaLevelPressure, 30000, 110000, 1000, -500, 9000, 1,
+              DERIVED_ERROR_SEALEVEL);
+}
+
+// Outside the fixed point range the float formula is used
+void test_float_fallback() {
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, refDewPoint(85, 50), dewPoint(85, 50));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, refAbsoluteHumidity(-70, 50), absoluteHumidity(-70, 50));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_dew_point);
+  RUN_TEST(test_abs_humidity);
+  RUN_TEST(test_heat_index);
+  RUN_TEST(test_altitude);
+  RUN_TEST(test_sea_level_pressure);
+  RUN_TEST(test_float_fallback);
+  return UNITY_END();
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * DHT frame edge traces
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Falling edge times (micros) as stored by DhtReader::edge(), edge 0 is the
+ * sensor response. Nominal frames follow datasheet timing with a few us of
+ * jitter; others stretch the timing to the protocol limits, wrap micros(),
+ * corrupt the checksum, add a glitch edge or stop in the middle.
+ *****************************************************************************/
+#ifndef DHT_TRACES_H_
+#define DHT_TRACES_H_
+
+struct DhtTrace {
+  const char* name;
+  uint8_t type;                             // Sensor type (DhtType)
+  uint8_t count;                            // Edges in trace
+  uint32_t edges[DHT_EDGES];
+  DhtStatus status;                         // Expected decode result
+  float temperature;                        // Expected values when DHT_OK
+  float humidity;
+};
+
+static const DhtTrace dhtTraces[] = {
+  { "dht11_nominal", 11, 42, {
+      1717030, 1717189, 1717264, 1717341, 1717463, 1717580, 1717654, 1717734,
+      1717812, 1717886, 1717962, 1718040, 1718114, 1718192, 1718267, 1718341,
+      1718415, 1718492, 1718569, 1718643, 1718718, 1718835, 1718913, 1719033,
+      1719150, 1719273, 1719351, 1719425, 1719500, 1719579, 1719658, 1719779,
+      1719853, 1719931, 1720009, 1720129, 1720203, 1720278, 1720395, 1720473,
+      1720596, 1720714 },
+    DHT_OK, 23.4f, 48.0f },
+  { "dht22_negative_wrap", 22, 42, {
+      4294966000, 4294966159, 4294966236, 4294966311, 4294966389, 4294966463, 4294966541, 4294966617,
+      4294966738, 4294966818, 4294966940, 4294967015, 4294967089, 4294967167, 4294967288, 114,
+      189, 265, 382, 460, 539, 613, 691, 765,
+      843, 918, 995, 1117, 1238, 1358, 1481, 1557,
+      1677, 1798, 1918, 1994, 2070, 2145, 2268, 2343,
+      2422, 2545 },
+    DHT_OK, -12.3f, 65.2f },
+  { "dht22_slow", 22, 42, {
+      250000, 250174, 250259, 250348, 250435, 250524, 250612, 250699,
+      250789, 250877, 251008, 251141, 251270, 251355, 251444, 251532,
+      251618, 251753, 251840, 251926, 252014, 252102, 252187, 252277,
+      252362, 252497, 252586, 252675, 252810, 252945, 253076, 253207,
+      253297, 253428, 253517, 253605, 253694, 253829, 253961, 254090,
+      254225, 254354 },
+    DHT_OK, 31.7f, 22.5f },
+  { "dht22_fast", 22, 42, {
+      52000, 52149, 52217, 52287, 52357, 52422, 52487, 52557,
+      52671, 52782, 52896, 53009, 53123, 53194, 53262, 53373,
+      53487, 53599, 53669, 53736, 53801, 53869, 53936, 54002,
+      54071, 54136, 54204, 54269, 54335, 54406, 54473, 54583,
+      54653, 54719, 54831, 54943, 55058, 55126, 55235, 55345,
+      55457, 55525 },
+    DHT_OK, 0.4f, 99.9f },
+  { "dht22_checksum", 22, 42, {
+      88000, 88161, 88237, 88312, 88392, 88469, 88549, 88627,
+      88703, 88825, 88945, 89021, 89100, 89220, 89295, 89413,
+      89487, 89562, 89637, 89712, 89791, 89866, 89940, 90017,
+      90097, 90175, 90293, 90412, 90488, 90605, 90680, 90800,
+      90921, 91040, 91118, 91239, 91358, 91433, 91555, 91635,
+      91713, 91791 },
+    DHT_CHECKSUM, 0.0f, 0.0f },
+  { "dht22_glitch", 22, 42, {
+      91000, 91162, 91241, 91320, 91394, 91471, 91551, 91631,
+      91711, 91833, 91956, 92034, 92111, 92231, 92308, 92385,
+      92459, 92536, 92615, 92692, 92704, 92766, 92841, 92915,
+      92990, 93067, 93142, 93259, 93378, 93456, 93573, 93647,
+      93764, 93885, 94003, 94081, 94198, 94317, 94395, 94512,
+      94586, 94666 },
+    DHT_BAD_TIMING, 0.0f, 0.0f },
+  { "dht11_truncated", 11, 30, {
+      95000, 95161, 95238, 95313, 95435, 95554, 95630, 95708,
+      95784, 95861, 95935, 96009, 96089, 96166, 96243, 96320,
+      96397, 96473, 96547, 96622, 96696, 96818, 96894, 97016,
+      97135, 97255, 97335, 97414, 97489, 97567 },
+    DHT_TIMEOUT, 0.0f, 0.0f }
+};
+
+#endif
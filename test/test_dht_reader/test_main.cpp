@@ -0,0 +1,50 @@
+/*****************************************************************************
+ * DHT frame decoder tests
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Decoder against edge traces (dht_traces.h): DHT11 and DHT22, negative
+ * temperature, micros() wrap, slow and fast sensor timing, bad checksum,
+ * glitch and truncated frame.
+ *
+ *   pio test -e native -f test_dht_reader
+ *****************************************************************************/
+#include <Arduino.h>
+#include <DhtReader.h>
+#include <unity.h>
+
+#include "dht_traces.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Status of every trace as expected
+void test_decode_status() {
+  for (const DhtTrace& trace : dhtTraces) {
+    uint8_t data[5];
+    DhtStatus status = DhtReader::decode(trace.edges, trace.count, data);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(DhtReader::statusName(trace.status), DhtReader::statusName(status), trace.name);
+  }
+}
+
+// Values of decoded frames by sensor type
+void test_decode_values() {
+  for (const DhtTrace& trace : dhtTraces) {
+    uint8_t data[5];
+    if (trace.status != DHT_OK || DhtReader::decode(trace.edges, trace.count, data) != DHT_OK)
+      continue;
+    float temperature = NAN;
+    float humidity = NAN;
+    DhtReader::convert(trace.type, data, temperature, humidity);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.05f, trace.temperature, temperature, trace.name);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.05f, trace.humidity, humidity, trace.name);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_decode_status);
+  RUN_TEST(test_decode_values);
+  return UNITY_END();
+}
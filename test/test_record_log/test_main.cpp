@@ -0,0 +1,178 @@
+/*****************************************************************************
+ * Record log tests
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Segment rotation, read position after restart and recovery after power
+ * loss (torn page at the end, damaged record in the middle). Restart is a
+ * new RecordLog on the same directory; the file system is a host directory
+ * (hal/native).
+ *
+ *   pio test -e native -f test_record_log
+ *****************************************************************************/
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <RecordLog.h>
+#include <unity.h>
+
+#define LOG_DIR "/testlog"
+#define SEGMENT_PAGES 4
+#define SEGMENTS 3
+
+// Same size as logged sample of USE_SAMPLE_LOG, 3 records per page
+struct TestRecord {
+  uint64_t epochMillis;
+  uint32_t number;
+  uint8_t sample[64];
+};
+static uint8_t page[256];
+static uint32_t perSegment;
+
+// Log after restart
+static void openLog(RecordLog& log) {
+  TEST_ASSERT_TRUE(log.begin(SEGMENT_PAGES, SEGMENTS));
+  perSegment = SEGMENT_PAGES * log.pageRecords();
+}
+
+// Records numbered from first, appended in full pages
+static void appendRecords(RecordLog& log, uint32_t first, uint32_t count) {
+  TestRecord records[8] = {};
+  for (uint32_t i = 0; i < count; ) {
+    uint16_t n = min((uint32_t)log.pageRecords(), count - i);
+    for (uint16_t j = 0; j < n; j++)
+      records[j].number = first + i + j;
+    TEST_ASSERT_TRUE(log.append(records, n));
+    i += n;
+  }
+}
+
+// Next record number, UINT32_MAX at the end
+static uint32_t nextRecord(RecordLog& log) {
+  TestRecord record;
+  return log.next(&record) ? record.number : UINT32_MAX;
+}
+
+static void writeSegment(uint32_t segment, const char* mode, uint32_t offset, const uint8_t* data, size_t length) {
+  char path[32];
+  snprintf(path, sizeof(path), LOG_DIR "/%08x", (unsigned)segment);
+  File file = LittleFS.open(path, mode);
+  TEST_ASSERT_TRUE(file);
+  if (offset > 0)
+    file.seek(offset);
+  file.write(data, length);
+  file.close();
+}
+
+// Every test starts with an empty log
+void setUp() {
+  RecordLog log(LOG_DIR, sizeof(TestRecord), page, sizeof(page));
+  openLog(log);
+  log.consume(log.pending());
+}
+
+void tearDown() {}
+
+void test_rotation_drops_oldest() {
+  RecordLog log(LOG_DIR, sizeof(TestRecord), page, sizeof(page));
+  openLog(log);
+  TEST_ASSERT_EQUAL_UINT32(3, log.pageRecords());
+  appendRecords(log, 0, (SEGMENTS + 1) * perSegment);
+  TEST_ASSERT_EQUAL_UINT8(SEGMENTS, log.segments());
+  TEST_ASSERT_EQUAL_UINT32(SEGMENTS * perSegment, log.pending());
+  TEST_ASSERT_EQUAL_UINT32(perSegment, log.stats().dropped);
+  log.rewind();
+  TEST_ASSERT_EQUAL_UINT32(perSegment, nextRecord(log));
+}
+
+void test_cursor_survives_restart() {
+  {
+    RecordLog log(LOG_DIR, sizeof(TestRecord), page, sizeof(page));
+    openLog(log);
+    appendRecords(log, 0, 2 * perSegment);
+    log.rewind();
+    for (int i = 0; i < 5; i++)
+      nextRecord(log);
+    log.consume(5);
+  }
+  RecordLog restarted(LOG_DIR, sizeof(TestRecord), page, sizeof(page));
+  openLog(restarted);
+  TEST_ASSERT_EQUAL_UINT32(2 * perSegment - 5, restarted.pending());
+  restarted.rewind();
+  TEST_ASSERT_EQUAL_UINT32(5, nextRecord(restarted));
+}
+
+// Half written page at the end, the segment is not appended any more
+void test_torn_page() {
+  {
+    RecordLog log(LOG_DIR, sizeof(TestRecord), page, sizeof(page));
+    openLog(log);
+    appendRecords(log, 0, perSegment + 2 * log.pageRecords());
+  }
+  uint8_t garbage[sizeof(page) / 2];
+  memset(garbage, 0x5A, sizeof(garbage));
+  writeSegment(1, "a", 0, garbage, sizeof(garbage));
+  RecordLog recovered(LOG_DIR, sizeof(TestRecord), page, sizeof(page));
+  openLog(recovered);
+  TEST_ASSERT_EQUAL_UINT32(0, recovered.stats().corrupt);
+  TEST_ASSERT_EQUAL_UINT32(perSegment + 6, recovered.pending());
+  appendRecords(recovered, 1000, 1);
+  TEST_ASSERT_EQUAL_UINT8(3, recovered.segments());
+  // Records in order, the new one after the torn segment
+  recovered.rewind();
+  for (uint32_t i = 0; i < perSegment + 6; i++)
+    TEST_ASSERT_EQUAL_UINT32(i, nextRecord(recovered));
+  TEST_ASSERT_EQUAL_UINT32(1000, nextRecord(recovered));
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, nextRecord(recovered));
+}
+
+// Damaged record is skipped and counted, the others are read
+void test_damaged_record() {
+  {
+    RecordLog log(LOG_DIR, sizeof(TestRecord), page, sizeof(page));
+    openLog(log);
+    appendRecords(log, 0, perSegment);
+  }
+  // Record 3 (second page, first slot)
+  uint8_t damage = 0xA5;
+  writeSegment(0, "r+", sizeof(page) + 8, &damage, 1);
+  RecordLog recovered(LOG_DIR, sizeof(TestRecord), page, sizeof(page));
+  openLog(recovered);
+  TEST_ASSERT_EQUAL_UINT32(1, recovered.stats().corrupt);
+  TEST_ASSERT_EQUAL_UINT32(perSegment - 1, recovered.pending());
+  recovered.rewind();
+  for (uint32_t i = 0; i < perSegment; i++) {
+    if (i != 3)
+      TEST_ASSERT_EQUAL_UINT32(i, nextRecord(recovered));
+  }
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, nextRecord(recovered));
+}
+
+// Fully read log has no segment and no cursor
+void test_consume_all() {
+  RecordLog log(LOG_DIR, sizeof(TestRecord), page, sizeof(page));
+  openLog(log);
+  appendRecords(log, 0, 2 * perSegment + 1);
+  log.rewind();
+  uint32_t count = 0;
+  while (nextRecord(log) != UINT32_MAX)
+    count++;
+  TEST_ASSERT_EQUAL_UINT32(2 * perSegment + 1, count);
+  log.consume(count);
+  TEST_ASSERT_EQUAL_UINT8(0, log.segments());
+  TEST_ASSERT_EQUAL_UINT32(0, log.pending());
+  TEST_ASSERT_FALSE(LittleFS.exists(LOG_DIR "/cursor"));
+}
+
+int main(int argc, char** argv) {
+  // Own flash directory, firmware state is not touched
+  hal::fsRoot = "littlefs-test";
+  LittleFS.begin();
+  UNITY_BEGIN();
+  RUN_TEST(test_rotation_drops_oldest);
+  RUN_TEST(test_cursor_survives_restart);
+  RUN_TEST(test_torn_page);
+  RUN_TEST(test_damaged_record);
+  RUN_TEST(test_consume_all);
+  return UNITY_END();
+}
@@ -0,0 +1,555 @@
+/*****************************************************************************
+ * Fleet simulator
+ *****************************************************************************
+ * (c) Tomas Kouba, 2022
+ * Licensed under terms of the MIT license
+ *****************************************************************************
+ * Many virtual devices writing to one InfluxDB in a single process. Every
+ * device follows the firmware sampling and write rules: one sample every
+ * LOOP_INTERVAL kept in the same RingBuffer, batch written when it is full or
+ * too old, flush checked every FLUSH_INTERVAL, request body encoded with the
+ * same LineProtocol encoder. Devices have own deviceId and sensor profile.
+ *
+ * Discrete event simulation in virtual time, single event loop, so a fleet
+ * of thousands of devices runs for hours in seconds and results are
+ * repeatable for given seed. The server is a model with limited workers,
+ * latency, request rate limit (429 + Retry-After) and random 503. Failed
+ * writes are retried by the firmware connectivity state machine (Link) or
+ * by a simpler backoff for comparison.
+ *
+ *   program [options], see -h
+ *****************************************************************************/
+#include <Link.h>
+#include <LineProtocol.h>
+#include <RingBuffer.h>
+
+#include <algorithm>
+#include <functional>
+#include <getopt.h>
+#include <math.h>
+#include <queue>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+// Firmware defaults, see include/main.h
+#define LOOP_INTERVAL 5*60*1000             // Sample interval (ms)
+#define SAMPLE_BUFFER_SIZE 48               // Samples kept in RAM until written
+#define BATCH_BODY_SIZE 4096                // Write request body buffer
+#define FLUSH_INTERVAL 1000                 // Batch write check interval (ms)
+#define BOOT_TIME 1500                      // Power on to first sample, WiFi connect (ms)
+
+#define MS 1000ULL                          // Virtual time unit is microsecond
+#define SECOND 1000000ULL
+
+enum Backoff {
+  BACKOFF_NONE,                             // Retry on next flush check
+  BACKOFF_EXPONENTIAL,                      // base * 2^(failures - 1), up to max
+  BACKOFF_JITTER,                           // Uniform random 0 .. exponential delay (full jitter)
+  BACKOFF_FIRMWARE                          // Link state machine with LINK_* defaults, circuit breaker, Retry-After
+};
+
+struct Options {
+  uint32_t devices = 1000;
+  uint32_t duration = 3600;                 // Simulated time (s)
+  uint32_t sampleInterval = LOOP_INTERVAL;  // ms
+  uint16_t batchSize = 1;
+  uint32_t batchMaxAge = 15 * 60;           // s
+  uint32_t startupJitter = 0;               // Random power on delay up to (ms)
+  Backoff backoff = BACKOFF_FIRMWARE;
+  uint32_t backoffBase = 1000;              // ms
+  uint32_t backoffMax = 5 * 60 * 1000;      // ms
+  bool retryAfter = false;                  // Devices honour Retry-After
+  // Server model
+  double capacity = 0;                      // Accepted writes per second, 0 = unlimited
+  uint32_t serverRetryAfter = 5;            // Retry-After of 429/503 (s)
+  uint32_t workers = 8;                     // Requests processed in parallel
+  double latency = 60;                      // Network round trip and TLS (ms)
+  double latencyJitter = 20;                // Mean of exponential extra latency (ms)
+  double lineCost = 0.2;                    // Server time per line (ms)
+  double failure = 0;                       // Probability of 503
+  uint32_t seed = 1;
+  const char* output = nullptr;             // JSON results
+};
+
+static Options options;
+static std::mt19937_64 rng;
+
+static double uniform(double from, double to) { return std::uniform_real_distribution<double>(from, to)(rng); }
+// Virtual time of the current event (ms), clock of device Link
+static uint64_t clockMillis = 0;
+static uint64_t fleetMillis() { return clockMillis; }
+
+/***** Server model *****/
+class Server {
+public:
+  void begin() {
+    _tokens = options.capacity;
+    for (uint32_t i = 0; i < options.workers; i++)
+      _free.push(0);
+  }
+
+  // Handles write request arriving at now, returns status and sets time of response
+  int write(uint64_t now, size_t lines, uint64_t& done) {
+    uint64_t network = (uint64_t)(options.latency * MS);
+    if (options.capacity > 0) {
+      // Token bucket, burst of one second
+      _tokens = std::min(options.capacity, _tokens + (now - _last) * options.capacity / SECOND);
+      _last = now;
+      if (_tokens < 1) {
+        done = now + network;
+        return 429;
+      }
+      _tokens -= 1;
+    }
+    if (options.failure > 0 && uniform(0, 1) < options.failure) {
+      done = now + network;
+      return 503;
+    }
+    double jitter = options.latencyJitter > 0 ? std::exponential_distribution<double>(1 / options.latencyJitter)(rng) : 0;
+    uint64_t service = (uint64_t)((options.lineCost * lines + jitter) * MS);
+    // Earliest free worker, request waits in queue when all are busy
+    uint64_t start = std::max(now + network / 2, _free.top());
+    _free.pop();
+    _free.push(start + service);
+    done = start + service + network / 2;
+    return 204;
+  }
+
+private:
+  double _tokens = 0;
+  uint64_t _last = 0;
+  std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> _free;
+};
+
+static Server server;
+
+/***** Device *****/
+struct DeviceSample {
+  uint64_t timestamp;                       // Virtual time of acquisition
+  int32_t rssi;
+  float temperature;
+  float humidity;
+  float pressure;
+};
+
+static char body[BATCH_BODY_SIZE];
+
+struct Device {
+  char deviceId[25];
+  // Sensor profile
+  float temperatureBase;
+  float humidityBase;
+  float pressureBase;
+  float phase;
+  int32_t rssi;
+
+  LineProtocol encoder = LineProtocol(body, sizeof(body));
+  RingBuffer<DeviceSample, SAMPLE_BUFFER_SIZE> samples;
+  uint64_t boot = 0;
+  uint64_t nextSample = 0;                  // Sample task deadline
+  uint64_t busyUntil = 0;                   // Blocked in write request
+  uint64_t flushAt = 0;                     // Pending flush check event, 0 = none
+  uint64_t retryAt = 0;                     // Backoff, no write before
+  uint32_t failures = 0;                    // Consecutive failed writes
+  Link link = Link(fleetMillis);            // Firmware backoff (BACKOFF_FIRMWARE)
+  // Write in progress
+  uint64_t requestStart = 0;
+  size_t requestSamples = 0;
+  size_t requestBytes = 0;
+  int requestStatus = 0;
+
+  void begin(uint32_t index) {
+    snprintf(deviceId, sizeof(deviceId), "ESP-FLUX-TEMP-%08X", 0x00C00000u + index);
+    temperatureBase = (float)uniform(18, 26);
+    humidityBase = (float)uniform(35, 60);
+    pressureBase = (float)uniform(98000, 103000);
+    phase = (float)uniform(0, 2 * M_PI);
+    rssi = (int32_t)uniform(-85, -40);
+    link.begin((uint32_t)rng());
+    encoder.setMeasurement("temperature");
+    encoder.addTag("device", deviceId);
+    encoder.addTag("SSID", "fleet");
+    encoder.addTag("location", "Living room");
+  }
+
+  DeviceSample sample(uint64_t now) {
+    double day = 2 * M_PI * now / (86400.0 * SECOND) + phase;
+    DeviceSample s;
+    s.timestamp = now;
+    s.rssi = rssi + (int32_t)uniform(-3, 3);
+    s.temperature = (float)(temperatureBase + 3 * sin(day));
+    s.humidity = (float)(humidityBase + 10 * cos(day));
+    s.pressure = (float)(pressureBase + 250 * sin(2 * day));
+    return s;
+  }
+
+  // Same fields as sampleLine() with DHT and BMP280 (pressure only) sensor, in sensor list order
+  bool line(const DeviceSample& s, uint64_t epoch) {
+    float dewPoint = 243.04f * (logf(s.humidity / 100) + 17.625f * s.temperature / (243.04f + s.temperature)) /
+      (17.625f - logf(s.humidity / 100) - 17.625f * s.temperature / (243.04f + s.temperature));
+    encoder.beginLine();
+    encoder.addField("rssi", s.rssi);
+    encoder.addField("uptime", (uint64_t)((s.timestamp - boot) / MS));
+    encoder.addField("pending", (uint32_t)samples.size());
+    encoder.addField("dropped", samples.overflows());
+    encoder.addField("skipped", (uint32_t)0);   // Deadbands are off, every sample is sent
+    encoder.addField("temperature", s.temperature);
+    encoder.addField("humidity", s.humidity);
+    encoder.addField("heatIndex", s.temperature - 0.4f);
+    encoder.addField("dewPoint", dewPoint);
+    encoder.addField("pressure", s.pressure);
+    return encoder.endLine(epoch + s.timestamp / SECOND);
+  }
+
+  bool batchDue(uint64_t now) const {
+    if (samples.empty())
+      return false;
+    return samples.size() >= options.batchSize || samples.full() ||
+      now - samples.front().timestamp >= (uint64_t)options.batchMaxAge * SECOND;
+  }
+
+  // Flush task runs on its own period grid from boot
+  uint64_t flushTick(uint64_t t) const {
+    if (t <= boot)
+      return boot;
+    uint64_t period = FLUSH_INTERVAL * MS;
+    return boot + (t - boot + period - 1) / period * period;
+  }
+};
+
+static std::vector<Device> devices;
+
+/***** Events *****/
+enum EventType { EVENT_BOOT, EVENT_SAMPLE, EVENT_FLUSH, EVENT_RESPONSE };
+
+struct Event {
+  uint64_t time;
+  uint64_t sequence;                        // Keeps order of simultaneous events stable
+  uint32_t device;
+  EventType type;
+  bool operator>(const Event& other) const {
+    return time != other.time ? time > other.time : sequence > other.sequence;
+  }
+};
+
+static std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+static uint64_t sequence = 0;
+
+static void schedule(uint64_t time, uint32_t device, EventType type) {
+  events.push(Event{time, sequence++, device, type});
+}
+
+/***** Statistics *****/
+struct Statistics {
+  uint64_t requests = 0;
+  uint64_t accepted = 0;
+  uint64_t throttled = 0;                   // 429
+  uint64_t unavailable = 0;                 // 503
+  uint64_t samplesTaken = 0;
+  uint64_t samplesDelivered = 0;
+  uint64_t samplesDropped = 0;
+  uint64_t bytesSent = 0;                   // All request bodies including failed
+  uint64_t bytesAccepted = 0;               // Bodies of successful writes
+  std::vector<uint32_t> latencies;          // Write latency (us)
+  std::vector<uint32_t> requestsPerSecond;  // Requests started in every second
+};
+
+static Statistics stats;
+
+static void flushCheck(Device& device, uint32_t index, uint64_t now);
+
+static void scheduleFlush(Device& device, uint32_t index, uint64_t time) {
+  time = device.flushTick(time);
+  if (device.flushAt != 0 && device.flushAt <= time)
+    return;
+  device.flushAt = time;
+  schedule(time, index, EVENT_FLUSH);
+}
+
+static void sendBatch(Device& device, uint32_t index, uint64_t now) {
+  // Clock is synchronized, samples carry own timestamp
+  const uint64_t epoch = 1650000000;
+  size_t count = 0;
+  device.encoder.clear();
+  while (count < options.batchSize && count < device.samples.size() && device.line(device.samples.at(count), epoch))
+    count++;
+  uint64_t done;
+  int status = server.write(now, count, done);
+  device.requestStart = now;
+  device.requestSamples = count;
+  device.requestBytes = device.encoder.length();
+  device.requestStatus = status;
+  device.busyUntil = done;
+  schedule(done, index, EVENT_RESPONSE);
+
+  stats.requests++;
+  stats.bytesSent += device.requestBytes;
+  size_t second = now / SECOND;
+  if (second < stats.requestsPerSecond.size())
+    stats.requestsPerSecond[second]++;
+}
+
+static void flushCheck(Device& device, uint32_t index, uint64_t now) {
+  if (now < device.busyUntil)
+    return;                                 // Response handler checks again
+  if (now < device.retryAt) {
+    scheduleFlush(device, index, device.retryAt);
+    return;
+  }
+  if (!device.batchDue(now)) {
+    // Batch becomes due by age of the oldest sample
+    if (!device.samples.empty())
+      scheduleFlush(device, index, device.samples.front().timestamp + (uint64_t)options.batchMaxAge * SECOND);
+    return;
+  }
+  sendBatch(device, index, now);
+}
+
+static void response(Device& device, uint32_t index, uint64_t now) {
+  stats.latencies.push_back((uint32_t)std::min<uint64_t>(now - device.requestStart, UINT32_MAX));
+  int status = device.requestStatus;
+  if (status >= 200 && status < 300) {
+    stats.accepted++;
+    stats.samplesDelivered += device.requestSamples;
+    stats.bytesAccepted += device.requestBytes;
+    for (size_t i = 0; i < device.requestSamples; i++)
+      device.samples.pop();
+    device.failures = 0;
+    device.retryAt = 0;
+    if (options.backoff == BACKOFF_FIRMWARE)
+      device.link.success();
+    flushCheck(device, index, now);
+    return;
+  }
+  if (status == 429)
+    stats.throttled++;
+  else
+    stats.unavailable++;
+  device.failures++;
+  uint64_t delay = 0;
+  if (options.backoff == BACKOFF_EXPONENTIAL || options.backoff == BACKOFF_JITTER) {
+    uint32_t shift = std::min<uint32_t>(device.failures - 1, 20);
+    delay = std::min<uint64_t>((uint64_t)options.backoffBase << shift, options.backoffMax) * MS;
+    if (options.backoff == BACKOFF_JITTER)
+      delay = (uint64_t)uniform(0, (double)delay);
+  }
+  if (options.backoff == BACKOFF_FIRMWARE) {
+    // Both 429 and 503 of the model carry Retry-After, the firmware always honours it
+    device.link.failure(true, options.serverRetryAfter);
+    delay = (uint64_t)device.link.wait() * MS;
+  }
+  if (options.retryAfter)
+    delay = std::max<uint64_t>(delay, options.serverRetryAfter * SECOND);
+  // Without backoff the flush task retries on its next period
+  device.retryAt = now + std::max<uint64_t>(delay, 1);
+  scheduleFlush(device, index, device.retryAt);
+}
+
+static void sampleTask(Device& device, uint32_t index, uint64_t now) {
+  if (now < device.busyUntil) {
+    // Blocked in write request, task runs late
+    schedule(device.busyUntil, index, EVENT_SAMPLE);
+    return;
+  }
+  stats.samplesTaken++;
+  if (!device.samples.push(device.sample(now)))
+    stats.samplesDropped++;
+  // Next period, missed periods are skipped (Scheduler)
+  uint64_t period = (uint64_t)options.sampleInterval * MS;
+  device.nextSample += period;
+  if (device.nextSample < now)
+    device.nextSample += ((now - device.nextSample) / period + 1) * period;
+  schedule(device.nextSample, index, EVENT_SAMPLE);
+  flushCheck(device, index, now);
+}
+
+static void run() {
+  uint64_t end = (uint64_t)options.duration * SECOND;
+  rng.seed(options.seed);
+  server.begin();
+  stats.requestsPerSecond.assign(options.duration + 1, 0);
+  devices.resize(options.devices);
+  for (uint32_t i = 0; i < options.devices; i++) {
+    devices[i].begin(i);
+    // Power returns at time 0 for the whole fleet
+    devices[i].boot = (uint64_t)(uniform(0, options.startupJitter) * MS);
+    schedule(devices[i].boot, i, EVENT_BOOT);
+  }
+
+  while (!events.empty() && events.top().time < end) {
+    Event event = events.top();
+    events.pop();
+    Device& device = devices[event.device];
+    clockMillis = event.time / MS;
+    switch (event.type) {
+    case EVENT_BOOT:
+      device.nextSample = event.time + BOOT_TIME * MS;
+      schedule(device.nextSample, event.device, EVENT_SAMPLE);
+      break;
+    case EVENT_SAMPLE:
+      sampleTask(device, event.device, event.time);
+      break;
+    case EVENT_FLUSH:
+      if (event.time != device.flushAt)
+        break;                              // Replaced by earlier check
+      device.flushAt = 0;
+      flushCheck(device, event.device, event.time);
+      break;
+    case EVENT_RESPONSE:
+      response(device, event.device, event.time);
+      break;
+    }
+  }
+}
+
+/***** Report *****/
+static double percentile(std::vector<uint32_t>& values, double p) {
+  if (values.empty())
+    return 0;
+  size_t k = std::min(values.size() - 1, (size_t)(p * values.size()));
+  std::nth_element(values.begin(), values.begin() + k, values.end());
+  return values[k];
+}
+
+static void report(double wallSeconds) {
+  uint64_t pending = 0;
+  for (const Device& device : devices)
+    pending += device.samples.size();
+  std::vector<uint32_t> rates = stats.requestsPerSecond;
+  uint32_t peak = rates.empty() ? 0 : *std::max_element(rates.begin(), rates.end());
+  double rate = (double)stats.requests / options.duration;
+  double rateP99 = percentile(rates, 0.99);
+  double latencyP50 = percentile(stats.latencies, 0.50) / 1000;
+  double latencyP99 = percentile(stats.latencies, 0.99) / 1000;
+  double latencyMax = stats.latencies.empty() ? 0 : *std::max_element(stats.latencies.begin(), stats.latencies.end()) / 1000.0;
+  double bytesPerSample = stats.samplesDelivered ? (double)stats.bytesAccepted / stats.samplesDelivered : 0;
+  double amplification = stats.bytesAccepted ? (double)stats.bytesSent / stats.bytesAccepted : 0;
+  static const char* backoffs[] = { "none", "exp", "jitter", "firmware" };
+
+  printf("Devices %u, simulated %u s in %.2f s\n", options.devices, options.duration, wallSeconds);
+  printf("Requests       %llu (accepted %llu, 429 %llu, 503 %llu)\n", (unsigned long long)stats.requests,
+         (unsigned long long)stats.accepted, (unsigned long long)stats.throttled, (unsigned long long)stats.unavailable);
+  printf("Request rate   mean %.2f/s, p99 %.0f/s, peak %u/s\n", rate, rateP99, peak);
+  printf("Write latency  p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", latencyP50, latencyP99, latencyMax);
+  printf("Samples        taken %llu, delivered %llu, dropped %llu, pending %llu\n", (unsigned long long)stats.samplesTaken,
+         (unsigned long long)stats.samplesDelivered, (unsigned long long)stats.samplesDropped, (unsigned long long)pending);
+  printf("Bytes          %.1f per sample, write amplification %.2f\n", bytesPerSample, amplification);
+
+  if (!options.output)
+    return;
+  FILE* f = fopen(options.output, "w");
+  if (!f) {
+    fprintf(stderr, "Cannot write %s\n", options.output);
+    return;
+  }
+  fprintf(f, "{\n  \"devices\": %u, \"duration\": %u, \"sample_interval\": %u, \"batch_size\": %u, \"batch_age\": %u,\n",
+          options.devices, options.duration, options.sampleInterval, options.batchSize, options.batchMaxAge);
+  fprintf(f, "  \"startup_jitter\": %u, \"backoff\": \"%s\", \"backoff_base\": %u, \"backoff_max\": %u, \"retry_after\": %s,\n",
+          options.startupJitter, backoffs[options.backoff], options.backoffBase, options.backoffMax, options.retryAfter ? "true" : "false");
+  fprintf(f, "  \"capacity\": %.1f, \"workers\": %u, \"latency\": %.1f, \"failure\": %.3f, \"seed\": %u,\n",
+          options.capacity, options.workers, options.latency, options.failure, options.seed);
+  fprintf(f, "  \"requests\": %llu, \"accepted\": %llu, \"throttled\": %llu, \"unavailable\": %llu,\n",
+          (unsigned long long)stats.requests, (unsigned long long)stats.accepted,
+          (unsigned long long)stats.throttled, (unsigned long long)stats.unavailable);
+  fprintf(f, "  \"rate_mean\": %.3f, \"rate_p99\": %.0f, \"rate_peak\": %u,\n", rate, rateP99, peak);
+  fprintf(f, "  \"latency_p50_ms\": %.2f, \"latency_p99_ms\": %.2f, \"latency_max_ms\": %.2f,\n", latencyP50, latencyP99, latencyMax);
+  fprintf(f, "  \"samples_taken\": %llu, \"samples_delivered\": %llu, \"samples_dropped\": %llu, \"samples_pending\": %llu,\n",
+          (unsigned long long)stats.samplesTaken, (unsigned long long)stats.samplesDelivered,
+          (unsigned long long)stats.samplesDropped, (unsigned long long)pending);
+  fprintf(f, "  \"bytes_per_sample\": %.2f, \"write_amplification\": %.3f\n}\n", bytesPerSample, amplification);
+  fclose(f);
+}
+
+static void usage(const char* name) {
+  fprintf(stderr,
+    "usage: %s [options]\n"
+    "  -n, --devices N          virtual devices (1000)\n"
+    "  -d, --duration S         simulated time in seconds (3600)\n"
+    "  -i, --interval MS        sample interval, LOOP_INTERVAL (300000)\n"
+    "  -b, --batch-size N       samples per write (1)\n"
+    "  -a, --batch-age S        maximum age of the oldest sample (900)\n"
+    "  -j, --startup-jitter MS  random power on delay up to (0)\n"
+    "  -B, --backoff MODE       none | exp | jitter | firmware (firmware)\n"
+    "      --backoff-base MS    first backoff delay (1000)\n"
+    "      --backoff-max MS     maximum backoff delay (300000)\n"
+    "  -r, --retry-after        devices honour Retry-After\n"
+    "  -c, --capacity N         server writes per second, 0 = unlimited (0)\n"
+    "      --server-retry S     Retry-After sent by server (5)\n"
+    "  -w, --workers N          server parallel requests (8)\n"
+    "  -l, --latency MS         network round trip (60)\n"
+    "      --latency-jitter MS  mean exponential extra latency (20)\n"
+    "  -f, --failure P          probability of 503 (0)\n"
+    "  -s, --seed N             random seed (1)\n"
+    "  -o, --output FILE        write results as JSON\n", name);
+}
+
+int main(int argc, char** argv) {
+  enum { OPT_BACKOFF_BASE = 256, OPT_BACKOFF_MAX, OPT_SERVER_RETRY, OPT_LATENCY_JITTER };
+  static const struct option longOptions[] = {
+    { "devices", required_argument, nullptr, 'n' },
+    { "duration", required_argument, nullptr, 'd' },
+    { "interval", required_argument, nullptr, 'i' },
+    { "batch-size", required_argument, nullptr, 'b' },
+    { "batch-age", required_argument, nullptr, 'a' },
+    { "startup-jitter", required_argument, nullptr, 'j' },
+    { "backoff", required_argument, nullptr, 'B' },
+    { "backoff-base", required_argument, nullptr, OPT_BACKOFF_BASE },
+    { "backoff-max", required_argument, nullptr, OPT_BACKOFF_MAX },
+    { "retry-after", no_argument, nullptr, 'r' },
+    { "capacity", required_argument, nullptr, 'c' },
+    { "server-retry", required_argument, nullptr, OPT_SERVER_RETRY },
+    { "workers", required_argument, nullptr, 'w' },
+    { "latency", required_argument, nullptr, 'l' },
+    { "latency-jitter", required_argument, nullptr, OPT_LATENCY_JITTER },
+    { "failure", required_argument, nullptr, 'f' },
+    { "seed", required_argument, nullptr, 's' },
+    { "output", required_argument, nullptr, 'o' },
+    { "help", no_argument, nullptr, 'h' },
+    { nullptr, 0, nullptr, 0 }
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "n:d:i:b:a:j:B:rc:w:l:f:s:o:h", longOptions, nullptr)) != -1) {
+    switch (option) {
+    case 'n': options.devices = (uint32_t)atol(optarg); break;
+    case 'd': options.duration = (uint32_t)atol(optarg); break;
+    case 'i': options.sampleInterval = (uint32_t)atol(optarg); break;
+    case 'b': options.batchSize = (uint16_t)std::max(1L, std::min(atol(optarg), (long)SAMPLE_BUFFER_SIZE)); break;
+    case 'a': options.batchMaxAge = (uint32_t)atol(optarg); break;
+    case 'j': options.startupJitter = (uint32_t)atol(optarg); break;
+    case 'B':
+      if (strcmp(optarg, "none") == 0) options.backoff = BACKOFF_NONE;
+      else if (strcmp(optarg, "exp") == 0) options.backoff = BACKOFF_EXPONENTIAL;
+      else if (strcmp(optarg, "jitter") == 0) options.backoff = BACKOFF_JITTER;
+      else if (strcmp(optarg, "firmware") == 0) options.backoff = BACKOFF_FIRMWARE;
+      else { usage(argv[0]); return 2; }
+      break;
+    case OPT_BACKOFF_BASE: options.backoffBase = (uint32_t)atol(optarg); break;
+    case OPT_BACKOFF_MAX: options.backoffMax = (uint32_t)atol(optarg); break;
+    case 'r': options.retryAfter = true; break;
+    case 'c': options.capacity = atof(optarg); break;
+    case OPT_SERVER_RETRY: options.serverRetryAfter = (uint32_t)atol(optarg); break;
+    case 'w': options.workers = std::max(1L, atol(optarg)); break;
+    case 'l': options.latency = atof(optarg); break;
+    case OPT_LATENCY_JITTER: options.latencyJitter = atof(optarg); break;
+    case 'f': options.failure = atof(optarg); break;
+    case 's': options.seed = (uint32_t)atol(optarg); break;
+    case 'o': options.output = optarg; break;
+    default: usage(argv[0]); return option == 'h' ? 0 : 2;
+    }
+  }
+  if (options.devices == 0 || options.duration == 0 || options.sampleInterval == 0) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  run();
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  report(end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9);
+  return 0;
+}
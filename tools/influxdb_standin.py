@@ -0,0 +1,300 @@
+#!/usr/bin/env python3
+"""Local InfluxDB v2 write API stand-in
+
+(c) Tomas Kouba, 2022
+Licensed under terms of the MIT license
+
+Mimics /api/v2/write and /health of InfluxDB 2.x for offline integration
+and throughput testing of the firmware (native build, see README). Faults
+are injected with a given probability and can be changed at run time:
+
+  latency      response delay (ms), plus uniform jitter
+  429 / 503    error responses with Retry-After header
+  reset        connection closed with TCP RST instead of a response
+  rate limit   requests per second over all clients, excess gets 429
+
+With --tls CERT KEY the server speaks HTTPS, new connections, full TLS
+handshakes and resumed sessions are counted to confirm connection reuse
+of the device.
+
+Received line protocol is kept for assertions (GET /lines) and optionally
+appended to a file. Counters are available on GET /stats, settings are
+changed by POST /control with JSON body, e.g.
+
+  curl -X POST localhost:8086/control -d '{"fail": {"503": 1.0}}'
+  curl localhost:8086/stats
+"""
+
+import argparse
+import gzip
+import json
+import random
+import socket
+import ssl
+import struct
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+
+class State:
+    """Fault settings, counters and received lines shared by all handlers"""
+
+    def __init__(self, args):
+        self.lock = threading.Lock()
+        self.random = random.Random(args.seed)
+        self.latency = args.latency
+        self.jitter = args.jitter
+        self.fail = dict(parse_fail(f) for f in args.fail)
+        self.reset = args.reset
+        self.retry_after = args.retry_after
+        self.rate_limit = args.rate_limit
+        self.token = args.token
+        self.record = open(args.record, "a", encoding="utf-8") if args.record else None
+        self.lines = []
+        self.window = []
+        self.stats = {
+            "requests": 0, "writes": 0, "lines": 0, "bytes": 0, "bytes_decoded": 0,
+            "gzip": 0, "resets": 0, "health": 0, "status": {},
+            "connections": 0, "tls_handshakes": 0, "tls_resumed": 0,
+        }
+
+    def settings(self):
+        return {
+            "latency": self.latency, "jitter": self.jitter, "fail": self.fail,
+            "reset": self.reset, "retry_after": self.retry_after,
+            "rate_limit": self.rate_limit,
+        }
+
+    def update(self, changes):
+        with self.lock:
+            for key in ("latency", "jitter", "reset", "retry_after", "rate_limit"):
+                if key in changes:
+                    setattr(self, key, changes[key])
+            if "fail" in changes:
+                self.fail = {str(k): float(v) for k, v in changes["fail"].items()}
+            if changes.get("clear"):
+                self.lines = []
+                for key in self.stats:
+                    self.stats[key] = {} if key == "status" else 0
+
+    def delay(self):
+        with self.lock:
+            delay = self.latency + self.random.uniform(0, self.jitter)
+        if delay > 0:
+            time.sleep(delay / 1000)
+
+    def fault(self):
+        """Returns injected outcome of one write: "reset", status code or None"""
+        with self.lock:
+            if self.rate_limit > 0:
+                now = time.monotonic()
+                self.window = [t for t in self.window if now - t < 1.0]
+                if len(self.window) >= self.rate_limit:
+                    return 429
+                self.window.append(now)
+            if self.random.random() < self.reset:
+                return "reset"
+            for status, probability in self.fail.items():
+                if self.random.random() < probability:
+                    return int(status)
+        return None
+
+    def count(self, status):
+        with self.lock:
+            key = str(status)
+            self.stats["status"][key] = self.stats["status"].get(key, 0) + 1
+
+
+def parse_fail(text):
+    """"503:0.1" -> ("503", 0.1)"""
+    status, _, probability = text.partition(":")
+    return status, float(probability or 1.0)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "InfluxDB-standin"
+    state = None
+
+    def log_message(self, format, *args):
+        if self.server.verbose:
+            super().log_message(format, *args)
+
+    def setup(self):
+        if isinstance(self.request, ssl.SSLSocket):
+            # Handshake in the handler thread, a slow client must not block accept
+            try:
+                self.request.do_handshake()
+            except (ssl.SSLError, OSError):
+                self.request.close()
+                raise
+        super().setup()
+        with self.state.lock:
+            self.state.stats["connections"] += 1
+            if isinstance(self.connection, ssl.SSLSocket):
+                self.state.stats["tls_handshakes"] += 1
+                if self.connection.session_reused:
+                    self.state.stats["tls_resumed"] += 1
+
+    def reply(self, status, body=b"", content_type="application/json", headers=None):
+        self.state.count(status)
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.end_headers()
+        if body:
+            self.wfile.write(body)
+
+    def error(self, status, message, headers=None):
+        body = json.dumps({"code": "error", "message": message}).encode()
+        self.reply(status, body, headers=headers)
+
+    def reset(self):
+        with self.state.lock:
+            self.state.stats["resets"] += 1
+        # Linger with zero timeout makes close() send RST
+        self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+        self.close_connection = True
+        self.connection.close()
+
+    def body(self):
+        if self.headers.get("Transfer-Encoding", "").lower() == "chunked":
+            body = b""
+            while True:
+                size = int(self.rfile.readline().split(b";")[0], 16)
+                if size == 0:
+                    # Trailer fields up to the empty line
+                    while self.rfile.readline() not in (b"\r\n", b"\n", b""):
+                        pass
+                    return body
+                body += self.rfile.read(size)
+                self.rfile.readline()
+        length = int(self.headers.get("Content-Length", 0))
+        return self.rfile.read(length) if length > 0 else b""
+
+    def do_GET(self):
+        path = urlparse(self.path).path
+        with self.state.lock:
+            self.state.stats["requests"] += 1
+        if path in ("/health", "/ping"):
+            with self.state.lock:
+                self.state.stats["health"] += 1
+            self.state.delay()
+            self.reply(200, json.dumps({"name": "influxdb", "status": "pass", "version": "standin"}).encode())
+        elif path == "/stats":
+            with self.state.lock:
+                body = json.dumps({"stats": self.state.stats, "settings": self.state.settings()}, indent=2)
+            self.reply(200, body.encode())
+        elif path == "/lines":
+            with self.state.lock:
+                body = "".join(line + "\n" for line in self.state.lines)
+            self.reply(200, body.encode(), "text/plain; charset=utf-8")
+        else:
+            self.error(404, "path not found")
+
+    def do_POST(self):
+        url = urlparse(self.path)
+        with self.state.lock:
+            self.state.stats["requests"] += 1
+        body = self.body()
+        if url.path == "/control":
+            try:
+                self.state.update(json.loads(body or b"{}"))
+            except (ValueError, AttributeError) as e:
+                self.error(400, str(e))
+                return
+            self.reply(200, json.dumps(self.state.settings()).encode())
+            return
+        if url.path != "/api/v2/write":
+            self.error(404, "path not found")
+            return
+
+        query = parse_qs(url.query)
+        if "bucket" not in query:
+            self.error(400, "bucket not specified")
+            return
+        if self.state.token and self.headers.get("Authorization") != "Token " + self.state.token:
+            self.error(401, "unauthorized access")
+            return
+
+        self.state.delay()
+        fault = self.state.fault()
+        if fault == "reset":
+            self.reset()
+            return
+        if fault is not None:
+            self.error(fault, "injected failure", {"Retry-After": str(self.state.retry_after)})
+            return
+
+        raw = len(body)
+        if self.headers.get("Content-Encoding", "").lower() == "gzip":
+            try:
+                body = gzip.decompress(body)
+            except (OSError, EOFError) as e:
+                self.error(400, "invalid gzip body: %s" % e)
+                return
+            with self.state.lock:
+                self.state.stats["gzip"] += 1
+        lines = [line for line in body.decode("utf-8", "replace").split("\n") if line.strip()]
+        if not lines:
+            self.error(400, "no data written")
+            return
+        for line in lines:
+            # measurement[,tags] fields [timestamp]
+            if " " not in line or "=" not in line:
+                self.error(400, "unable to parse '%s'" % line)
+                return
+
+        with self.state.lock:
+            self.state.stats["writes"] += 1
+            self.state.stats["lines"] += len(lines)
+            self.state.stats["bytes"] += raw
+            self.state.stats["bytes_decoded"] += len(body)
+            self.state.lines.extend(lines)
+            if self.state.record:
+                self.state.record.write("".join(line + "\n" for line in lines))
+                self.state.record.flush()
+        self.reply(204, content_type="text/plain")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--host", default="127.0.0.1", help="listen address")
+    parser.add_argument("--port", type=int, default=8086, help="listen port")
+    parser.add_argument("--latency", type=float, default=0, help="response delay (ms)")
+    parser.add_argument("--jitter", type=float, default=0, help="random extra delay up to (ms)")
+    parser.add_argument("--fail", action="append", default=[], metavar="STATUS:P",
+                        help="respond STATUS with probability P, e.g. 429:0.1 (repeatable)")
+    parser.add_argument("--reset", type=float, default=0, help="probability of connection reset")
+    parser.add_argument("--retry-after", type=int, default=5, help="Retry-After of 429/503 (s)")
+    parser.add_argument("--rate-limit", type=float, default=0, help="writes per second, excess gets 429")
+    parser.add_argument("--token", help="required API token")
+    parser.add_argument("--record", help="append received lines to file")
+    parser.add_argument("--tls", nargs=2, metavar=("CERT", "KEY"), help="serve HTTPS with certificate and key (PEM)")
+    parser.add_argument("--seed", type=int, help="random seed for fault injection")
+    parser.add_argument("-v", "--verbose", action="store_true", help="log requests")
+    args = parser.parse_args()
+
+    Handler.state = State(args)
+    server = ThreadingHTTPServer((args.host, args.port), Handler)
+    server.daemon_threads = True
+    server.verbose = args.verbose
+    scheme = "http"
+    if args.tls:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(*args.tls)
+        server.socket = context.wrap_socket(server.socket, server_side=True, do_handshake_on_connect=False)
+        scheme = "https"
+    print("InfluxDB stand-in listening on %s://%s:%d" % (scheme, args.host, args.port), flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
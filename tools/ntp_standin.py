@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Local NTP (SNTP) server stand-in
+
+(c) Tomas Kouba, 2022
+Licensed under terms of the MIT license
+
+Answers SNTP requests (RFC 4330) with host time modified by injected
+faults, for testing time synchronization of the firmware. Set NTP server
+of the device to HOST:PORT in configuration portal (port 123 needs root).
+
+  offset       constant server time offset (ms)
+  drift        server clock runs faster (ppm) - the device sees it as
+               its own clock drift, which should be corrected
+  step         offset changes by STEP ms after given number of requests
+  delay        response delay (ms) plus uniform jitter, optionally only
+               on the way back (asymmetric path)
+  loss         probability of no response
+  kod          probability of kiss-o'-death (stratum 0, RATE)
+  unsync       leap indicator 3 (server not synchronized)
+
+Every request is printed with the sent offset, a summary is printed on
+exit (Ctrl+C).
+"""
+
+import argparse
+import random
+import socket
+import struct
+import time
+
+NTP_UNIX_OFFSET = 2208988800
+
+
+def ntp_timestamp(unix):
+    """Unix time (float seconds) -> NTP 64 bit timestamp"""
+    seconds = int(unix) + NTP_UNIX_OFFSET
+    fraction = int((unix - int(unix)) * (1 << 32)) & 0xFFFFFFFF
+    return struct.pack("!II", seconds & 0xFFFFFFFF, fraction)
+
+
+class Clock:
+    """Server clock: host time with offset, drift and step"""
+
+    def __init__(self, args):
+        self.start = time.time()
+        self.offset = args.offset / 1000
+        self.drift = args.drift / 1e6
+        self.step = args.step / 1000
+        self.step_after = args.step_after
+        self.requests = 0
+
+    def now(self):
+        host = time.time()
+        offset = self.offset
+        if self.step_after and self.requests > self.step_after:
+            offset += self.step
+        return host + offset + (host - self.start) * self.drift
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--host", default="0.0.0.0", help="listen address")
+    parser.add_argument("--port", type=int, default=1123, help="listen port")
+    parser.add_argument("--offset", type=float, default=0, help="server time offset (ms)")
+    parser.add_argument("--drift", type=float, default=0, help="server clock runs faster (ppm)")
+    parser.add_argument("--step", type=float, default=0, help="offset step (ms) after --step-after requests")
+    parser.add_argument("--step-after", type=int, default=0, help="requests before the step")
+    parser.add_argument("--delay", type=float, default=0, help="response delay (ms)")
+    parser.add_argument("--jitter", type=float, default=0, help="random extra delay up to (ms)")
+    parser.add_argument("--asymmetric", action="store_true",
+                        help="delay only the response path, client sees half of the delay as offset")
+    parser.add_argument("--loss", type=float, default=0, help="probability of no response")
+    parser.add_argument("--kod", type=float, default=0, help="probability of kiss-o'-death response")
+    parser.add_argument("--unsync", action="store_true", help="report unsynchronized server (leap 3)")
+    parser.add_argument("--stratum", type=int, default=2, help="server stratum")
+    parser.add_argument("--seed", type=int, help="random seed for fault injection")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    clock = Clock(args)
+    stats = {"requests": 0, "responses": 0, "lost": 0, "kod": 0, "invalid": 0}
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.host, args.port))
+    print("NTP stand-in listening on %s:%d" % (args.host, args.port), flush=True)
+    try:
+        while True:
+            data, address = sock.recvfrom(512)
+            delay = (args.delay + rng.uniform(0, args.jitter)) / 1000
+            if not args.asymmetric:
+                time.sleep(delay / 2)
+            received = clock.now()
+            stats["requests"] += 1
+            clock.requests += 1
+            # Client mode 3, any version
+            if len(data) < 48 or data[0] & 0x07 != 3:
+                stats["invalid"] += 1
+                continue
+            if rng.random() < args.loss:
+                stats["lost"] += 1
+                print("%s:%d lost" % address, flush=True)
+                continue
+            version = data[0] >> 3 & 0x07
+            if rng.random() < args.kod:
+                stats["kod"] += 1
+                header = struct.pack("!BBbb", 3 << 6 | version << 3 | 4, 0, 6, -20)
+                reference = b"RATE"
+            else:
+                leap = 3 if args.unsync else 0
+                header = struct.pack("!BBbb", leap << 6 | version << 3 | 4, args.stratum, 6, -20)
+                reference = b"LOCL"
+            transmitted = clock.now()
+            offset = (transmitted - time.time()) * 1000
+            packet = (header + struct.pack("!II", 0, 0) + reference + ntp_timestamp(received)
+                      + data[40:48] + ntp_timestamp(received) + ntp_timestamp(transmitted))
+            # Response path delay, all of it when asymmetric
+            time.sleep(delay if args.asymmetric else delay / 2)
+            sock.sendto(packet, address)
+            stats["responses"] += 1
+            print("%s:%d offset %+.1f ms" % (address + (offset,)), flush=True)
+    except KeyboardInterrupt:
+        pass
+    print(", ".join("%s %d" % item for item in stats.items()))
+
+
+if __name__ == "__main__":
+    main()